@@ -13,13 +13,23 @@
 #include "headers.h"            /* contains a few specific parameter and function definitions */
 #include <SPI.h>                /* the IMU, barometer & micro-SD unit are on SPI. include library for SPI commands (https://www.arduino.cc/en/reference/SPI) */
 #include "PDC_SPI.h"            /* then included our own SPI functions */
-#include <Wire.h>               /* the RTC is on I2C, so include the library for I2C commands (https://www.arduino.cc/en/reference/wire) */
-#include "PDC_I2C.h"            /* then include our own I2C functions */
+#include "PDC_I2C.h"            /* the RTC and the OBC will be on I2C. include our own I2C functions (and the Wire library, if they're compiled in) */
 #include "PDC_kalman.h"         /* include the functions for the kalman filter */
+#include "PDC_kalmanTable.h"    /* and its steady-state covariance, worked out offline */
 #include "PDC_LSM6DSO32.h"      /* include our IMU class */
 #include "PDC_BMP388.h"         /* include our altimeter class */
+#include "PDC_sensors.h"        /* include our manager for (redundant) IMUs and altimeters */
+#include "PDC_calibration.h"    /* include our on-the-pad sensor calibration */
+#include "PDC_liftoff.h"        /* include our liftoff detector */
+#include "PDC_apogee.h"         /* include our apogee detection engine */
+#include "PDC_landing.h"        /* include our landing detector */
+#include "PDC_attitude.h"       /* include our attitude estimator */
 #include "PDC_254.h"            /* include our micro-SD class */
 #include "PDC_logFile.h"        /* include our log file storage struct */
+#include "PDC_scheduler.h"      /* include our task scheduler */
+#include "PDC_ringBuffer.h"     /* include our queue for passing log records to the microSD card */
+#include <new>                  /* placement new, to make each of the log buffers in the last one's place (see PDC_logBuffers) */
+#include "PDC_profiler.h"       /* include our hot path profiler (only compiled in with PDC_PROFILE) */
 #include <BasicLinearAlgebra.h> /* for Matrix operations
                                      if this line throws an error, you probably don't have the Matrix Library locally.
                                      see: https://github.com/tomstewart89/BasicLinearAlgebra or search 'basic linear algebra' in the IDE library manager 
@@ -27,12 +37,22 @@
 using namespace BLA;            /* use the basic linear algebra namespace */
 
 /* ---------- GENERAL PARAMETERS ---------- */
-const uint8_t LAUNCH_SITE_ALTITUDE = 142; /* [m] how high above sea level is the launch site? used for measuring noise in altimeter */
-const uint8_t ACC_LIFTOFF_THRESHOLD = 5;  /* [g] the threshold value that tells us we have liftoff. this triggers the move from 'wait' mode to 'flight' mode */
-
 // TODO: refine kalmanTime based on tests. how long does measurement take? calculation time?
-// TODO: then *consider* using this to set update frequency of sensors by rounding up (e.g. if kalman update freq is 10Hz, set accelerometer to 12.5Hz in setup)
-const float kalmanTime = 0.5;             /* time step (s) between Kalman iterations */
+const float kalmanTime = 0.04;            /* nominal time step (s) between Kalman iterations. the scheduler aims for this, and it matches the 25Hz altimeter rate. the filter itself uses the time that actually passed */
+
+/* ---------- TASK CONFIG ---------- */
+/*
+    each job runs as a task with its own period and deadline (see PDC_scheduler.h)
+    tasks are listed in priority order. the sensors and the flight (apogee detection)
+     path come first, so logging and telemetry can never hold them up
+*/
+const uint32_t IMU_TASK_PERIOD       = 4000;                      /* [us] IMU acquisition (250Hz, as a sample takes ~1.6ms, see imuTask()) */
+const uint32_t ALTIMETER_TASK_PERIOD = 40000;                     /* [us] altimeter acquisition (25Hz, matching the altimeter ODR) */
+const uint32_t FLIGHT_TASK_PERIOD    = uint32_t(kalmanTime * 1e6); /* [us] phase of flight handler, including the Kalman step */
+const uint32_t LOG_TASK_PERIOD       = 10000;                     /* [us] log file line (100Hz) */
+const uint32_t TELEMETRY_TASK_PERIOD = 100000;                    /* [us] telemetry (10Hz) */
+
+PDC_scheduler scheduler(micros);  /* create a scheduler that runs off the microsecond clock. class defines are in 'PDC_scheduler.h' and 'PDC_scheduler.cpp' */
 
 /* ---------- SPI CONFIG ---------- */
 const uint8_t PDC_SS = 10;      /* the arduino nano has an 'SS' pin (10) which helps us choose if we want to be master or slave. pin 10 as output = PDC as master */
@@ -43,6 +63,16 @@ const uint8_t microSD_SS = 6;   /* the DIG pin connected to the micro-SD SS pin
 PDC_LSM6DSO32 IMU(IMU_SS);                /* create an LSM6DSO32 object for our IMU. class defines are in 'PDC_LSM6DSO32.h' and 'PDC_LSM6DSO32.cpp' */
 PDC_BMP388 altimeter(altimeter_SS);       /* create a BMP388 object for our altimeter. class defines are in 'PDC_BMP388.h' and 'PDC_BMP388.cpp' */
 
+/* the IMU measurement ranges we fly with. the log holds the IMU's own counts at these (see PDC_logFile.h) */
+const uint8_t IMU_ACCEL_RANGE = ACC_RNG_32;
+const uint8_t IMU_GYRO_RANGE = GYR_RNG_250;
+static_assert(LOG_ACCEL_SCALE == 1 / LSM6DSO32Accel::sensitivity(IMU_ACCEL_RANGE), "the log's acceleration unit isn't one count of the IMU");
+static_assert(LOG_GYRO_SCALE == 1 / LSM6DSO32Gyro::sensitivity(IMU_GYRO_RANGE), "the log's angular rate unit isn't one count of the IMU");
+
+/* every IMU and altimeter is read, checked and fused through the sensor manager. a redundant unit just needs its own
+   SS pin and object, and adding to the manager in setup, most trusted first (see PDC_sensors.h) */
+PDC_sensors sensors;
+
 const uint8_t microSD_CD = 7;             /* the microSD card module has a chip detect pin which shorts to ground if the card isn't inserted */
 PDC_254 microSD(microSD_SS, microSD_CD);  /* create a 254 breakout class for the microSD card module. class defines are in 'PDC_254.h' & 'PDC_254.cpp' */
 
@@ -57,25 +87,125 @@ const uint8_t RTCaddress = 0x50;  /* to communicate with an I2C device, we have
 /* ---------- LOG FILE CONFIG ---------- */    
 PDC_logFileFields logFileLine = {}; /* create a new instance of the storage for our log file fields and initialise all fields to 0 */
 
+/* the flight log is allocated in full at setup, so that nothing but raw sectors are written until landing (see PDC_254.h).
+   at the 100Hz log rate this is enough for ~4 hours, and the wait on the pad only costs 1/PAD_LOG_DECIMATION of that */
+const uint32_t LOG_FILE_SIZE = 64UL * 1024 * 1024;     /* [bytes] */
+const uint32_t LOG_FILE_MIN_SIZE = 1UL * 1024 * 1024;  /* [bytes] the smallest we'll settle for, if the card can't fit the full size (~4 minutes of flight) */
+
+/*
+    in flight, finished log records are queued here by the log task and written to the microSD card in idle time, so
+     a slow card write (can be 100+ms on a cheap card) delays the card, not the sensors. records keep going into the
+     block being built while the card is busy, so the queue only fills once a stall outlasts a block's worth of
+     records (120ms at the log rate). it needs to hold enough to ride out the rest of the longest stall we expect,
+     but every record costs SRAM
+*/
+const uint8_t LOG_QUEUE_SIZE = 8;         /* [records] must be a power of two */
+
+/*
+    on the pad, only one in PAD_LOG_DECIMATION records is logged, so hours on the pad take up little room. instead,
+     the IMU task keeps one in PAD_IMU_DECIMATION of its accelerometer samples in the pad IMU ring, without the gyro
+     (which only matters once we're moving), in much less room than a record. liftoff is only noticed once the motor
+     is well lit, so when it is, the ring is turned into records and logged, and the ignition is there in full (see
+     drainLog()). the ring has to reach back well past ignition (256ms against the liftoff detector's ~25ms)
+*/
+const uint8_t PAD_LOG_DECIMATION = 100;   /* log one in this many records from the pad (1Hz at the log rate) */
+const uint8_t PAD_IMU_DECIMATION = 2;     /* keep one in this many IMU samples in the pad IMU ring (125Hz, finer than the log rate) */
+const uint8_t PAD_IMU_RING_SIZE = 32;     /* [samples] must be a power of two. 256ms at the IMU rate over PAD_IMU_DECIMATION */
+
+/* none of these are needed at the same time, so they share their SRAM, each made in the last one's place when it's
+   done with: the calibration in setup, then the ring until it's been logged after liftoff, then the queue (see setup()
+   and drainLog()) */
+union PDC_logBuffers {
+  PDC_calibration calibration;                                    /* the sensor calibration on the pad, in setup */
+  PDC_ringBuffer<PDC_padIMUSample, PAD_IMU_RING_SIZE> padIMURing; /* the latest accelerometer samples from the pad */
+  PDC_ringBuffer<PDC_logFileFields, LOG_QUEUE_SIZE> logQueue;     /* the queue between the log task and the microSD card */
+
+  PDC_logBuffers() : padIMURing() {};
+} logBuffers;
+bool logQueueReady = 0;        /* the queue has taken over from the pad IMU ring */
+uint32_t padIMUFrontTime = 0;  /* [us] the full time of the oldest sample in the pad IMU ring... */
+uint32_t padIMUBackTime = 0;   /* [us] ...and of the newest */
+uint32_t padLoggedTime = 0;    /* [us] the time of the last record the log task wrote on the pad */
+
+/*
+    SRAM BUDGET
+    the nano has 2048 bytes of SRAM for every global and the stack. there's no avr-size to hand, so these are worked
+     out from the AVR layouts of the classes (2 byte pointers, no padding), and freeStack() (see headers.cpp) measures
+     what the stack really leaves on the board:
+     + the SD library's 512 byte block cache, which the log blocks are built in (see PDC_254.h), and its statics   ~525
+     + Serial's buffers, its vtables and the core                                                                  ~200
+     + our globals: the log buffers 341, tasks 153, the altimeter 115, the detectors 125 and their configs 47,
+        the card 63, SPI 46, logFileLine 42, sensors and IMU 49, the filter 48, attitude 33, the rest ~45          ~1110
+     + the stack, at its deepest: setup calibrating (see PDC_calibration.h), with an interrupt on top              ~180
+    which leaves ~30, and only because the tables are held to what we fly with (see PDC_sensors.h and PDC_SPI.h),
+     nothing talks over I2C yet (see PDC_I2C.h), every text is printed from flash, the card's root directory and
+     file are only opened when they're needed (see PDC_254.h), and the log buffers share their SRAM (see
+     PDC_logBuffers). our own share is checked when the sketch is built (see SRAM CHECK), and the stack is painted
+     at boot, so memErr is flagged if it ever gets within STACK_MIN_HEADROOM of the globals
+*/
+
+/* ---------- CALIBRATION ---------- */
+const uint16_t CALIBRATION_TIMEOUT = 3000; /* [ms] the longest to spend calibrating the sensors on the pad (~2s per unit, for the altimeter, see PDC_calibration.h) */
+
+/* ---------- LATEST MEASUREMENTS ---------- */
+/* the acquisition tasks keep these up to date so that the flight tasks don't have to go to the sensors themselves */
+float accelerationZ = 0;  /* [g] the most recent z-axis acceleration */
+float altitude = 0;       /* [m] the most recent height above the launch site */
+float pressure = 0;       /* [Pa] the most recent pressure */
+
 /* ---------- KALMAN FILTER CONFIG ---------- */
 /*
     we use a Kalman filter to estimate the point of apogee in flight
     the implementation is explained and described in 'kalmanFilter.pdf' in the github repo
     the state matrix is as below and we are measuring acceleration with the IMU, and displacement
      with the altimeter. Looking to get a good velocity estimate so point of zero crossing is apogee.
-    | acceleration (z) |
-    | velocity (z)     |
-    | displacement (z) |
+    | acceleration (z) |  [m/s^2], not including gravity
+    | velocity (z)     |  [m/s]
+    | displacement (z) |  [m] above the launch site
 */
 
 const uint8_t numStates = 3;        /* number of states that we're interested in */
-const uint8_t numMeasurements = 2;  /* number of measurements that we're taking */
-
-/* P, Q and R matrices are only needed in setup, so they aren't needed globally */
-Matrix<numStates, 1> stateMatrix;             /* matrix that contains the current system state */
-Matrix<numStates, 1> previousStateMatrix;     /* matrix that contains the previous system state */
-Matrix<numStates, 1> predictedStateMatrix;    /* matrix that contains the prediction of the next system state */
-Matrix<numMeasurements, 1> measurementMatrix; /* matrix that contains the most recent measurements */
+const uint8_t numMeasurements = 2;  /* number of measurements that we're taking. each one corrects the state on its own, at its own rate */
+
+Matrix<numStates, 1> stateMatrix;             /* matrix that contains the current system state. predicted and updated in place */
+
+/* ---------- LIFTOFF DETECTION ---------- */
+/* every IMU sample on the pad goes to the liftoff detector, which triggers the move from 'wait' mode to 'flight' mode
+   (see PDC_liftoff.h for how, and for the settings) */
+PDC_liftoff liftoffDetector(LIFTOFF_DEFAULT_CONFIG);
+
+/* ---------- APOGEE DETECTION ---------- */
+/* several detectors vote on when apogee has passed (see PDC_apogee.h for how, and for the settings) */
+PDC_apogee apogeeDetector(APOGEE_DEFAULT_CONFIG);
+
+/* ---------- LANDING DETECTION ---------- */
+/* once we're coming down, the velocity estimate and the pressure are watched for the rocket to lie still, with a timer
+   from apogee as the backstop, so the log is always closed (see PDC_landing.h for how, and for the settings) */
+PDC_landing landingDetector(LANDING_DEFAULT_CONFIG);
+
+/* ---------- ATTITUDE DETERMINATION ---------- */
+PDC_attitude attitude;  /* updated with every IMU sample, from the end of setup (see PDC_attitude.h) */
+
+/* ---------- SRAM CHECK ---------- */
+/* our share of the SRAM BUDGET above. the host's layouts are bigger (8 byte pointers, padding), so it only holds on the nano */
+#ifndef PDC_HOST
+const uint16_t GLOBALS_BUDGET = 1120;  /* [bytes] our own globals, less the profiler (a profiling build is for the bench, not flight) */
+static_assert(sizeof(logBuffers) + sizeof(logFileLine) + sizeof(scheduler) + sizeof(microSD) + sizeof(IMU) + sizeof(altimeter) + sizeof(sensors) +
+              sizeof(liftoffDetector) + sizeof(apogeeDetector) + sizeof(landingDetector) + sizeof(attitude) +
+              sizeof(LIFTOFF_DEFAULT_CONFIG) + sizeof(APOGEE_DEFAULT_CONFIG) + sizeof(LANDING_DEFAULT_CONFIG) +
+              sizeof(stateMatrix) + sizeof(Matrix<numStates, numStates>) + (SPI_MAX_DEVICES * sizeof(PDC_spiDevice)) + 64 <= GLOBALS_BUDGET,
+              "our globals are over their SRAM budget (the 64 is the scalars and the SPI queue)");
+#endif
+
+/* ---------- PROFILING ---------- */
+#if PDC_PROFILE
+PDC_profiler profiler;  /* how long the hot paths take (see PDC_profiler.h). sent when PROFILE_DUMP_COMMAND arrives over serial */
+
+/* a dump is more than the serial transmit buffer holds, so sending one holds up the loop until most of it has gone out
+   (~0.3s at 9600 baud). it's only sent outside LAUNCH and APOGEE, and the text telemetry is held off for a while after,
+   so it doesn't land in the middle of the end of the dump */
+const uint8_t PROFILE_DUMP_QUIET_RUNS = 5;  /* telemetry runs (0.5s) without text after a dump */
+#endif
 
 /* -------------------- ERRORS -------------------- */
 uint8_t errCode = 0;  /* to store component errors in setup */
@@ -92,7 +222,9 @@ const uint8_t logErr = (1 << 3);  /* log file issue, set bit 3 */
 const uint8_t rtcErr = (1 << 4);  /* real-time clock issue, set bit 4 */
 const uint8_t obcErr = (1 << 5);  /* main obc issue, set bit 5 */
 const uint8_t alsErr = (1 << 6);  /* analog light sensor issue, set bit 6 */
-//const uint8_t TODO = (1 << 7);
+const uint8_t memErr = (1 << 7);  /* the stack has come too close to the globals, set bit 7 */
+
+const uint8_t STACK_MIN_HEADROOM = 16;  /* [bytes] the least SRAM the stack may have left untouched before memErr is flagged (see the SRAM BUDGET) */
 
 /* ---------- SUBROUTINE CONTROL ---------- */
 const uint8_t WAIT_FOR_LAUNCH = 0;  /* on the pad, waiting for launch */
@@ -113,19 +245,24 @@ void setup() {
      it's useful for ground testing.
      NOTE: keep serial comms sparse and short!
      they take up significant memory if too
-     verbose or unique!!
+     verbose or unique!! wrap text in F() so
+     it's printed from flash, not SRAM
     ------------------------------------------*/
   Serial.begin(9600);                 /* open serial comms at 9600 baud to allow us to monitor the process */
   while (!Serial) {};                 /* wait for port to connect */
-  Serial.println("\n-\nSETUP\n-\n");  /* inform start of setup */
+  Serial.println(F("\n-\nSETUP\n-\n"));  /* inform start of setup */
 
   /* ---------- SPI Setup ---------- */
   pinMode(PDC_SS, OUTPUT);          /* we want to be the master of this bus! so set the 'SS' pin on the PDC as a HIGH output (https://www.arduino.cc/en/reference/SPI) */
   digitalWrite(PDC_SS, HIGH);
-  pinMode(altimeter_SS, OUTPUT);    /* set altimeter SS pin as output & disable communication by taking it high */
-  digitalWrite(altimeter_SS, HIGH);
-  pinMode(IMU_SS, OUTPUT);          /* set IMU SS pin as output & disable communication by taking it high */
-  digitalWrite(IMU_SS, HIGH);
+  /* add the altimeter to our SPI device table, which sets its SS pin as output & disables communication by taking it high.
+     a sensor that doesn't get a place can't be talked to (it reads as all zeros), so flag it */
+  if (addSPIDevice(altimeter_SS, CLOCK_RATE_10MHZ) != 0) {
+    errCode |= altErr;
+  }
+  if (addSPIDevice(IMU_SS, CLOCK_RATE_10MHZ) != 0) {  /* and the same for the IMU (see PDC_SPI.ino) */
+    errCode |= imuErr;
+  }
   pinMode(microSD_SS, OUTPUT);      /* set micro-SD SS pin as output & disable communication by taking it high */
   digitalWrite(microSD_SS, HIGH);
 
@@ -136,18 +273,31 @@ void setup() {
   // TODO: configure light sensor pins
 
   /* ---------- I2C Setup ---------- */
+#if PDC_I2C
   Wire.begin(); /* initialise CPU to use I2C */
+#endif
   // TODO: setup RTC and OBC on I2C
 
+  /* ---------- SENSOR SETUP ---------- */
+  sensors.addIMU(IMU);
+  sensors.addAltimeter(altimeter);
+
   /* ---------- SPI Verification ---------- */
-  /* our LSM6DSO32 class has an 'isAlive()' method, which reads the 'WHO_AM_I' register to check our connection. returns true if connected & working! */
-  if (!IMU.isAlive()) {
-    errCode |= imuErr;  /* if not alive, flag the IMU error bit in our code */
+  /* our LSM6DSO32 class has an 'isAlive()' method, which reads the 'WHO_AM_I' register to check our connection. returns true if connected & working!
+     a unit that isn't is left out, so any others carry on without it */
+  for (uint8_t i = 0; i < sensors.getIMUCount(); i++) {
+    if (!sensors.getIMU(i).isAlive()) {
+      errCode |= imuErr;  /* if not alive, flag the IMU error bit in our code */
+      sensors.failIMU(i);
+    }
   }
   
   /* our BMP388 class has an 'isAlive()' method, which reads the 'CHIP_ID' register to check our connection. returns true if connected & working! */
-  if (!altimeter.isAlive()) {
-    errCode |= altErr;
+  for (uint8_t i = 0; i < sensors.getAltimeterCount(); i++) {
+    if (!sensors.getAltimeter(i).isAlive()) {
+      errCode |= altErr;
+      sensors.failAltimeter(i);
+    }
   }
 
   /* our 254 class has an 'isAlive()' method, which checks the card detect pin for a card, and tries to initialise it */
@@ -160,24 +310,36 @@ void setup() {
   // TODO light sensor checks: do they agree, is it dark?
 
   /* ---------- PERIPHERAL CONFIGURATION ---------- */
-  IMU.restart();        /* reboot & clear the IMU, giving it a bit of time to start back up */
-  altimeter.restart();  /* soft reset the altimeter and enable the pressure and temperature measurements */
+  for (uint8_t i = 0; i < sensors.getIMUCount(); i++) {
+    sensors.getIMU(i).restart();        /* reboot & clear the IMU, giving it a bit of time to start back up */
+  }
+  for (uint8_t i = 0; i < sensors.getAltimeterCount(); i++) {
+    sensors.getAltimeter(i).restart();  /* soft reset the altimeter and enable the pressure and temperature measurements */
+  }
   
   // TODO: can we reboot microsd? 
 
   // TODO: decide if self test is actually sensible... what if vehicle isn't perfectly still?
-  errFlag = IMU.selfTest(); /* run self-test routine on IMU to check accel & gyro are working */
-  if (errFlag) {
-    errCode |= imuErr;  /* if self test failed, IMU error */
-    errFlag = 0;        /* clear error flag */
+  for (uint8_t i = 0; i < sensors.getIMUCount(); i++) {
+    errFlag = sensors.getIMU(i).selfTest(); /* run self-test routine on IMU to check accel & gyro are working */
+    if (errFlag) {
+      errCode |= imuErr;  /* if self test failed, IMU error */
+      errFlag = 0;        /* clear error flag */
+    }
   }
   
   // TODO: some sort of altimeter testing - if we know where we're launching we can estimate expected pressure (or we measure at alt=0 and work from there)
 
   // TODO: pass the datetime string into this function to name the file in a useful way
-  /* attempt to open a .csv file which we want to log data to */
-  if (microSD.openFile() != 0) {
+  /* attempt to create the flight log which we want to log data to. if the card can't give us one that big in one
+     piece (e.g. too full or fragmented), try for half as much until it's too small to be worth having */
+  errFlag = 1;
+  for (uint32_t logFileSize = LOG_FILE_SIZE; errFlag && (logFileSize >= LOG_FILE_MIN_SIZE); logFileSize /= 2) {
+    errFlag = microSD.openFlightFile(logFileSize);
+  }
+  if (errFlag) {
     errCode |= logErr;  /* if there was some problem creating the file, flag the log file error bit in our code */
+    errFlag = 0;
   }
   
   /**********************************************************************
@@ -198,8 +360,10 @@ void setup() {
       +  6660Hz                         |
    **********************************************************************/
   // TODO: work out a sensible gyro range for this operation
-  IMU.accel.init(ACC_ODR_3330, ACC_RNG_32); /* set the accelerometer output update frequency and measurement range */
-  IMU.gyro.init(GYR_ODR_3330, GYR_RNG_250); /* set the gyroscope output update frequency and measurement range */
+  for (uint8_t i = 0; i < sensors.getIMUCount(); i++) {
+    sensors.getIMU(i).accel.init<ACC_ODR_3330, IMU_ACCEL_RANGE>(); /* set the accelerometer output update frequency and measurement range */
+    sensors.getIMU(i).gyro.init<GYR_ODR_3330, IMU_GYRO_RANGE>(); /* set the gyroscope output update frequency and measurement range */
+  }
 
   /************************************************************************************************************
                                             ALTIMETER CONFIG VALUES
@@ -211,24 +375,83 @@ void setup() {
       + MODE 4: TODO
       + MODE 5: Ultra High Resolution (pressure resolution = 0.17Pa, temperature resolution = 0.0025C, update frequency = 25Hz)
    ************************************************************************************************************/  
-  altimeter.init(ALT_MEASUREMENT_MODE_5); /* set the altimeter output data rate and resolutions */
-  
+  for (uint8_t i = 0; i < sensors.getAltimeterCount(); i++) {
+    sensors.getAltimeter(i).init<ALT_MEASUREMENT_MODE_5>(); /* set the altimeter output data rate and resolutions */
+    sensors.getAltimeter(i).setTemperatureDecimation(25); /* temperature barely moves over a second, so only re-compensate it once a second (at 25Hz) */
+  }
+
+  /* ---------- SENSOR CALIBRATION ---------- */
+  /* sample the most trusted IMU and altimeter together while we sit still on the pad, to find their noise, the
+     gyroscope bias and the pad pressure (see PDC_calibration.h). if it runs out of time the results are still the best
+     we have, so use them. it's the deepest the stack goes, so its statistics are kept in the log buffers, which
+     aren't needed yet (see PDC_logBuffers) */
+  uint8_t primaryIMU = sensors.getPrimaryIMU();
+  uint8_t primaryAltimeter = sensors.getPrimaryAltimeter();
+  PDC_calibration &calibration = *new (&logBuffers.calibration) PDC_calibration();
+  calibration.run(sensors.getIMU(primaryIMU), sensors.getAltimeter(primaryAltimeter), CALIBRATION_TIMEOUT);
+
+  if (!calibration.imuConfident()) {
+    errCode |= imuErr;
+  }
+  if (!calibration.altimeterConfident()) {
+    errCode |= altErr;
+  }
+
+  /* measure altitude from the launch site. with no pressure samples at all, leave the reference at sea level. every
+     altimeter gets the same reference, as the sensor manager puts their pressures in terms of this one */
+  if (calibration.pressure.count > 0) {
+    for (uint8_t i = 0; i < sensors.getAltimeterCount(); i++) {
+      sensors.getAltimeter(i).setGroundPressure(calibration.pressure.mean);
+    }
+  }
+
+  float gyroBias[3] = {calibration.gyro[0].mean, calibration.gyro[1].mean, calibration.gyro[2].mean};
+  sensors.setGyroBias(primaryIMU, gyroBias);
+
+  /* ---------- ATTITUDE SETUP ---------- */
+  /* start from the way up that the accelerometer saw while we were still */
+  attitude.init(calibration.accel[0].mean, calibration.accel[1].mean, calibration.accel[2].mean);
+
   /* ---------- KALMAN FILTER SETUP ---------- */
-  initKalman(); /* setup kalman filter for apogee detection (see PDC_kalman.ino) */
+  initKalman(calibration.accel[2].stdDev(), calibration.altitudeNoise()); /* setup kalman filter for apogee detection (see PDC_kalman.ino) */
+
+  /* and then calibrate any other sensors, one at a time against the primary of the other kind. they reuse the
+     calibration's place, so this comes once the primary results have all been used */
+  calibrateSpares(primaryIMU, primaryAltimeter, calibration.pressure.mean);
+
+  /* calibration is done with the log buffers, so the pad IMU ring can have them */
+  new (&logBuffers.padIMURing) PDC_ringBuffer<PDC_padIMUSample, PAD_IMU_RING_SIZE>();
+
+  /* ---------- TASK SETUP ---------- */
+  /* add the tasks in priority order, each with a deadline of one period */
+  scheduler.addTask(imuTask, IMU_TASK_PERIOD, IMU_TASK_PERIOD);
+  scheduler.addTask(altimeterTask, ALTIMETER_TASK_PERIOD, ALTIMETER_TASK_PERIOD);
+  scheduler.addTask(flightTask, FLIGHT_TASK_PERIOD, FLIGHT_TASK_PERIOD);
+  scheduler.addTask(logTask, LOG_TASK_PERIOD, LOG_TASK_PERIOD);
+  scheduler.addTask(telemetryTask, TELEMETRY_TASK_PERIOD, TELEMETRY_TASK_PERIOD);
 
   /* ---------- SETUP COMPLETE ---------- */
+  /* calibration takes the stack the deepest it goes, so see what it left (see the SRAM BUDGET) */
+  if (freeStack() < STACK_MIN_HEADROOM) {
+    errCode |= memErr;
+  }
+
   if (errCode != 0) {
-    Serial.print("\n-\n");
-    Serial.print(" Err: ");
+    Serial.print(F("\n-\n"));
+    Serial.print(F(" Err: "));
     Serial.print(errCode, BIN);
-    Serial.println(" \n-");
+    Serial.println(F(" \n-"));
   }
   else {
-    Serial.println("\n-\nSETUP :)\n-");
+    Serial.println(F("\n-\nSETUP :)\n-"));
   }
+  Serial.print(F("stack free: "));
+  Serial.println(freeStack());
 
   delay(2000);
 
+  scheduler.start();  /* release all of the tasks from now */
+
   // TODO: take measurements in the ground state (e.g. temp and pressure). write them to SD with a note of 'ground conditions' or similar.
   // also worth storing them in variables to use to calculate local mach etc.
   // TODO: define a global 'measurement array' that allows us to plug various components into it at every measurement (e.g. when 'resdAltitude' is called, the temp & pressure
@@ -236,47 +459,268 @@ void setup() {
   // TODO: write a note to the microSD to signify end of setup - maybe need a .writeNote() method which blanks everything but date, time and note
 }
 
+/*********************************************************
+   @brief  calibrate every IMU and altimeter in use besides
+            the primary ones
+   @param  the primary IMU, which is paired with each spare
+            altimeter
+   @param  the primary altimeter, paired with each spare IMU
+   @param  the mean pressure the primary altimeter read on
+            the pad [Pa]
+ *********************************************************/
+void calibrateSpares(uint8_t primaryIMU, uint8_t primaryAltimeter, float groundPressure) {
+  for (uint8_t i = 0; i < sensors.getIMUCount(); i++) {
+    if ((i != primaryIMU) && !(sensors.getFailedIMUs() & (1 << i))) {
+      PDC_calibration &calibration = *new (&logBuffers.calibration) PDC_calibration();
+      calibration.run(sensors.getIMU(i), sensors.getAltimeter(primaryAltimeter), CALIBRATION_TIMEOUT);
+
+      float gyroBias[3] = {calibration.gyro[0].mean, calibration.gyro[1].mean, calibration.gyro[2].mean};
+      sensors.setGyroBias(i, gyroBias);
+      if (!calibration.imuConfident()) {
+        errCode |= imuErr;
+      }
+    }
+  }
+
+  for (uint8_t i = 0; i < sensors.getAltimeterCount(); i++) {
+    if ((i != primaryAltimeter) && !(sensors.getFailedAltimeters() & (1 << i))) {
+      PDC_calibration &calibration = *new (&logBuffers.calibration) PDC_calibration();
+      calibration.run(sensors.getIMU(primaryIMU), sensors.getAltimeter(i), CALIBRATION_TIMEOUT);
+
+      if (calibration.pressure.count > 0) {
+        sensors.setPressureOffset(i, calibration.pressure.mean - groundPressure);
+      }
+      if (!calibration.altimeterConfident()) {
+        errCode |= altErr;
+      }
+    }
+  }
+}
+
 /* -------------------- LOOP -------------------- */
 void loop() {
-  /* store the most recently collected packet of data in it's own instance */
-  PDC_logFileFields previousLogFileLine = logFileLine;
-  /* clear the active log file line ready for the next set of measurements */
-  logFileLine = {}; 
-  
-  // TODO: timing and OBC comms
-  /* PDCLogRate = 100
-   * OBCWriteRate = 10
-   * prevTime = getPrevTime()
-   * 
-   * while(1){
-   *  currentTime = getCurrentTime()
-   *  if (currentTime - prevTime > 1/PDCLogRate){
-   *    break into logging
-   *  }
-   *  
-   *  if (currenTime - prevTime > 1/OBCWriteRate){
-   *    write latest data packet to OBC
-   *  }
-   *  
-   * }
-   */
-  
-  // TODO: maybe disable interrupts (i2c requests) until the bottom of this loop so that we can collect all data at this timestep
+  // TODO: maybe disable interrupts (i2c requests) while a task runs so that it collects all of its data
     // before servicing the I2C request
 
-  // TODO: get current time and store in SD card structure
-  //logFileLine.logTime = (TODO);
+  /* run whichever task is due next (see PDC_scheduler.h), and if nothing is due, use the spare time to write the log */
+  if (!scheduler.run()) {
+    drainLog();
+  }
+}
+
+/*********************************************************
+   @brief  write the oldest log record to the microSD card,
+            if there is one
+ *********************************************************/
+void drainLog() {
+  PDC_logFileFields record;
+
+  /* one record at a time, so we're back checking for due tasks as soon as possible. if the card is still busy with
+     the last block, the record stays queued until it isn't, rather than holding up the tasks (see PDC_254::busy()) */
+  if (microSD.busy()) {
+    return;
+  }
+
+  /* on the pad, the log task writes its few records itself (see logTask()), and the ring is kept until liftoff */
+  if (subRoutine == WAIT_FOR_LAUNCH) {
+    return;
+  }
+
+  /* after liftoff, the ring is logged first. the IMU task keeps adding to it until it's empty, so there's no gap,
+     and then the queue is made in its place and the log task takes over (see PDC_logBuffers) */
+  if (!logQueueReady) {
+    if (padRecord(record) != 0) {
+      new (&logBuffers.logQueue) PDC_ringBuffer<PDC_logFileFields, LOG_QUEUE_SIZE>();
+      logQueueReady = 1;
+      return;
+    }
+  }
+  else if (logBuffers.logQueue.pop(record) != 0) {
+    return;
+  }
+
+  if (microSD.writeRecord(record) != 0) {
+    errCode |= logErr;
+  }
+}
+
+/*********************************************************
+   @brief  take the oldest sample out of the pad IMU ring
+   @param  where to put it
+   @retval its full time [us]
+ *********************************************************/
+uint32_t popPadIMU(PDC_padIMUSample &sample) {
+  uint32_t time = padIMUFrontTime;
+  PDC_padIMUSample next;
+
+  /* the times are only kept to 16 bits, so each one is found from the one before */
+  logBuffers.padIMURing.pop(sample);
+  if (logBuffers.padIMURing.peek(next) == 0) {
+    padIMUFrontTime += uint16_t(next.time - sample.time);
+  }
+
+  return (time);
+}
+
+/*********************************************************
+   @brief  turn the oldest sample in the pad IMU ring into
+            a log record
+   @param  where to put the record
+   @retval 0 in case of success, 1 if the ring is empty
+ *********************************************************/
+bool padRecord(PDC_logFileFields &record) {
+  PDC_padIMUSample sample;
+
+  /* the samples from before the log task's last record on the pad would put the file out of time order, so they go */
+  do {
+    if (logBuffers.padIMURing.count() == 0) {
+      return (1);
+    }
+    record = {};
+    record.logTime = popPadIMU(sample);
+  } while (int32_t(record.logTime - padLoggedTime) <= 0);
+
+  record.flightPhase = (int32_t(record.logTime - liftoffDetector.getDetectionTime()) < 0) ? WAIT_FOR_LAUNCH : LAUNCH;
+  record.accelerometerX = sample.accelerometer[0];
+  record.accelerometerY = sample.accelerometer[1];
+  record.accelerometerZ = sample.accelerometer[2];
+  record.note = LOG_NOTE_PAD_SAMPLE;
+
+  return (0);
+}
+
+/* -------------------- TASKS -------------------- */
+/*********************************************************
+   @brief  read all IMU axes and store the latest values
+ *********************************************************/
+/*
+    the IMU runs at 3330Hz and this polls its newest sample, rather than draining the FIFO of every sample since the
+     last run: each sample costs ~1.6ms of float maths, so the nano could only keep up with the FIFO by dropping
+     samples anyway. that's ~40% of the 4ms period. the filter gets every polled sample (250Hz), the pad IMU ring
+     one in PAD_IMU_DECIMATION, and in flight a record takes the newest of them at the log rate (100Hz)
+*/
+void imuTask() {
+  uint32_t sampleTime = micros();
+  PDC_imuReading reading;
+
+  /* each IMU reads both sensors in one burst so they're from the same instant, and the IMUs are read one straight
+     after the other. if none of them gave a good reading, keep the last values and skip this sample */
+  if (sensors.readIMUs(reading) != 0) {
+    errCode |= imuErr;
+    return;
+  }
+  if (sensors.getFailedIMUs()) {
+    errCode |= imuErr;
+  }
+
+  /* the log holds whole numbers of small units (see PDC_logFile.h), so the flight code carries on with the floats */
+  logFileLine.accelerometerX = logInt16(reading.accel[0] * LOG_ACCEL_SCALE);
+  logFileLine.accelerometerY = logInt16(reading.accel[1] * LOG_ACCEL_SCALE);
+  logFileLine.accelerometerZ = logInt16(reading.accel[2] * LOG_ACCEL_SCALE);
+  logFileLine.gyroscopeX = logInt16(reading.gyro[0] * LOG_GYRO_SCALE);
+  logFileLine.gyroscopeY = logInt16(reading.gyro[1] * LOG_GYRO_SCALE);
+  logFileLine.gyroscopeZ = logInt16(reading.gyro[2] * LOG_GYRO_SCALE);
+
+  accelerationZ = reading.accel[2];
+
+  /* correct the state estimate with every sample (see PDC_kalman.ino) */
+  kalmanUpdateAccel(accelerationZ, sampleTime);
+
+  /* and turn the attitude by every sample */
+  attitude.update(reading.gyro[0], reading.gyro[1], reading.gyro[2],
+                  reading.accel[0], reading.accel[1], reading.accel[2], sampleTime);
+
+  /* on the pad, and after liftoff until the ring has been logged, keep the samples for the log (see drainLog()) */
+  if (!logQueueReady) {
+    padLogIMU(sampleTime);
+  }
+
+  /* look for liftoff in every sample, so flight mode starts on the sample it's certain rather than at the next flight task */
+  if (subRoutine == WAIT_FOR_LAUNCH) {
+    liftoffDetector.update(reading.accel[0], reading.accel[1], reading.accel[2], sampleTime);
+    waitForLaunch();
+  }
+}
+
+/*********************************************************
+   @brief  keep one in PAD_IMU_DECIMATION IMU samples in the
+            pad IMU ring. on the pad, a new one takes the
+            place of the oldest if it's full
+   @param  the time it was taken [us]
+ *********************************************************/
+void padLogIMU(uint32_t sampleTime) {
+  static uint8_t sinceKept = PAD_IMU_DECIMATION - 1;  /* so the first sample is kept */
+  PDC_padIMUSample sample = {uint16_t(sampleTime), {logFileLine.accelerometerX, logFileLine.accelerometerY, logFileLine.accelerometerZ}};
+  PDC_padIMUSample oldest;
+
+  sinceKept++;
+  if (sinceKept < PAD_IMU_DECIMATION) {
+    return;
+  }
+  sinceKept = 0;
+
+  /* a 16 bit time can't tell a gap of 65.536ms or more from a shorter one (e.g. the loop is held up by a profile dump),
+     so on the pad the samples before one are dropped. only this task fills the ring, and drainLog() only empties it
+     after liftoff, so taking the oldest out here on the pad is safe. after liftoff, the ring is being logged, so it's
+     the new samples that are lost until it's empty, as they are if the card falls too far behind to keep it from
+     filling */
+  bool gap = (logBuffers.padIMURing.count() > 0) && ((sampleTime - padIMUBackTime) > 0xFFFF);
+  if (subRoutine == WAIT_FOR_LAUNCH) {
+    if (gap) {
+      while (logBuffers.padIMURing.pop(oldest) == 0) {}
+    }
+    if (logBuffers.padIMURing.count() == PAD_IMU_RING_SIZE) {
+      popPadIMU(oldest);
+    }
+  }
+  else if (gap) {
+    errCode |= logErr;
+    return;
+  }
+  if (logBuffers.padIMURing.count() == 0) {
+    padIMUFrontTime = sampleTime;
+  }
+
+  if (logBuffers.padIMURing.push(sample) != 0) {
+    errCode |= logErr;
+    return;
+  }
+  padIMUBackTime = sampleTime;
+}
+
+/*********************************************************
+   @brief  read the altimeter and store the latest value
+ *********************************************************/
+void altimeterTask() {
+  uint32_t sampleTime = micros();
+  altimeterSample sample = sensors.readAltimeters();
+  pressure = sample.pressure;
+  altitude = sensors.getAltimeter(sensors.getPrimaryAltimeter()).heightAboveGround(pressure);
+
+  if (sensors.getFailedAltimeters()) {
+    errCode |= altErr;
+  }
+
+  /* correct the state estimate with every sample (see PDC_kalman.ino) */
+  kalmanUpdateBaro(altitude, sampleTime);
+
+  /* the pressure detector averages over a window of samples, so only give it fresh ones, or a repeat would count twice */
+  if (sample.status & STATUS_DRDY_PRESS) {
+    apogeeDetector.updatePressure(sample.pressure, sampleTime);
+  }
+}
+
+/*********************************************************
+   @brief  execute the subroutine for the phase of flight
+ *********************************************************/
+void flightTask() {
   logFileLine.flightPhase = subRoutine;  /* store the current phase of flight so we can see how accurately the transition points are determined */
+  logFileLine.apogeeDetectors = apogeeDetector.getDetectors(); /* and which apogee detectors have fired, as some carry on firing after apogee is declared */
 
   /* switch case to check the current phase of the flight and execute appropriate subroutine */
   switch(subRoutine){
     case WAIT_FOR_LAUNCH:
       waitForLaunch();
-  
-      // filler code to keep us entertained during testing
-      float alt = altimeter.readAltitude();
-      Serial.print("alt: ");
-      Serial.println(alt, 5);
       break;
 
     case LAUNCH:
@@ -295,17 +739,97 @@ void loop() {
       landing();
       break;
   }
+}
+
+/*********************************************************
+   @brief  take a snapshot of the log file line and queue
+            it to be written to the microSD card
+ *********************************************************/
+void logTask() {
+  PROFILE_SECTION(PROFILE_LOG_PUSH);
+
+  /* store the most recently collected packet of data in it's own instance. fields keep their last value until
+     the task responsible for them runs again, so every line is complete */
+  /* once we've landed the log is closed (see landing()), so there's nothing more to log */
+  if (subRoutine == LANDING) {
+    return;
+  }
+
+  PDC_logFileFields completeLogFileLine = logFileLine;
+  completeLogFileLine.logTime = micros();  /* time stamp it, so the decoder doesn't have to assume records are evenly spaced */
+
+  /* on the pad, the IMU samples go in the pad IMU ring instead (see padLogIMU()), and only one in PAD_LOG_DECIMATION
+     records is logged. the queue isn't there yet, so it's written straight to the card - unless the card is busy, or
+     liftoff might be under way and the ring is about to be logged, when it waits for the next run. after liftoff, the
+     ring carries on for the log task until it's been logged (see drainLog()) */
+  if (subRoutine == WAIT_FOR_LAUNCH) {
+    static uint8_t sinceLogged = PAD_LOG_DECIMATION - 1;  /* so the first record is logged */
+    if (sinceLogged < PAD_LOG_DECIMATION - 1) {
+      sinceLogged++;
+      return;
+    }
+    if (microSD.busy() || liftoffDetector.hasOnset()) {
+      return;
+    }
+    sinceLogged = 0;
+
+    if (microSD.writeRecord(completeLogFileLine) != 0) {
+      errCode |= logErr;
+    }
+    padLoggedTime = completeLogFileLine.logTime;
+    return;
+  }
+  if (!logQueueReady) {
+    return;
+  }
+
+  /* the card is written in idle time (see drainLog()). if the queue is full, the card has fallen too far behind and this record is lost */
+  if (logBuffers.logQueue.push(completeLogFileLine) != 0) {
+    errCode |= logErr;
+  }
+}
+
+/*********************************************************
+   @brief  report on progress
+ *********************************************************/
+void telemetryTask() {
+  // TODO: write latest data packet to OBC
+
+  bool quiet = 0;  /* keep the text telemetry off the line this time */
+
+  /* keep an eye on the stack in flight too, in case a path we haven't measured takes it deeper than setup did */
+  if (freeStack() < STACK_MIN_HEADROOM) {
+    errCode |= memErr;
+  }
+
+#if PDC_PROFILE
+  /* a request while the flight is being tracked is dropped - ask again once it's over */
+  static uint8_t quietRuns = 0;
+  if ((Serial.available() > 0) && (Serial.read() == PROFILE_DUMP_COMMAND) && (subRoutine != LAUNCH) && (subRoutine != APOGEE)) {
+    profiler.dump(Serial);
+    quietRuns = PROFILE_DUMP_QUIET_RUNS;
+  }
+  if (quietRuns > 0) {
+    quietRuns--;
+    quiet = 1;
+  }
+#endif
 
-  // TODO: log file write
+  // filler code to keep us entertained during testing
+  if ((subRoutine == WAIT_FOR_LAUNCH) && !quiet) {
+    Serial.print(F("alt: "));
+    Serial.println(altitude, 5);
+  }
 }
 
 // TODO: if we can detect a component failure in flight, write a note to SD card
 // this and other things should probably be prompts for error/status code development as strings are expensive
 
 void waitForLaunch(){
-  /* stay in wait mode until we exceed a pre-defined upwards acceleration */
-  if(IMU.accel.readZ() > ACC_LIFTOFF_THRESHOLD){
+  /* stay in wait mode until the liftoff detector is sure the motor is lit (it's fed by the IMU task) */
+  if (liftoffDetector.isLiftoff()) {
     subRoutine = LAUNCH;
+    apogeeDetector.launch(liftoffDetector.getDetectionTime());  /* start the clock for the apogee lockout and backup timer */
     // TODO: fill with some 'wait' routine like measuring conditions for e.g.
   }
 }
@@ -313,23 +837,18 @@ void waitForLaunch(){
 void launch(){
   // TODO: what if a sensor fails? need to add a fallback mode where kalman stops and we just LPF (or similar) instead
   // TODO: is z acceleration sufficient? what if some pitch angle means the x/y axes are accelerating upward?
-    
-  // while(current time step - previous timestep < kalman time), do nothing (or something like check light sensor))
   // could also do lots of prediction steps before one update step?
   
-  /* use the underlying dynamical model to predict the current state of the system */
-  kalmanPredict();
-  /* update the prediction by taking measurements */
-  kalmanUpdate();
-  
-  // write measurements and states to micro-SD
+  /* the state is kept up to date by the sensor tasks as each new measurement comes in, from the moment setup finishes */
+
+  /* once the velocity is negative, we have crossed the point of zero-velocity in the z-direction. the velocity
+     detector only votes for apogee once it's clearly negative, and the altimeter (and the timer) have their say
+     too, in the sensor tasks (see PDC_apogee.h) */
+  apogeeDetector.updateVelocity(stateMatrix(1, 0), micros());
 
-  /* get the velocity from our state vector */
-  float velocity = stateMatrix(1, 0);
-  /* once the velocity is negative, we have crossed the point of zero-velocity in the z-direction and so apogee is reached  */
-  // TODO maybe change the 0 to some threshold so that we start taking more frequent data below 10m/s for example
-  if (velocity < 0) {
+  if (apogeeDetector.isApogee()) {
     subRoutine = APOGEE;
+    landingDetector.descend(micros());  /* start the clock for the landing backstop */
   }
 }
 
@@ -340,6 +859,9 @@ void apogee(){
   // parachute detection? e.g. estimating speed & checking it's below a certain value? looking for an upward acceleration after apogee?
   // light sensor check (poll the sensor every x seconds to check ambient light levels. If new value much greater than old on all 4 sensors,
   // register apogee)
+
+  /* there's nothing to wait for to deploy yet, so go straight on to the descent */
+  subRoutine = DESCENT;
 }
 
 void descent(){
@@ -348,8 +870,23 @@ void descent(){
   // consider distance of gyro from CoM and if this needs compensating for
   // kalman filter likely wont work for attitude det after all - too non-linear. some other filtering necessary
   // is it possible to use kalman filter again for altitude and speed estimation during descent? potentially much less linear process on descent
+
+  /* the sensor tasks keep the velocity estimate and the pressure up to date all the way down */
+  if (landingDetector.update(stateMatrix(1, 0), pressure, micros())) {
+    subRoutine = LANDING;
+  }
 }
 
 void landing(){
   // final logs, control LEDs if necessary??
+  static bool logClosed = 0; /* we're called every flight task period once landed, but only want to close the log once */
+
+  /* make sure everything still queued, and the last part-filled block, makes it onto the card, then set the final file size */
+  if (!logClosed) {
+    while (!logQueueReady || (logBuffers.logQueue.count() > 0)) {
+      drainLog();
+    }
+    microSD.closeFile();
+    logClosed = 1;
+  }
 }
@@ -1,11 +1,5 @@
-// TODO: in the .h file create a struct with the different fields for the log file 
-//  e.g. struct{
-//         float acc_x
-//         uint8_t note 
-//         etc...
-// and instantiate globally in setup, then include methods to fill these elements individually and write them as csv to file
-
 #include "PDC_254.h"  /* grab the class definition */
+#include "PDC_profiler.h"  /* for timing the card writes */
 
 /**********************************************
    @brief  Check if connection to device is ok
@@ -19,9 +13,13 @@ bool PDC_254::isAlive() {
     isAlive = 0;  /* flag error if card not inserted */
   }
   else {
-    if (!SD.begin(slaveSelect)) {
+    /* take our own handles on the card and the FAT volume, rather than the SD library's, as we write the log's
+       sectors ourselves, and check the root directory can be opened */
+    SdFile root;
+    if (!card.init(SPI_HALF_SPEED, slaveSelect) || !volume.init(&card) || !root.openRoot(&volume)) {
       isAlive = 0;  /* flag error if card can't be initialised */
     }
+    root.close();
   }
 
   return (isAlive);
@@ -41,64 +39,230 @@ bool PDC_254::cardInserted() {
   }
 }
 
-/**********************************************
-   @brief  Open a file to write the data to
+/*****************************************************
+   @brief  Create a contiguous, preallocated flight log
+            file and get ready to write its sectors
+            directly
+   @param  the size of file to allocate [bytes]
    @retval 0 in case of success, 1 otherwise
- **********************************************/
-bool PDC_254::openFile() {
-  /* new instance of the 'File' class (part of the SD library) that we will use to control the .csv file on the microSD card */
-  // TODO: once RTC is up & running, name the file with timestamp as per ISO 8601 format (kind of..)(yyyy-mm-ddThh-mm-ss.csv)
-  logFileName = "temp.csv";
-  
-  dataLogFile = SD.open(logFileName, FILE_WRITE);
-
-  /* if the file fails to open, return an error */
-  if (!dataLogFile) {
+ *****************************************************/
+/* a file written with the SD library grows one cluster at a time, and every so often the FAT and directory entry
+   have to be read, modified and written back, which stalls a write for several ms. for flight we avoid all of that
+   by allocating the whole file up front, in one unbroken run of sectors, and then streaming sectors straight into
+   it with a multi-block write. the file system isn't touched again until closeFile() sets the real size.
+   that also frees up the SD library's 512 byte block cache, which is only used for file system reads and writes, so
+   the records are gathered in there rather than in a second sector's worth of our own SRAM */
+bool PDC_254::openFlightFile(uint32_t fileSize) {
+  if (rawMode) {
     return (1);
   }
-  else {
-    /* get the time since we started */
-    // TODO print a new line at currentTime - timeSinceStartup with a note of 'program start' or similar
-    uint32_t timeSinceStartup = millis();
+
+  SdFile root;
+  SdFile flightFile;
+  char name[13];
+  if (!root.openRoot(&volume)) {
+    return (1);
+  }
+
+  /* find the first unused name, FLIGHT00.BIN to FLIGHT99.BIN (isAlive() must already have succeeded) */
+  for (fileNumber = 0; ; fileNumber++) {
+    if (fileNumber > 99) {
+      return (1);
+    }
+    fileName(name);
+    if (!flightFile.open(&root, name, O_READ)) {
+      break;
+    }
+    flightFile.close();
+  }
+
+  /* allocate the file, and find out where on the card it is. it's closed again before the card is written, as the
+     file system can't be touched once the multi-block write has started */
+  bool err = !flightFile.createContiguous(&root, name, fileSize) || !flightFile.contiguousRange(&rawBlock, &rawEndBlock);
+  flightFile.close();
+  if (err) {
+    return (1);
+  }
+  rawFirstBlock = rawBlock;
+
+  /* start a multi-block write over the whole file. the card can pre-erase, and after this each sector is just a data token */
+  if (!card.writeStart(rawBlock, rawEndBlock - rawBlock + 1)) {
+    if (flightFile.open(&root, name, O_WRITE)) {
+      flightFile.remove();  /* so a retry with a smaller size doesn't leave this one behind */
+    }
+    return (1);
+  }
+  root.close();
+
+  /* the file system is done with until closeFile(), so the cache is ours. it has to be taken after the last file
+     system call, as each one can fill it with a directory or FAT sector */
+  block = SdVolume::cacheClear();
+  rawMode = 1;
+
+  return (writeFileHeader());
+}
+
+/*****************************************************
+   @brief  Finish with the log file. for a flight log,
+            the size is set to what was actually written
+   @retval 0 in case of success, 1 otherwise
+ *****************************************************/
+bool PDC_254::closeFile() {
+  if (!rawMode) {
+    return (1);
+  }
+
+  bool err = flush();
+  rawMode = 0;
+
+  if (!card.writeStop()) {
+    err = 1;
+  }
+
+  /* the file system has the cache back from here */
+  block = NULL;
+
+  /* give back the part of the allocation we didn't use - this is the only time the file system is touched */
+  SdFile root;
+  SdFile flightFile;
+  char name[13];
+  fileName(name);
+  if (!root.openRoot(&volume) || !flightFile.open(&root, name, O_WRITE) ||
+      !flightFile.truncate((rawBlock - rawFirstBlock) * LOG_BLOCK_SIZE) || !flightFile.close()) {
+    err = 1;
+  }
+  root.close();
+
+  return (err);
+}
+
+/*****************************************************
+   @brief  Write the flight log's name, for fileNumber
+   @param  where to put it (13 characters)
+ *****************************************************/
+void PDC_254::fileName(char *name) {
+  strcpy(name, "FLIGHT00.BIN");
+  name[6] = '0' + (fileNumber / 10);
+  name[7] = '0' + (fileNumber % 10);
+}
+
+/*****************************************************
+   @brief  Start a new sequence of blocks with a header
+            block that tells the decoder what the
+            records look like
+   @retval 0 in case of success, 1 otherwise
+ *****************************************************/
+bool PDC_254::writeFileHeader() {
+  blockSequence = 0;
+  blockRecords = 0;
+
+  PDC_logFileHeader fileHeader;
+  fileHeader.magic = LOG_FILE_MAGIC;
+  fileHeader.version = LOG_FILE_VERSION;
+  fileHeader.recordSize = sizeof(PDC_logFileFields);
+  fileHeader.recordsPerBlock = LOG_RECORDS_PER_BLOCK;
+  fileHeader.accelScale = LOG_ACCEL_SCALE;
+  fileHeader.gyroScale = LOG_GYRO_SCALE;
+  fileHeader.temperatureScale = LOG_TEMPERATURE_SCALE;
+  fileHeader.pressureScale = LOG_PRESSURE_SCALE;
+  fileHeader.altitudeScale = LOG_ALTITUDE_SCALE;
+  fileHeader.estimateAccelScale = LOG_EST_ACCEL_SCALE;
+  fileHeader.estimateVelocityScale = LOG_EST_VELOCITY_SCALE;
+  fileHeader.estimatePositionScale = LOG_EST_POSITION_SCALE;
+
+  memset(block, 0, LOG_BLOCK_SIZE);
+  memcpy(&block[sizeof(PDC_logBlockHeader)], &fileHeader, sizeof(fileHeader));
+
+  return (writeBlock(LOG_BLOCK_FILE_HEADER));
+}
+
+/*****************************************************
+   @brief  Check if adding a record now would have to
+            wait for the card to finish with the last
+            block
+   @retval 1 if it would, 0 otherwise
+ *****************************************************/
+/* after each block is sent, the card is busy for a while programming it - usually well under 1ms, but now and again
+   100ms or more while it does its own housekeeping. the library waits for it at the start of the next write, and
+   while it waits, so does everything else in the loop. records only go into the block in SRAM until it's full, so
+   only the record that fills it would have to wait, and only if the card still hasn't finished */
+bool PDC_254::busy() {
+  return (rawMode && (blockRecords == LOG_RECORDS_PER_BLOCK - 1) && card.isBusy());
+}
+
+/*****************************************************
+   @brief  Add a record to the log file
+   @param  the record to add
+   @retval 0 in case of success, 1 otherwise
+ *****************************************************/
+/* records are stored in binary exactly as they are laid out in memory (see PDC_logFile.h), which is both smaller than
+   text and saves formatting every field with print(). they are gathered up in RAM, and only once there's a whole 
+   block's worth is anything written, as one aligned 512 byte sector. use tools/PDC_logDecoder.cpp to get a .csv back */
+bool PDC_254::writeRecord(const PDC_logFileFields &record) {
+  PROFILE_SECTION(PROFILE_SD_WRITE);
+
+  /* without an open log there's no block to gather records in */
+  if (!rawMode) {
+    return (1);
+  }
+
+  /* copy the record in after the block header and any records that are already there */
+  memcpy(&block[sizeof(PDC_logBlockHeader) + (blockRecords * sizeof(PDC_logFileFields))], &record, sizeof(PDC_logFileFields));
+  blockRecords++;
+
+  /* nothing more to do until the block is full */
+  if (blockRecords < LOG_RECORDS_PER_BLOCK) {
     return (0);
   }
+
+  return (writeBlock(LOG_BLOCK_DATA));
+}
+
+/*****************************************************
+   @brief  Write out any part-filled block. the file is
+            already the right size on the card, so
+            there's nothing more to do until it's closed
+   @retval 0 in case of success, 1 otherwise
+ *****************************************************/
+bool PDC_254::flush() {
+  if (rawMode && (blockRecords > 0)) {
+    return (writeBlock(LOG_BLOCK_DATA));
+  }
+
+  return (0);
 }
 
 /*****************************************************
-   @brief  Write data to the file on the microSD card
+   @brief  Write the block buffer to the file as one
+            whole sector, then clear it for reuse
+   @param  the type of block (LOG_BLOCK_...)
    @retval 0 in case of success, 1 otherwise
  *****************************************************/
-/* data format:
-    Time, phase of flight, acc_x (measured), acc_y (measured), acc_z (measured), temp, pressure, altitude (altimeter), light sensor 1, 2, 3, 4, acc_z (estimate), vel_z (estimate), altitude (estimate), Note"
-*/
-// TODO: populate this more fully - what are the raw measurements from BMP, GYRO, light sensors, etc? Make a .txt with headers and units
-// TODO: name value pairs? leaves us better equipped for changing headers and incomplete data
-// TODO: create some structure of data that we can update as we collect new info at each time step
-bool PDC_254::writeData(char *data) {
+bool PDC_254::writeBlock(uint8_t type) {
   bool err = 0;
 
-  // date = ...
-  // time = ...
-  // for all data
-  // writeSPI(date + ",");
-  // ...
-
-  // if data doesn't fully populate all columns, fill with err or 0
-  // note: it's *probably* a better idea to do individual writes via SPI in a for loop (e.g. for each entry, write SPI)
-  // instead of trying to pass all entries into write SPI instead - would require some weird trickery of the input to the
-  // function, and might end up wiriting to consecutive registers? needs more research
-  
-  //sprintf(buffer,"%d,%d,%d", ax,ay,az);  //assuming ax, etc are ints 
-
-  /* if the card is present and the file is found, print the log file line full of data to the file */
-  if (cardInserted() && SD.exists(logFileName)) {
-    // TODO: print the data in logFileLine to the file using sprintf to format it as .csv
-    // something to check here is if this uses lots of memory due to being a long string. does the arduino ever actually store the string? or does the .csv interpret it?
-    //dataLogFile.print(sprintf(buffer, "%f,%d", logFileLine.logTime, logFileLine.flightPhase));
-    // would it be possible to instead loop through the members of the logFileLine and write them in raw form followed each by a comma??
+  /* fill in the block header now that we know what's in the block */
+  PDC_logBlockHeader *blockHeader = (PDC_logBlockHeader *)block;
+  blockHeader->sequence = blockSequence;
+  blockHeader->type = type;
+  blockHeader->numRecords = (type == LOG_BLOCK_DATA) ? blockRecords : 0;
+
+  /* the block goes straight into the next sector of the multi-block write, as long as there's room */
+  if (!cardInserted() || (rawBlock > rawEndBlock) || !card.writeData(block)) {
+    err = 1;
   }
   else {
-    err = 1;
+    rawBlock++;
+  }
+
+  /* only count blocks that made it onto the card, so the sequence on the card never has gaps */
+  if (!err) {
+    blockSequence++;
   }
+
+  /* clear the block, so that unused space is zero and the next block starts fresh */
+  memset(block, 0, LOG_BLOCK_SIZE);
+  blockRecords = 0;
+
   return (err);
 }
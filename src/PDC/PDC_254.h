@@ -13,10 +13,34 @@
 
  ************************** Example usage **************************
 
-   --- TODO ---
+   --- (GLOBALLY) CREATE A NEW INSTANCE OF 254 ---
+   const uint8_t microSD_SS = 6;
+   const uint8_t microSD_CD = 7;
+   PDC_254 microSD(microSD_SS, microSD_CD);
+
+   --- CHECK THE CARD IS THERE, THEN PREALLOCATE A 16MB LOG FILE AND WRITE ITS SECTORS DIRECTLY ---
+   if (!microSD.isAlive() || (microSD.openFlightFile(16UL * 1024 * 1024) != 0)) {
+     // error!
+   }
+
+   --- ADD A RECORD TO THE LOG (ONLY TOUCHES THE CARD EVERY LOG_RECORDS_PER_BLOCK RECORDS) ---
+   if (!microSD.busy()) {  // otherwise, keep hold of the record and try again later, rather than wait for the card
+     if (microSD.writeRecord(logFileLine) != 0) {
+       // error!
+     }
+   }
+
+   --- WRITE OUT ANY PART-FILLED BLOCK ---
+   microSD.flush();
+
+   --- FINISH WITH THE FILE (IT IS CUT DOWN TO WHAT WAS WRITTEN) ---
+   microSD.closeFile();
 
  *******************************************************************/
 
+#ifndef _PDC_254
+#define _PDC_254
+
 #include <Arduino.h>      /* for some arduino syntax in these cpp files */
 #include "PDC_SPI.h"      /* get the SPI functions we've defined */
 #include <stdio.h>        /* std stuff for printing */
@@ -34,19 +58,45 @@ class PDC_254 {
     /* ---------- ATTRIBUTES ---------- */
     uint8_t slaveSelect;  /* the pin on the PDC that the 254 CS pin connects to. is set on contruction */
     uint8_t cardDetect;   /* the pin on the PDC that the 254 CD pin connects to. shorts to GND when card not inserted */
-    String logFileName;   /* the name of the log file that we want to write our data to */
-    File dataLogFile;     /* the log file that we will store data on */
+
+    /* we bypass the SD library's File and go to the card sectors ourselves. the root directory and the flight log's
+       file are only needed to make the log and to close it, so they're opened then, on the stack, to save SRAM */
+    Sd2Card card;             /* the card itself */
+    SdVolume volume;          /* the FAT volume on the card */
+    uint8_t fileNumber;       /* the flight log is FLIGHTnn.BIN, where this is nn */
+    bool rawMode;             /* 1 while blocks are being written straight to the flight log's sectors */
+    uint32_t rawFirstBlock;   /* the card block that the flight log starts at */
+    uint32_t rawBlock;        /* the card block that the next log block will be written to */
+    uint32_t rawEndBlock;     /* the last card block of the flight log */
+
+    uint8_t *block;                 /* records are gathered here until there's a whole sector to write. it's the SD library's block cache (see openFlightFile()) */
+    uint8_t blockRecords;           /* the number of records in the block so far */
+    uint16_t blockSequence;         /* the sequence number of the next block to write */
+
+    void fileName(char *name);      /* the flight log's name, for fileNumber. name must have room for 13 characters */
+    bool writeFileHeader();         /* start a new sequence of blocks with a file header block */
+    bool writeBlock(uint8_t type);  /* write the block buffer to the card as one whole sector */
 
   public:
     /* ---------- CONSTRUCTOR ---------- */
     PDC_254(uint8_t CS, uint8_t CD) {
       slaveSelect = CS;
       cardDetect = CD;
+      blockRecords = 0;
+      blockSequence = 0;
+      fileNumber = 0;
+      rawMode = 0;
+      block = NULL;
     };
 
     /* ---------- METHODS ---------- */
-    bool isAlive();             /* check if connected and responsive */
+    bool isAlive();             /* check if connected and responsive, and get the file system ready */
     bool cardInserted();        /* check if card is inserted */
-    bool writeData(char *data); /* write some data to the microSD card. returns 0 if successful */
-    bool openFile();            /* open a new file to log data to */
+    bool openFlightFile(uint32_t fileSize); /* preallocate a contiguous flight log and write its sectors directly. returns 0 if successful */
+    bool closeFile();           /* finish with the log file, setting it to its final size. returns 0 if successful */
+    bool busy();                /* check if adding a record now would have to wait for the card. returns 1 if it would */
+    bool writeRecord(const PDC_logFileFields &record); /* add a record to the log. returns 0 if successful */
+    bool flush();               /* write out any part-filled block. returns 0 if successful */
 };
+
+#endif
@@ -1,14 +1,12 @@
 // Methods TODO:
 // consider (research) IIR filter
-// measure altitude noise (for kalman)
 // compensate for supersonic 
-// change from separate press/temp and burst through all data registers instead 
-// instead of sea level comparison, get a pressure right at the start and compare??
 // verify that temperature/pressure/altitude is correct
 
 /* for example usage, see PDC_BMP388.h */
 
 #include "PDC_BMP388.h"  /* include the definition of the class */
+#include "PDC_profiler.h" /* for timing the altitude conversion */
 
 /*********************************************************
    @brief  Read component ID
@@ -54,73 +52,38 @@ void PDC_BMP388::addressSet(uint8_t data_0_add) {
 }
 
 /*********************************************************
-   @brief  Initialise the component
-   @param  32 bits describing the ODR and OSR configs
-            (aliases in PDC_BMP388.h)
-           format: [0:7]   temperature oversampling (resolution)
-                   [8:15]  pressure oversampling (resolution)
-                   [16:23] sensor output update frequency
-                   [24:32] UNUSED
+   @brief  Write a measurement mode to the device
+            (BMP388Mode has already checked it)
+   @param  the value for the ODR register
+   @param  the value for the OSR register
  *********************************************************/
-void PDC_BMP388::init(uint32_t configurationSettings) {
-  uint8_t dataToWrite = 0;  /* temporary variable for the data to write to the registers */
-
-  uint8_t frequency = (configurationSettings >> 16) & 255; /* shift the frequency byte down into 0:7 and mask out any additional info */
-  dataToWrite |= frequency;  /* set bits [4:0] to configure output frequency as per datasheet */
-
-  /* set the internally stored output frequency in case we need to check it later */
-  switch (frequency) {
-    case (0):  outputFrequency = 200;   break;
-    case (1):  outputFrequency = 100;   break;
-    case (2):  outputFrequency = 50;    break;
-    case (3):  outputFrequency = 25;    break;
-    case (4):  outputFrequency = 12.5;  break;
-    case (5):  outputFrequency = 6.25;  break;
-    case (6):  outputFrequency = 3.1;   break;
-    case (7):  outputFrequency = 0.78;  break;
-    case (8):  outputFrequency = 0.39;  break;
-    case (9):  outputFrequency = 0.2;   break;
-    case (10): outputFrequency = 0.1;   break;
-    case (11): outputFrequency = 0.05;  break;
-    case (12): outputFrequency = 0.02;  break;
-    case (13): outputFrequency = 0.01;  break;
-    default:  outputFrequency = 0;      break;
-  }
-  
-  writeSPI(slaveSelect, ODR_REG, dataToWrite);  /* write the frequency configuration to the ODR register */
-
-  dataToWrite = 0; /* reset ready for new data */
-
-  /* mask the input to get sensor resolutions */
-  uint8_t pressResolution = (configurationSettings >> 8) & 255; /* shift the pressure resolution byte down to 0:7 and mask out any additional info */
-  uint8_t tempResolution = configurationSettings & 255;         /* and mask out any remaining info on the configuration to get the temperature resolution */
-  dataToWrite = (tempResolution << 3) | pressResolution;        /* set bits [5:3] for temperature and [2:0] for pressure as per datasheet */
-
-  /* set the internally stored pressure oversampling incase we need to check it later */
-  switch (pressResolution) {
-    case (0):  pressureOversampling = 1;  break;
-    case (1):  pressureOversampling = 2;  break;
-    case (2):  pressureOversampling = 4;  break;
-    case (3):  pressureOversampling = 8;  break;
-    case (4):  pressureOversampling = 16; break;
-    case (5):  pressureOversampling = 32; break;
-    default:   pressureOversampling = 0;  break;
-  }
+void PDC_BMP388::configure(uint8_t ODRValue, uint8_t OSRValue) {
+  writeSPI(slaveSelect, ODR_REG, ODRValue);  /* write the frequency configuration to the ODR register */
+  writeSPI(slaveSelect, OSR_REG, OSRValue);  /* write the resolution data to the OSR register */
 
-  /* set the internally stored temperature oversampling in case we need to check it later */
-  switch (tempResolution) {
-    case (0):  temperatureOversampling = 1;  break;
-    case (1):  temperatureOversampling = 2;  break;
-    case (2):  temperatureOversampling = 4;  break;
-    case (3):  temperatureOversampling = 8;  break;
-    case (4):  temperatureOversampling = 16; break;
-    case (5):  temperatureOversampling = 32; break;
-    default:   temperatureOversampling = 0;  break;
-  }
+  getCompensationParams();  /* get the device specific temperature and pressure compensation parameters and store internally */
+  temperatureStale = 1;  /* the pressure terms are out of date now, so make sure the next sample refreshes them */
+}
 
-  writeSPI(slaveSelect, OSR_REG, dataToWrite);  /* write the resolution data to the OSR register */
+/*********************************************************
+   @brief  pick a one byte parameter out of the NVM burst
+   @param  the NVM_PAR_BYTES bytes, as read
+   @param  the address of the parameter's register
+   @retval the byte
+ *********************************************************/
+static uint8_t nvmByte(const uint8_t *rawValue, uint8_t address) {
+  return (rawValue[address - NVM_PAR_T1_REG_1]);
+}
 
-  getCompensationParams();  /* get the device specific temperature and pressure compensation parameters and store internally */
+/*********************************************************
+   @brief  pick a two byte parameter out of the NVM burst
+   @param  the NVM_PAR_BYTES bytes, as read
+   @param  the address of the parameter's first (LSB)
+            register
+   @retval the two bytes, concatenated
+ *********************************************************/
+static uint16_t nvmWord(const uint8_t *rawValue, uint8_t address) {
+  return ((uint16_t(rawValue[address - NVM_PAR_T1_REG_1 + 1]) << 8) | rawValue[address - NVM_PAR_T1_REG_1]);
 }
 
 /*********************************************************
@@ -131,98 +94,162 @@ void PDC_BMP388::getCompensationParams() {
        requires us to compensate for the specific sensor characteristics using internally stored
        (non-volatile) parameters, which we can read as below. these values are stored as different
        data types (unsigned/signed, 8/16bit), and also need some conversion to floating point 
-     there are certainly more elegant solutions to reading each of these params from the device and
-       writing them to our class, but they typically involve lots of arrays to hold datatypes and 
-       conversion factors. this way is likely more memory friendly */
+     the parameters sit in one contiguous block of registers, so we read them all in a single burst and
+       pick each one out by its register's place in the block */
       
-  uint8_t rawValue[2];      /* an array for the output bytes (no parameter is longer than two bytes) */  
+  uint8_t rawValue[NVM_PAR_BYTES];  /* an array for every parameter byte */
 
-  /* get the device specific temperature compensation parameters */
-  readSPIwithDummy(slaveSelect, NVM_PAR_T1_REG_1, 2, rawValue); /* read the T1 parameter (accounting for dummy return byte) */
-  uint16_t PAR_T1 = uint16_t((rawValue[1] << 8) | rawValue[0]); /* concatenate the two read bytes and make sure it is cast into the correct type */
-  temperatureCompensationArray[0] = float(PAR_T1) / pow(2, -8); /* apply the floating point conversion as detailed in the datasheet, and store as part of the class attribute */
-  rawValue[0] = 0;                                              /* clear the rawValue buffer ready for the next read */
-  rawValue[1] = 0;
+  readSPIwithDummy(slaveSelect, NVM_PAR_T1_REG_1, NVM_PAR_BYTES, rawValue);  /* read the lot (accounting for dummy return byte) */
 
-  readSPIwithDummy(slaveSelect, NVM_PAR_T2_REG_1, 2, rawValue);
-  uint16_t PAR_T2 = uint16_t((rawValue[1] << 8) | rawValue[0]);
-  temperatureCompensationArray[1] = float(PAR_T2) / pow(2, 30);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
+  /* get the device specific temperature compensation parameters. concatenate each pair of bytes and make sure it is cast into the correct type */
+  calibration.PAR_T1 = uint16_t(nvmWord(rawValue, NVM_PAR_T1_REG_1));
+  calibration.PAR_T2 = uint16_t(nvmWord(rawValue, NVM_PAR_T2_REG_1));
+  calibration.PAR_T3 = int8_t(nvmByte(rawValue, NVM_PAR_T3_REG_1));
 
-  readSPIwithDummy(slaveSelect, NVM_PAR_T3_REG_1, 1, rawValue);
-  int8_t PAR_T3 = int8_t(rawValue[0]);
-  temperatureCompensationArray[2] = float(PAR_T3) / pow(2, 48);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
+  /* get the device specific pressure compensation parameters */
+  calibration.PAR_P1 = int16_t(nvmWord(rawValue, NVM_PAR_P1_REG_1));
+  calibration.PAR_P2 = int16_t(nvmWord(rawValue, NVM_PAR_P2_REG_1));
+  calibration.PAR_P3 = int8_t(nvmByte(rawValue, NVM_PAR_P3_REG_1));
+  calibration.PAR_P4 = int8_t(nvmByte(rawValue, NVM_PAR_P4_REG_1));
+  calibration.PAR_P5 = uint16_t(nvmWord(rawValue, NVM_PAR_P5_REG_1));
+  calibration.PAR_P6 = uint16_t(nvmWord(rawValue, NVM_PAR_P6_REG_1));
+  calibration.PAR_P7 = int8_t(nvmByte(rawValue, NVM_PAR_P7_REG_1));
+  calibration.PAR_P8 = int8_t(nvmByte(rawValue, NVM_PAR_P8_REG_1));
+  calibration.PAR_P9 = int16_t(nvmWord(rawValue, NVM_PAR_P9_REG_1));
+  calibration.PAR_P10 = int8_t(nvmByte(rawValue, NVM_PAR_P10_REG_1));
+  calibration.PAR_P11 = int8_t(nvmByte(rawValue, NVM_PAR_P11_REG_1));
+
+  foldCompensationParams(); /* and do the floating point conversion once, here, rather than on every sample */
+}
 
+/*********************************************************
+   @brief  convert the NVM parameters to floating point
+ *********************************************************/
+void PDC_BMP388::foldCompensationParams() {
+  /* apply the floating point conversions as detailed in the datasheet. the powers of two are written out as
+     constants so that the compiler does the work instead of calling pow() */
+  temperatureCompensationArray[0] = float(calibration.PAR_T1) * 256.0;               /* / 2^-8 */
+  temperatureCompensationArray[1] = float(calibration.PAR_T2) / 1073741824.0;        /* / 2^30 */
+  temperatureCompensationArray[2] = float(calibration.PAR_T3) / 281474976710656.0;   /* / 2^48 */
+
+  pressureCompensationArray[0]  = (float(calibration.PAR_P1) - 16384.0) / 1048576.0;  /* (P1 - 2^14) / 2^20 */
+  pressureCompensationArray[1]  = (float(calibration.PAR_P2) - 16384.0) / 536870912.0; /* (P2 - 2^14) / 2^29 */
+  pressureCompensationArray[2]  = float(calibration.PAR_P3) / 4294967296.0;          /* / 2^32 */
+  pressureCompensationArray[3]  = float(calibration.PAR_P4) / 137438953472.0;        /* / 2^37 */
+  pressureCompensationArray[4]  = float(calibration.PAR_P5) * 8.0;                   /* / 2^-3 */
+  pressureCompensationArray[5]  = float(calibration.PAR_P6) / 64.0;                  /* / 2^6 */
+  pressureCompensationArray[6]  = float(calibration.PAR_P7) / 256.0;                 /* / 2^8 */
+  pressureCompensationArray[7]  = float(calibration.PAR_P8) / 32768.0;               /* / 2^15 */
+  pressureCompensationArray[8]  = float(calibration.PAR_P9) / 281474976710656.0;     /* / 2^48 */
+  pressureCompensationArray[9]  = float(calibration.PAR_P10) / 281474976710656.0;    /* / 2^48 */
+  pressureCompensationArray[10] = float(calibration.PAR_P11) / 36893488147419103232.0; /* / 2^65 */
+}
 
-  /* get the device specific pressure compensation parameters */
-  readSPIwithDummy(slaveSelect, NVM_PAR_P1_REG_1, 2, rawValue);
-  int16_t PAR_P1 = int16_t((rawValue[1] << 8) | rawValue[0]);
-  pressureCompensationArray[0] = (float(PAR_P1) - pow(2, 14)) / pow(2, 20);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P2_REG_1, 2, rawValue);
-  int16_t PAR_P2 = int16_t((rawValue[1] << 8) | rawValue[0]);
-  pressureCompensationArray[1] = (float(PAR_P2) - pow(2, 14)) / pow(2, 29);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P3_REG_1, 1, rawValue);
-  int8_t PAR_P3 = int8_t(rawValue[0]);
-  pressureCompensationArray[2] = float(PAR_P3) / pow(2, 32);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P4_REG_1, 1, rawValue);
-  int8_t PAR_P4 = int8_t(rawValue[0]);
-  pressureCompensationArray[3] = float(PAR_P4) / pow(2, 37);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P5_REG_1, 2, rawValue);
-  uint16_t PAR_P5 = uint16_t((rawValue[1] << 8) | rawValue[0]);
-  pressureCompensationArray[4] = float(PAR_P5) / pow(2, -3);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-  
-  readSPIwithDummy(slaveSelect, NVM_PAR_P6_REG_1, 2, rawValue);
-  uint16_t PAR_P6 = uint16_t((rawValue[1] << 8) | rawValue[0]);
-  pressureCompensationArray[5] = float(PAR_P6) / pow(2, 6);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-  
-  readSPIwithDummy(slaveSelect, NVM_PAR_P7_REG_1, 1, rawValue);
-  int8_t PAR_P7 = int8_t(rawValue[0]);
-  pressureCompensationArray[6] = float(PAR_P7) / pow(2, 8);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
+/*********************************************************
+   @brief  compensate a raw temperature measurement
+   @param  the raw temperature data from the device
+   @retval the compensated temperature [degC]
+ *********************************************************/
+float PDC_BMP388::compensateTemperature(uint32_t uncompensatedTemperature) {
+  float compensatedTemperature = 0; /* the temperature as compensated for using parameters */
+  float interim1 = 0;               /* interim register to store data */
+
+  /* below compensation calculations are as per the datasheet */
   
-  readSPIwithDummy(slaveSelect, NVM_PAR_P8_REG_1, 1, rawValue);
-  int8_t PAR_P8 = int8_t(rawValue[0]);
-  pressureCompensationArray[7] = float(PAR_P8) / pow(2, 15);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P9_REG_1, 2, rawValue);
-  int16_t PAR_P9 = int16_t((rawValue[1] << 8) | rawValue[0]);
-  pressureCompensationArray[8] = float(PAR_P9) / pow(2, 48);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P10_REG_1, 1, rawValue);
-  int8_t PAR_P10 = int8_t(rawValue[0]);
-  pressureCompensationArray[9] = float(PAR_P10) / pow(2, 48);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
-
-  readSPIwithDummy(slaveSelect, NVM_PAR_P11_REG_1, 1, rawValue);
-  int8_t PAR_P11 = int8_t(rawValue[0]);
-  pressureCompensationArray[10] = float(PAR_P11) / pow(2, 65);
-  rawValue[0] = 0;
-  rawValue[1] = 0;
+  /* uncomp - PAR_T1 */
+  interim1 = float(uncompensatedTemperature) - temperatureCompensationArray[0];
+  /* [(uncomp - PAR_T1) * PAR_T2] + (uncomp - PAR_T1)^2 * PAR_T3, written as (uncomp - PAR_T1) * [PAR_T2 + (uncomp - PAR_T1) * PAR_T3] */
+  compensatedTemperature = interim1 * (temperatureCompensationArray[1] + interim1 * temperatureCompensationArray[2]);
+
+  /* the pressure compensation is a cubic in pressure, with coefficients that are polynomials in temperature. 
+     temperature changes much more slowly than we sample pressure, so evaluate the temperature polynomials here 
+     (in Horner form) and leave pressure compensation with only the pressure cubic to do */
+
+  /* PAR_P8 * compTemp^3 + PAR_P7 * compTemp^2 + PAR_P6 * compTemp + PAR_P5 */
+  pressureTerms[0] = ((pressureCompensationArray[7] * compensatedTemperature
+                     + pressureCompensationArray[6]) * compensatedTemperature
+                     + pressureCompensationArray[5]) * compensatedTemperature
+                     + pressureCompensationArray[4];
+  /* PAR_P4 * compTemp^3 + PAR_P3 * compTemp^2 + PAR_P2 * compTemp + PAR_P1 */
+  pressureTerms[1] = ((pressureCompensationArray[3] * compensatedTemperature
+                     + pressureCompensationArray[2]) * compensatedTemperature
+                     + pressureCompensationArray[1]) * compensatedTemperature
+                     + pressureCompensationArray[0];
+  /* PAR_P9 + PAR_P10 * compTemp */
+  pressureTerms[2] = pressureCompensationArray[8] + pressureCompensationArray[9] * compensatedTemperature;
+
+  return (compensatedTemperature);
+}
+
+/*********************************************************
+   @brief  compensate a raw pressure measurement, using the
+            terms from the last compensated temperature
+   @param  the raw pressure data from the device
+   @retval the compensated pressure [Pa]
+ *********************************************************/
+float PDC_BMP388::compensatePressure(uint32_t uncompensatedPressure) {
+  float uncomp = float(uncompensatedPressure);
+
+  /* term0 + term1 * uncomp + term2 * uncomp^2 + PAR_P11 * uncomp^3, in Horner form */
+  return (((pressureCompensationArray[10] * uncomp + pressureTerms[2]) * uncomp + pressureTerms[1]) * uncomp + pressureTerms[0]);
+}
+
+/*********************************************************
+   @brief  compensate a raw temperature measurement using
+            the integer formulas from the Bosch reference
+            driver (BMP3_API)
+   @param  the raw temperature data from the device
+   @retval the compensated temperature [0.01 degC]
+ *********************************************************/
+int32_t PDC_BMP388::compensateTemperatureInt(uint32_t uncompensatedTemperature) {
+  int64_t interim1 = int64_t(uncompensatedTemperature) - (int64_t(256) * calibration.PAR_T1);
+  int64_t interim2 = int64_t(calibration.PAR_T2) * interim1;
+  int64_t interim3 = (interim1 * interim1) * calibration.PAR_T3;
+
+  linearisedTemperature = ((interim2 * 262144) + interim3) / 4294967296LL;  /* 'T_lin' - the temperature in 1/65536 degC, needed for pressure */
+
+  return (int32_t((linearisedTemperature * 25) / 16384));
+}
+
+/*********************************************************
+   @brief  compensate a raw pressure measurement using the
+            integer formulas from the Bosch reference driver
+            (BMP3_API), and the last compensated temperature
+   @param  the raw pressure data from the device
+   @retval the compensated pressure [0.01 Pa]
+ *********************************************************/
+uint32_t PDC_BMP388::compensatePressureInt(uint32_t uncompensatedPressure) {
+  int64_t tLin = linearisedTemperature;
+  int64_t uncomp = uncompensatedPressure;
+  int64_t interim1, interim2, interim3, interim4, interim5, interim6;
+  int64_t offset, sensitivity;
+
+  interim1 = tLin * tLin;
+  interim2 = interim1 / 64;
+  interim3 = (interim2 * tLin) / 256;
+  interim4 = (calibration.PAR_P8 * interim3) / 32;
+  interim5 = (calibration.PAR_P7 * interim1) * 16;
+  interim6 = (calibration.PAR_P6 * tLin) * 4194304;
+  offset = (calibration.PAR_P5 * 140737488355328LL) + interim4 + interim5 + interim6;
+
+  interim2 = (calibration.PAR_P4 * interim3) / 32;
+  interim4 = (calibration.PAR_P3 * interim1) * 4;
+  /* widen before taking 2^14 away - P1 and P2 are int16_t, and on the nano an int is only 16 bits, so the subtraction
+     itself would overflow for the lower half of their range */
+  interim5 = ((int64_t)calibration.PAR_P2 - 16384) * tLin * 2097152;
+  sensitivity = (((int64_t)calibration.PAR_P1 - 16384) * 70368744177664LL) + interim2 + interim4 + interim5;
+
+  interim1 = (sensitivity / 16777216) * uncomp;
+  interim2 = calibration.PAR_P10 * tLin;
+  interim3 = interim2 + (65536 * int64_t(calibration.PAR_P9));
+  interim4 = (interim3 * uncomp) / 8192;
+  interim5 = ((uncomp * (interim4 / 10)) / 512) * 10;  /* divide by 10 then multiply back again to avoid overflow */
+  interim6 = uncomp * uncomp;
+  interim2 = (calibration.PAR_P11 * interim6) / 65536;
+  interim3 = (interim2 * uncomp) / 128;
+  interim4 = (offset / 4) + interim1 + interim5 + interim3;
+
+  return (uint32_t((uint64_t(interim4) * 25) / 1099511627776ULL));
 }
 
 /*********************************************************
@@ -245,45 +272,54 @@ uint32_t PDC_BMP388::readValue(uint8_t data_address0) {
   return (rawValueConcat);
 }
 
+/*********************************************************
+   @brief  compensate temperature using the configured method
+            (this also updates the pressure compensation terms)
+   @param  the raw temperature data from the device
+   @retval the compensated temperature [degC]
+ *********************************************************/
+float PDC_BMP388::updateTemperature(uint32_t uncompensatedTemperature) {
+  if (ALT_INTEGER_COMPENSATION) {
+    lastTemperature = float(compensateTemperatureInt(uncompensatedTemperature)) / 100.0; /* convert from 0.01degC to degC */
+  }
+  else {
+    lastTemperature = compensateTemperature(uncompensatedTemperature);
+  }
+
+  samplesSinceTemperature = 0;  /* we're now up to date */
+  temperatureStale = 0;
+
+  logFileLine.altimeterTemperature = logInt16(lastTemperature * LOG_TEMPERATURE_SCALE);  /* store the measured temperature in the log file structure */
+
+  return (lastTemperature);
+}
+
+/*********************************************************
+   @brief  compensate pressure using the configured method
+   @param  the raw pressure data from the device
+   @retval the compensated pressure [Pa]
+ *********************************************************/
+float PDC_BMP388::updatePressure(uint32_t uncompensatedPressure) {
+  float compensatedPressure = 0;  /* the pressure as compensated for using parameters */
+
+  if (ALT_INTEGER_COMPENSATION) {
+    compensatedPressure = float(compensatePressureInt(uncompensatedPressure)) / 100.0; /* convert from 0.01Pa to Pa */
+  }
+  else {
+    compensatedPressure = compensatePressure(uncompensatedPressure);
+  }
+
+  logInt24(logFileLine.altimeterPressure, compensatedPressure * LOG_PRESSURE_SCALE, false);  /* store the measured pressure in the log file structure */
+
+  return (compensatedPressure);
+}
+
 /*********************************************************
    @brief  read device pressure and compensate w/ params
    @retval the compensated pressure measurement [Pa]
  *********************************************************/
 float PDC_BMP388::readPress(){
-  uint32_t uncompensatedPressure = 0;   /* the raw pressure data from the device */
-  float compensatedPressure = 0;        /* the pressure as compensated for using parameters */
-  float compensatedTemperature = 0;     /* the temperature as compensated for using parameters */
-  float interim1 = 0;                   /* interim registers to store data */
-  float interim2 = 0;
-  float interim3 = 0;
-  
-  compensatedTemperature = readTemp();  /* get the compensated temperature reading */
-  
-  /* pass the first pressure data address (data_0) to read the 3 consecutive pressure addresses */
-  uncompensatedPressure = readValue(pressureAddress_0); 
-
-  /* below compensation calculations are as specified in the datasheet */
-
-  /* PAR_P8 * compTemp^3 + PAR_P7 * compTemp^2 + PAR_P6 * compTemp + PAR_P5 */
-  interim1 = pressureCompensationArray[7] * pow(compensatedTemperature, 3) 
-             + pressureCompensationArray[6] * pow(compensatedTemperature, 2) 
-             + pressureCompensationArray[5] * compensatedTemperature
-             + pressureCompensationArray[4];  
-  /* uncompPress * (PAR_P4 * compTemp^3 + PAR_P3 * compTemp^2 + PAR_P2 * compTemp + PAR_P1) */
-  interim2 = float(uncompensatedPressure) * 
-              (pressureCompensationArray[3] * pow(compensatedTemperature, 3) 
-             + pressureCompensationArray[2] * pow(compensatedTemperature, 2) 
-             + pressureCompensationArray[1] * compensatedTemperature
-             + pressureCompensationArray[0]);  
-  /* PAR_P11 * uncompPress^3 + (PAR_P9 + PAR_P10 * compTemp) * uncompPress^2 */
-  interim3 = pow(float(uncompensatedPressure), 3) * pressureCompensationArray[10]
-             + pow(float(uncompensatedPressure), 2) * (pressureCompensationArray[8] + pressureCompensationArray[9] * compensatedTemperature);
-
-  compensatedPressure = interim1 + interim2 + interim3; /* calculate the compensated pressure [Pa] */
-
-  logFileLine.altimeterPressure = compensatedPressure;  /* store the measured pressure in the log file structure */
-
-  return(compensatedPressure);
+  return (readSample().pressure); /* pressure compensation depends on temperature, so read them both together */
 }
 
 /*********************************************************
@@ -291,26 +327,47 @@ float PDC_BMP388::readPress(){
    @retval the compensated temperature measurement [degC]
  *********************************************************/
 float PDC_BMP388::readTemp(){
-  uint32_t uncompensatedTemperature = 0;  /* the raw temperature data from the device */
-  float compensatedTemperature = 0;       /* the temperature as compensated for using parameters */
-  float interim1 = 0;                     /* interim registers to store data */
-  float interim2 = 0;
-  
   /* pass the first temperature data address (data_0) to read the 3 consecutive temperature addresses */
-  uncompensatedTemperature = readValue(temperatureAddress_0); 
+  return (updateTemperature(readValue(temperatureAddress_0)));
+}
 
-  /* below compensation calculations are as per the datasheet */
-  
-  /* uncomp - PAR_T1 */
-  interim1 = float(uncompensatedTemperature) - temperatureCompensationArray[0];
-  /* (uncomp - PAR_T1) * PAR_T2 */
-  interim2 = interim1 * temperatureCompensationArray[1];
-  /* [(uncomp - PAR_T1) * PAR_T2] + (uncomp - PAR_T1)^2 * PAR_T3 */
-  compensatedTemperature = interim2 + (interim1 * interim1) * temperatureCompensationArray[2];
+/*********************************************************
+   @brief  read status, pressure and temperature together
+   @retval the compensated sample
+ *********************************************************/
+altimeterSample PDC_BMP388::readSample() {
+  uint8_t rawValue[SAMPLE_BYTES]; /* we will read the status and all six data bytes from the device into here */
+  altimeterSample sample;         /* and we will put the compensated values in here */
+
+  /* the status register sits right before the data registers, so one burst gets us everything */
+  readSPIwithDummy(slaveSelect, STATUS_REG, SAMPLE_BYTES, rawValue);
+
+  sample.status = rawValue[0];
+
+  /* temperature changes slowly compared to how often we sample pressure, so only re-compensate it (and the pressure 
+     terms that depend on it) every so often. the first sample always needs doing as there's nothing to reuse yet. the
+     count is reset as soon as it reaches the decimation, so it never wraps, even at 255 */
+  samplesSinceTemperature++;
+  if (temperatureStale || (samplesSinceTemperature >= temperatureDecimation)) {
+    /* temperature is at DATA_3,4,5. cast each byte into a 32bit register so the shifts don't overflow */
+    updateTemperature((uint32_t(rawValue[6]) << 16) | (uint32_t(rawValue[5]) << 8) | rawValue[4]);
+  }
+  sample.temperature = lastTemperature;
 
-  logFileLine.altimeterTemperature = compensatedTemperature;  /* store the measured temperature in the log file structure */
-  
-  return(compensatedTemperature);
+  /* pressure is at DATA_0,1,2 */
+  sample.pressure = updatePressure((uint32_t(rawValue[3]) << 16) | (uint32_t(rawValue[2]) << 8) | rawValue[1]);
+
+  return (sample);
+}
+
+/*********************************************************
+   @brief  set how often temperature is re-compensated
+   @param  compensate temperature on one in this many
+            samples (1 = every sample)
+ *********************************************************/
+void PDC_BMP388::setTemperatureDecimation(uint8_t decimation) {
+  temperatureDecimation = decimation;
+  temperatureStale = 1;  /* make sure the next sample picks up a fresh temperature */
 }
 
 /*********************************************************
@@ -318,68 +375,50 @@ float PDC_BMP388::readTemp(){
    @retval the absolute altitude [m]
  *********************************************************/
 float PDC_BMP388::readAltitude(){
-  float atmosphericPressure;  /* measured (compensated) pressure */
-  float altitude;             /* calculated altitude based on pressure */
+  float altitude; /* calculated altitude based on pressure */
 
-  /* the BMP180 datasheet (https://cdn-shop.adafruit.com/datasheets/BST-BMP180-DS000-09.pdf) gives the equation for pressure -> altitude */
-  
-  atmosphericPressure = readPress() / 100.0;  /* read the compensated atmospheric pressure and convert from Pa to hPa */
-  altitude = 44330 * (1 - pow(atmosphericPressure/SEA_LEVEL_PRESSURE, 0.190295)); /* use the equation from link above to claculate absolute altitude [m] */
+  /* convert the compensated pressure using the standard atmosphere lookup table (see PDC_altitude.h) */
+  altitude = pressureToAltitude(readSample().pressure);
   
-  logFileLine.altimeterAltitude = altitude; /* store the calculated altitude in the log file structure */
+  logInt24(logFileLine.altimeterAltitude, altitude * LOG_ALTITUDE_SCALE, true); /* store the calculated altitude in the log file structure */
   
   return(altitude);
 }
 
 /*********************************************************
-   @brief  measure standard deviation of noise in altitude reading
-   @retval the measurement noise standard devation in
-           metres
+   @brief  measure the height above the launch site
+   @retval the height above the ground reference [m]
  *********************************************************/
-float PDC_BMP388::measureAltitudeNoise() {
-  uint8_t numReadings = 50; /* how many readings to calculate standard deviation over */
-  /* stat variables */
-  float stdDev = 0;
-  float mean = 0;
-  float sum = 0;
-  float prev_mean = 0;
+float PDC_BMP388::readAltitudeAGL(){
+  return (heightAboveGround(readSample().pressure));
+}
 
-  float altitude = 0; /* the altitude output from the altimeter */
+/*********************************************************
+   @brief  convert a pressure to height above the launch
+            site
+   @param  the compensated pressure [Pa]
+   @retval the height above the ground reference [m]
+ *********************************************************/
+float PDC_BMP388::heightAboveGround(float pressure){
+  PROFILE_SECTION(PROFILE_ALTITUDE);
 
-  float threshold = 5;  /* reject rubbish values that exceed a threshold of reasonable expectation */
+  float height; /* calculated height based on pressure */
 
-  uint32_t startTime = millis();
-  
-  /* for the specified number of readings, measure the altitude */
-  for (uint8_t i = 1; i < numReadings; i++) {
-    
-    delay(100); /* force rate of measurements to allow for proper processing */
-
-    altitude = readAltitude(); /* get altitude */
-
-    if (abs(LAUNCH_SITE_ALTITUDE - altitude) > threshold) {
-      i -= 1; /* for an erroneous reading, we should take the reading again to avoid skew */
-    }
-    else {
-      /* Welford's algorithm for calculating standard deviation in real time
-          allows us to sidestep a large array of floats which would very quickly eat up memory & limit the samples we can test!
-      */
-      mean = mean + (altitude - mean) / i;
-      sum = sum + (altitude - mean) * (altitude - prev_mean);
-      prev_mean = mean;
-    }
-
-    /* timeout control */
-    if((millis() - startTime) > 10000){
-      break; 
-    }
-  }
+  /* the standard atmosphere assumes 1013.25hPa at sea level, which the weather on the day won't agree with. taking the 
+     difference from the altitude of the pad pressure cancels most of that out, leaving height above the launch site */
+  height = pressureToAltitude(pressure) - groundAltitude;
 
-  // TODO: determine if we should be dividing by n or by n-1
-  stdDev = pow(sum / float(numReadings), 0.5);
+  logInt24(logFileLine.altimeterAltitude, height * LOG_ALTITUDE_SCALE, true); /* store the calculated height in the log file structure */
 
-  // TODO: consider putting a cap on stdDev incase of disturbance during setup
-  // TODO: maybe we should go between the measurement modes on the ground and measure stddev in each of them and store results internally??
+  return(height);
+}
 
-  return (stdDev);
+/*********************************************************
+   @brief  set the ground reference for height above the
+            launch site
+   @param  the average pressure on the pad [Pa]
+ *********************************************************/
+void PDC_BMP388::setGroundPressure(float pressure) {
+  groundPressure = pressure;
+  groundAltitude = pressureToAltitude(groundPressure);
 }
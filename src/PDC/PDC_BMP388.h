@@ -40,32 +40,57 @@
    altimeter.restart();
 
    --- CONFIGURE ALTIMETER UPDATE FREQUENCY AND SET MEASUREMENT RESOLUTIONS ---
-   altimeter.init(ALT_MEASUREMENT_MODE_5);
-    // note that this .h file includes aliases for each possible mode
+   altimeter.init<ALT_MEASUREMENT_MODE_5>();
+    // note that this .h file includes aliases for each possible mode. a mode is checked when compiling,
+    // so one the device can't run (e.g. oversampling too slow for the output data rate) won't build
     
    --- READ ALTITUDE ---
    float altitude = altimeter.readAltitude();
 
- *******************************************************************/
+   --- MEASURE HEIGHT ABOVE THE LAUNCH SITE, GIVEN THE AVERAGE PRESSURE ON THE PAD (SEE PDC_calibration.h) ---
+   altimeter.setGroundPressure(calibration.pressure.mean);
+   float height = altimeter.readAltitudeAGL();
+
+   --- READ PRESSURE AND TEMPERATURE IN ONE TRANSACTION ---
+   altimeterSample sample = altimeter.readSample();
+   if (sample.status & STATUS_DRDY_PRESS) {
+     // fresh pressure data!
+   }
+
+   --- ONLY RE-COMPENSATE TEMPERATURE ON EVERY 10TH SAMPLE ---
+   altimeter.setTemperatureDecimation(10);
 
-//TODO maybe add a method which measures *all* values in one go for some reason
+ *******************************************************************/
 
 /* for detailed function information, see PDC_BMP388.cpp */
 
+#ifndef _PDC_BMP388
+#define _PDC_BMP388
+
 #include <Arduino.h>  /* bring some arduino syntax into the cpp files */
 #include "PDC_SPI.h"  /* grab our SPI functions */
 #include <stdio.h>    /* std stuff for cpp */
 #include "headers.h"
 #include "PDC_logFile.h"  /* include our log file line structure so we can access the global one defined in main */
+#include "PDC_altitude.h" /* for the fast pressure to altitude conversion */
 
 const float SEA_LEVEL_PRESSURE = 1013.25; /* the pressure at sea level in hPa, for calculations of altitude */
 
+/* use the integer (fixed-point) compensation formulas from the Bosch reference driver instead of the floating point ones from the datasheet.
+   the integer path needs 64 bit arithmetic, so which is quicker depends on the processor - see compensatePressureInt() */
+const bool ALT_INTEGER_COMPENSATION = false;
+
 /* DEVICE REGISTER ADDRESSES */
 const uint8_t CHIP_ID_REG = 0x00;   /* the address of the 'CHIP_ID' (identification) register */
 const uint8_t CHIP_ID_VAL = 0X50;   /* the (fixed) value stored in the 'CHIP_ID' register */
 
+const uint8_t STATUS_REG = 0x03;    /* the address of the 'STATUS' register, which sits immediately before the data registers */
 const uint8_t DATA_0_REG = 0x04;    /* the address of the first data register. (pressure is at DATA_0,1,2 and temperature is at DATA_3,4,5) */
 
+const uint8_t STATUS_DRDY_PRESS = (1 << 5); /* 'STATUS' bit set when there is new pressure data */
+const uint8_t STATUS_DRDY_TEMP  = (1 << 6); /* 'STATUS' bit set when there is new temperature data */
+const uint8_t SAMPLE_BYTES      = 7;        /* the status byte plus three pressure and three temperature bytes */
+
 const uint8_t OSR_REG = 0x1C;       /* the address of the 'OSR' (oversampling settings) register */
 const uint8_t ODR_REG = 0x1D;       /* the address of the 'ODR' (output data rates) register */
 
@@ -95,6 +120,7 @@ const uint8_t NVM_PAR_P9_REG_1  = 0x42;
 const uint8_t NVM_PAR_P9_REG_2  = 0x43;
 const uint8_t NVM_PAR_P10_REG_1 = 0x44;
 const uint8_t NVM_PAR_P11_REG_1 = 0x45;
+const uint8_t NVM_PAR_BYTES     = NVM_PAR_P11_REG_1 - NVM_PAR_T1_REG_1 + 1; /* the parameters are contiguous, so they can all be read in one burst */
 
 /************************************************************************************************************
                                           ALTIMETER CONFIG VALUES
@@ -148,6 +174,30 @@ const uint8_t ALT_OSR_TEMP_HIGH      = 3;
 const uint8_t ALT_OSR_TEMP_ULTRAHIGH = 4; 
 const uint8_t ALT_OSR_TEMP_HIGHEST   = 5;
 
+/**************************************************************************
+    a measurement mode for the altimeter
+      the output data rate and oversampling codes (see the table above),
+        checked when compiling, and the register values they make. the
+        device flags an error and won't measure if the oversampling takes
+        longer than the output data rate allows, so that is checked too
+        (measurement time from datasheet section 3.9.2)
+ **************************************************************************/
+template <uint8_t frequency, uint8_t pressureResolution, uint8_t temperatureResolution>
+struct BMP388Mode {
+  static_assert(frequency <= ALT_ODR_0p01, "not an output data rate code");
+  static_assert(pressureResolution <= ALT_OSR_PRESS_HIGHEST, "not a pressure oversampling code");
+  static_assert(temperatureResolution <= ALT_OSR_TEMP_HIGHEST, "not a temperature oversampling code");
+
+  static constexpr uint8_t ODR_VALUE = frequency;                                        /* to write to the ODR register */
+  static constexpr uint8_t OSR_VALUE = (temperatureResolution << 3) | pressureResolution; /* to write to the OSR register: [5:3] temperature, [2:0] pressure */
+
+  static constexpr uint8_t PRESSURE_OVERSAMPLING = 1 << pressureResolution;        /* samples per pressure measurement */
+  static constexpr uint8_t TEMPERATURE_OVERSAMPLING = 1 << temperatureResolution;  /* samples per temperature measurement */
+  static constexpr uint32_t PERIOD = uint32_t(5000) << frequency;                   /* [us] between outputs (200Hz, halved with each code) */
+  static constexpr uint32_t MEASUREMENT_TIME = 234 + (392 + 2020 * uint32_t(PRESSURE_OVERSAMPLING)) + (163 + 2020 * uint32_t(TEMPERATURE_OVERSAMPLING)); /* [us] */
+  static_assert(MEASUREMENT_TIME <= PERIOD, "the oversampling takes longer than the output data rate allows");
+};
+
 /************************************************************************************************************
                                           PREDEFINED ALTIMETER MODES
     ---------------------------------------------------------------------------------------------------------
@@ -157,51 +207,113 @@ const uint8_t ALT_OSR_TEMP_HIGHEST   = 5;
     + MODE 4: TODO
     + MODE 5: Ultra High Resolution (pressure resolution = 0.17Pa, temperature resolution = 0.0025C, update frequency = 25Hz)
  ************************************************************************************************************/  
-const uint32_t ALT_MEASUREMENT_MODE_1 = (uint32_t(ALT_ODR_100) << 16) | (uint32_t(ALT_OSR_PRESS_LOW) << 8) | uint32_t(ALT_OSR_TEMP_ULTRALOW);
-const uint32_t ALT_MEASUREMENT_MODE_2 = 1;
-const uint32_t ALT_MEASUREMENT_MODE_3 = 1;
-const uint32_t ALT_MEASUREMENT_MODE_4 = 1;
-const uint32_t ALT_MEASUREMENT_MODE_5 = (uint32_t(ALT_ODR_25) << 16) | (uint32_t(ALT_OSR_PRESS_ULTRAHIGH) << 8) | uint32_t(ALT_OSR_TEMP_LOW);
+typedef BMP388Mode<ALT_ODR_100, ALT_OSR_PRESS_LOW, ALT_OSR_TEMP_ULTRALOW> ALT_MEASUREMENT_MODE_1;
+typedef BMP388Mode<ALT_ODR_25, ALT_OSR_PRESS_ULTRAHIGH, ALT_OSR_TEMP_LOW> ALT_MEASUREMENT_MODE_5;
+
+/**************************************************************************
+    the device specific compensation parameters, as stored in the NVM
+ **************************************************************************/
+struct BMP388CalibrationData {
+  uint16_t PAR_T1;
+  uint16_t PAR_T2;
+  int8_t PAR_T3;
+  int16_t PAR_P1;
+  int16_t PAR_P2;
+  int8_t PAR_P3;
+  int8_t PAR_P4;
+  uint16_t PAR_P5;
+  uint16_t PAR_P6;
+  int8_t PAR_P7;
+  int8_t PAR_P8;
+  int16_t PAR_P9;
+  int8_t PAR_P10;
+  int8_t PAR_P11;
+};
+
+/**************************************************************************
+    a compensated sample from the altimeter
+ **************************************************************************/
+struct altimeterSample {
+  uint8_t status;     /* the 'STATUS' register at the time of the sample (see STATUS_DRDY_PRESS/TEMP) */
+  float pressure;     /* the compensated pressure [Pa] */
+  float temperature;  /* the compensated temperature [degC]. may be up to (decimation - 1) samples old */
+};
 
 /**************************************************************************
     a class for the BMP388 altimeter
  **************************************************************************/
 class PDC_BMP388 {
+  friend class PDC_compensationBench;  /* tools/host times and checks the compensation methods on their own */
+
   private:
     uint32_t readValue(uint8_t data_address0);  /* a private method to read a value at the provided address */
     void getCompensationParams();               /* get the pressure and temperature compensation parameters */
+    void foldCompensationParams();              /* convert the compensation parameters to floating point */
+
+    float compensateTemperature(uint32_t uncompensatedTemperature);    /* datasheet (float) compensation [degC] */
+    float compensatePressure(uint32_t uncompensatedPressure);          /* datasheet (float) compensation [Pa] */
+    int32_t compensateTemperatureInt(uint32_t uncompensatedTemperature); /* reference driver (integer) compensation [0.01degC] */
+    uint32_t compensatePressureInt(uint32_t uncompensatedPressure);      /* reference driver (integer) compensation [0.01Pa] */
+    float updateTemperature(uint32_t uncompensatedTemperature);          /* compensate temperature with whichever method is configured [degC] */
+    float updatePressure(uint32_t uncompensatedPressure);                /* compensate pressure with whichever method is configured [Pa] */
     void addressSet(uint8_t data_0_add);        /* remember the device data and control registers */
+    void configure(uint8_t ODRValue, uint8_t OSRValue); /* write a checked mode to the device */
     
     /* ---------- ATTRIBUTES ---------- */
     uint8_t slaveSelect;  /* the pin on the PDC that the altimeter CS pin connects to. is set on contruction */
     
-    float outputFrequency;            /* the rate at which the device output should refresh (Hz) */
-    uint8_t pressureOversampling;     /* the oversampling of the pressure measurement */
-    uint8_t temperatureOversampling;  /* the oversampling of the temperature measurement */
     uint8_t pressureAddress_0;        /* the address of the first pressure data register */
     uint8_t temperatureAddress_0;     /* the address of the first temperature data register */
-    uint8_t ODR_address;              /* the address of the ODR register (for output frequency) */
-    uint8_t OSR_address;              /* the address of the OSR register (for oversampling config) */
 
-    float temperatureCompensationArray[3];  /* array for the device specific temperature compensation parameters */
-    float pressureCompensationArray[11];    /* array for the device specific pressure compensation parameters */
+    BMP388CalibrationData calibration;      /* the device specific compensation parameters as read from the device */
+    float temperatureCompensationArray[3];  /* array for the device specific temperature compensation parameters (floating point) */
+    float pressureCompensationArray[11];    /* array for the device specific pressure compensation parameters (floating point) */
+    float pressureTerms[3];                 /* the temperature dependent pressure compensation coefficients, updated with each temperature */
+    int64_t linearisedTemperature;          /* the temperature from the integer compensation, as needed for integer pressure compensation */
+
+    uint8_t temperatureDecimation;    /* compensate temperature on one in this many samples */
+    uint8_t samplesSinceTemperature;  /* how many samples since temperature was last compensated */
+    bool temperatureStale;            /* the next sample must compensate temperature, whatever the count says */
+    float lastTemperature;            /* the most recently compensated temperature [degC] */
+
+    float groundPressure;             /* the average pressure on the launch pad [Pa] */
+    float groundAltitude;             /* the altitude of the launch pad, as calculated from groundPressure [m] */
 
   public:
     /* ---------- CONSTRUCTOR ---------- */
     PDC_BMP388(uint8_t CS) {
       slaveSelect = CS;       /* set slaveSelect to the specified SS pin */
       addressSet(DATA_0_REG); /* tell the altimeter where to find its registers */
-      outputFrequency = 0;    /* initialise the device configurations as 0 */
-      pressureOversampling = 0;
-      temperatureOversampling = 0;
+      temperatureDecimation = 1;    /* compensate temperature on every sample until told otherwise */
+      samplesSinceTemperature = 0;
+      temperatureStale = 1;         /* there's no temperature to reuse yet */
+      lastTemperature = 0;
+      groundPressure = 0;
+      groundAltitude = 0;           /* until calibrated, height above ground is altitude above sea level */
     };
 
     /* ---------- METHODS --------- */
     bool isAlive();               /* check if connected and responsive */
     void restart();               /* soft reset the device and enable temp/press measurement */
-    void init(uint32_t input);    /* configure the device over SPI - set the output frequency and resolution */
+
+    /*********************************************************
+       @brief  Initialise the component
+       @tparam the measurement mode (ALT_MEASUREMENT_MODE_n, or
+                any other BMP388Mode)
+     *********************************************************/
+    template <class Mode>
+    void init() {
+      configure(Mode::ODR_VALUE, Mode::OSR_VALUE);
+    }
+
     float readPress();            /* read the raw pressure measurement and convert to 'actual' value [degC] */
     float readTemp();             /* read the raw temperature measurement and convert to 'actual' value [Pa] */
     float readAltitude();         /* use the compensated pressure to calculate absolute altitude [m] */
-    float measureAltitudeNoise(); /* measure the noise in the altitude reading */
+    float readAltitudeAGL();      /* use the compensated pressure to calculate height above the launch site [m] */
+    float heightAboveGround(float pressure); /* convert a compensated pressure [Pa] to height above the launch site [m] */
+    void setGroundPressure(float pressure); /* set the pressure on the pad to use as the ground reference */
+    altimeterSample readSample(); /* read status, pressure and temperature in one transaction and compensate */
+    void setTemperatureDecimation(uint8_t decimation); /* only compensate temperature on one in this many samples */
 };
+
+#endif
@@ -2,4 +2,14 @@
   // current plan is for PDC to be slave, OBC to be master. OBC requests data over I2C, PDC registers this as an
   // interrupt (?) event and goes into a 'write I2C data' subroutine
 
+/* nothing on the PDC talks over I2C yet, and just linking the Wire library costs ~200 bytes of SRAM for its buffers
+   (see the budget in PDC.ino), so it's only compiled in when PDC_I2C is 1 (set it here, or pass -DPDC_I2C=1) */
+#ifndef PDC_I2C
+#define PDC_I2C 0 /* 1 to compile the I2C functions and the Wire library in */
+#endif
+
+#if PDC_I2C
+#include <Wire.h>     /* the RTC is on I2C, so include the library for I2C commands (https://www.arduino.cc/en/reference/wire) */
+
 void readI2C(uint8_t deviceAddress, uint8_t deviceRegister, uint8_t numBytes, uint8_t *result);
+#endif
@@ -1,3 +1,4 @@
+#if PDC_I2C  /* see PDC_I2C.h */
 // TODO can we monitor ACK to register a successful communication?
 // TODO still need to better understand arduino I2C - not something i've encountered before!
 /**
@@ -24,3 +25,4 @@ void readI2C(uint8_t deviceAddress, uint8_t deviceRegister, uint8_t numBytes, ui
 
   /* the input argument 'result' is an array of size numBytes, it is modified, instead of returned, since this is not possible */
 }
+#endif
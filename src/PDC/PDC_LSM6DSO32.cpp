@@ -1,8 +1,6 @@
 // Methods TODO:
 // read temp?
-// measure offset
-// a 'read all' method? what if we want to read x, y, z all at once?
-// add an auto-set for the std dev measurement
+// measure the accelerometer offset (the gyroscope bias and the noise are measured in setup, see PDC_calibration.h)
 
 /* for example usage, see PDC_LSM6DSO32.h */
 
@@ -30,9 +28,10 @@ bool PDC_LSM6DSO32::isAlive() {
    @brief  Restart IMU
  *********************************************************/
 void PDC_LSM6DSO32::restart() {
-  uint8_t dataToWrite = 1 || 1 << 7;  /* set bits 7 and 0 to high which reboots memory and resets software */
-
-  writeSPI(slaveSelect, CTRL3_C_REG, dataToWrite);  /* write the command to the CTRL3_C register */
+  /* bit 7 (BOOT) reboots memory and bit 0 (SW_RESET) resets software. they mustn't be set together, so one at a time */
+  writeSPI(slaveSelect, CTRL3_C_REG, 1 << 7);  /* write the command to the CTRL3_C register */
+  delay(10); /* the reboot takes 10ms */
+  writeSPI(slaveSelect, CTRL3_C_REG, 1);
   delay(2000); /* wait for it to properly start up again */
 }
 
@@ -63,8 +62,8 @@ uint8_t PDC_LSM6DSO32::selfTest() {
 
   uint8_t selfTestAccel = 1;      /* data to write to CTRL5_C to turn accelerometer self test on */
   uint8_t selfTestGyro = 1 << 2;  /* data to write to CTRL5_C to turn gyroscope self test on */
-  accel.init(ACC_ODR_3330, ACC_RNG_4);    /* set accel measurement range to 4g to match datasheet test conditions */
-  gyro.init(GYR_ODR_3330, GYR_RNG_2000);  /* set gyro measurement range to 2000dps to match datasheet test conditions */
+  accel.init<ACC_ODR_3330, ACC_RNG_4>();    /* set accel measurement range to 4g to match datasheet test conditions */
+  gyro.init<GYR_ODR_3330, GYR_RNG_2000>();  /* set gyro measurement range to 2000dps to match datasheet test conditions */
 
   /* ---------- ACCELEROMETER SELF TEST ---------- */
   /* read all 3 accelerometer axes with self-test off */
@@ -125,81 +124,157 @@ uint8_t PDC_LSM6DSO32::selfTest() {
   return (flag);
 }
 
-/*****************************************************************************
-   @brief  set the child slave select to be the defined IMU slave select pin
- *****************************************************************************/
-uint8_t IMUChild::slaveSelect = IMU_SS;
+/*********************************************************
+   @brief  Read all six axes in one transaction
+   @retval the raw gyroscope and accelerometer values,
+           all taken from the same sample instant
+ *********************************************************/
+IMURawSample PDC_LSM6DSO32::readAll() {
+  uint8_t rawValue[ALL_DATA_BYTES]; /* we will read every data byte from the device into here */
+
+  /* the gyroscope registers (OUTX_L_G..OUTZ_H_G) are immediately followed by the accelerometer registers (OUTX_L_A..OUTZ_H_A)
+     so starting at the gyroscope X LSB and letting the address auto-increment reads everything in one burst */
+  readSPI(slaveSelect, GYRX_L_DATA_REG, ALL_DATA_BYTES, rawValue);
+
+  return (unpackAll(rawValue));
+}
+
+/*********************************************************
+   @brief  Queue the readAll() burst, to run along with
+            other queued reads in runSPIQueue()
+   @param  an array of ALL_DATA_BYTES to read into. it
+            must still be there when the queue runs
+   @retval 0 in case of success, 1 otherwise
+ *********************************************************/
+bool PDC_LSM6DSO32::queueReadAll(uint8_t *rawValue) {
+  return (queueSPIRead(slaveSelect, GYRX_L_DATA_REG, ALL_DATA_BYTES, rawValue));
+}
+
+/*********************************************************
+   @brief  Turn the bytes of a readAll() burst into a sample
+   @param  the ALL_DATA_BYTES bytes, as read
+   @retval the raw gyroscope and accelerometer values
+ *********************************************************/
+IMURawSample PDC_LSM6DSO32::unpackAll(const uint8_t *rawValue) {
+  IMURawSample sample;  /* we will concatenate the pairs of bytes into here */
+
+  /* concatenate each LSB/MSB pair by shifting the MSB up by one byte */
+  sample.gyroX  = (rawValue[1] << 8)  | rawValue[0];
+  sample.gyroY  = (rawValue[3] << 8)  | rawValue[2];
+  sample.gyroZ  = (rawValue[5] << 8)  | rawValue[4];
+  sample.accelX = (rawValue[7] << 8)  | rawValue[6];
+  sample.accelY = (rawValue[9] << 8)  | rawValue[8];
+  sample.accelZ = (rawValue[11] << 8) | rawValue[10];
+
+  return (sample);
+}
+
+/*********************************************************
+   @brief  Start batching samples into the FIFO
+   @param  code for the accelerometer batch data rate
+            (same codes as the output update frequency,
+            0 to leave the accelerometer out of the FIFO)
+   @param  code for the gyroscope batch data rate
+   @param  the number of words at which the watermark
+            flag is raised (up to FIFO_MAX_WATERMARK)
+ *********************************************************/
+void PDC_LSM6DSO32::fifoInit(uint8_t accelRate, uint8_t gyroRate, uint16_t watermark) {
+  if (watermark > FIFO_MAX_WATERMARK) {
+    watermark = FIFO_MAX_WATERMARK;
+  }
+
+  /* changing the batch rates is only safe in bypass mode, which also empties anything left over */
+  writeSPI(slaveSelect, FIFO_CTRL4_REG, FIFO_MODE_BYPASS);
+
+  writeSPI(slaveSelect, FIFO_CTRL1_REG, watermark & 255);           /* watermark bits [7:0] */
+  writeSPI(slaveSelect, FIFO_CTRL2_REG, (watermark >> 8) & 1);      /* watermark bit 8 */
+  writeSPI(slaveSelect, FIFO_CTRL3_REG, (gyroRate << 4) | accelRate); /* set bits [7:4] for gyroscope and [3:0] for accelerometer batch rates */
+
+  /* in continuous mode the FIFO keeps collecting, and if we fall behind the oldest words are overwritten rather than the newest lost */
+  writeSPI(slaveSelect, FIFO_CTRL4_REG, FIFO_MODE_CONTINUOUS);
+}
+
+/*********************************************************
+   @brief  Stop batching and empty the FIFO
+ *********************************************************/
+void PDC_LSM6DSO32::fifoStop() {
+  writeSPI(slaveSelect, FIFO_CTRL4_REG, FIFO_MODE_BYPASS);
+}
+
+/*********************************************************
+   @brief  Find how many words are waiting in the FIFO
+   @retval the number of unread words
+ *********************************************************/
+uint16_t PDC_LSM6DSO32::fifoLevel() {
+  uint8_t status[2];  /* FIFO_STATUS1 and FIFO_STATUS2 */
+
+  readSPI(slaveSelect, FIFO_STATUS1_REG, 2, status);
+
+  /* the word count is 10 bits: [7:0] in FIFO_STATUS1 and [9:8] in the bottom of FIFO_STATUS2 */
+  return ((uint16_t(status[1] & 3) << 8) | status[0]);
+}
 
 /*********************************************************
-   @brief  Internally take note of important registers
-   @param  the address of the x-axis LSB data register
-   @param  the address of the control register
+   @brief  Drain words from the FIFO
+   @param  pointer to an array of words to fill
+   @param  the number of words the array can hold
+   @retval the number of words actually read
  *********************************************************/
-void IMUChild::addressSet(uint8_t x_add, uint8_t CTRL_add) {
-  x_address = x_add;        /* set x LSB address attribute as specified */
-  y_address = x_add + 2;    /* y LSB address is then two along */
-  z_address = x_add + 4;    /* z LSB address is another two along */
-  CTRL_address = CTRL_add;  /* and then the address to configure this child */
-
-  /* work out if we've just created an accelerometer or a gyroscope child */
-  if (CTRL_address == ACC_CTRL_REG) {
-    devType = 0;
+uint16_t PDC_LSM6DSO32::fifoRead(IMUFifoWord *buffer, uint16_t maxWords) {
+  uint16_t numWords = fifoLevel(); /* only ask for words that are actually there */
+  uint16_t wordsRead = 0;          /* how many words we have read so far */
+  uint8_t burstWords = 0;          /* how many words we read in the current transaction */
+
+  if (numWords > maxWords) {
+    numWords = maxWords;
+  }
+
+  /* with auto-increment on, the address rolls back from the last FIFO data register to the tag register, so
+     consecutive words can be read in one long burst. the word layout matches IMUFifoWord (and the nano is
+     little endian like the device), so the bytes go straight into the caller's buffer without any copying */
+  while (wordsRead < numWords) {
+    burstWords = ((numWords - wordsRead) > FIFO_MAX_BURST_WORDS) ? FIFO_MAX_BURST_WORDS : (numWords - wordsRead);
+
+    readSPI(slaveSelect, FIFO_DATA_OUT_TAG_REG, burstWords * FIFO_WORD_BYTES, (uint8_t *)&buffer[wordsRead]);
+
+    wordsRead += burstWords;
   }
-  else if (CTRL_address == GYR_CTRL_REG) {
-    devType = 1;
+
+  /* the tag byte is [7:3] sensor tag, [2:1] counter, [0] parity. we only care about which sensor it came from */
+  for (uint16_t i = 0; i < wordsRead; i++) {
+    buffer[i].tag = buffer[i].tag >> 3;
   }
+
+  return (wordsRead);
 }
 
 /*********************************************************
-   @brief  Initialise the component
+   @brief  Internally take note of which IMU we're on
+   @param  the pin on the PDC that the IMU CS pin connects to
+ *********************************************************/
+template <class Sensor>
+void IMUChild<Sensor>::slaveSelectSet(uint8_t CS) {
+  slaveSelect = CS; /* each child talks to the IMU it belongs to, so two IMUs don't share a chip */
+}
+
+/*********************************************************
+   @brief  Write a configuration to the control register
+            (init() has already checked the codes)
    @param  code for output update frequency
    @param  code for measurement range
+   @param  the size of one bit of output at that range
  *********************************************************/
-void IMUChild::init(uint8_t frequency, uint8_t range) {
+template <class Sensor>
+void IMUChild<Sensor>::configure(uint8_t frequency, uint8_t range, float newScale) {
   uint8_t dataToWrite = 0;
 
   dataToWrite |= range << 1;     /* set bits [3:1] to configure range. note accel config actually only uses [3:2] so have padded with bit 1 to make equivalent between devices */
   dataToWrite |= frequency << 4; /* set bits [7:4] to configure output frequency */
 
-  /* set the internally stored output frequency */
-  switch (frequency) {
-    case (0):  outputFrequency = 0;    break;
-    case (1):  outputFrequency = 12.5; break;
-    case (2):  outputFrequency = 26;   break;
-    case (3):  outputFrequency = 52;   break;
-    case (4):  outputFrequency = 104;  break;
-    case (5):  outputFrequency = 208;  break;
-    case (6):  outputFrequency = 416;  break;
-    case (7):  outputFrequency = 833;  break;
-    case (8):  outputFrequency = 1660; break;
-    case (9):  outputFrequency = 3330; break;
-    case (10): outputFrequency = 6660; break;
-    default:  outputFrequency = 0;    break;
-  }
-
-  /* set the internally stored measurement range (if condition checks if accelerometer or gyroscope) */
-  if (devType == 0) {
-    switch (range) {
-      case (0): measurementRange = 4;  break;
-      case (2): measurementRange = 32; break;
-      case (4): measurementRange = 8;  break;
-      case (6): measurementRange = 16; break;
-      default: measurementRange = 0;  break;
-    }
-  } else if (devType == 1) {
-    switch (range) {
-      case (0):  measurementRange = 250;   break;
-      case (1):  measurementRange = 125;   break;
-      case (2):  measurementRange = 500;   break;
-      case (4):  measurementRange = 1000;  break;
-      case (6):  measurementRange = 2000;  break;
-      default:  measurementRange = 0;     break;
-    }
-  }
+  writeSPI(slaveSelect, Sensor::CTRL_REG, dataToWrite);  /* write the data to the control register */
 
-  writeSPI(slaveSelect, CTRL_address, dataToWrite);  /* write the data to the control register */
-
-  resolution = (measurementRange * 2.0 * 1000.0) / 65536.0; /* calculate the device resolution per bit (milli-g or milli-dps) */
+  frequencyCode = frequency;
+  scale = newScale;
 }
 
 /*********************************************************
@@ -207,7 +282,8 @@ void IMUChild::init(uint8_t frequency, uint8_t range) {
    @param  the address of the LSB data register
    @retval the value in g [ac] or dps [gy]
  *********************************************************/
-float IMUChild::readValue(uint8_t LSB_address) {
+template <class Sensor>
+float IMUChild<Sensor>::readValue(uint8_t LSB_address) {
   uint8_t rawValue[2];        /* we will read two bytes from the device into here */
   int16_t rawValueConcat = 0; /* we will concatenate the two bytes into a single value here */
   float measuredValue = 0;    /* and we will convert the concatenated value into a 'measured' value here */
@@ -219,19 +295,46 @@ float IMUChild::readValue(uint8_t LSB_address) {
 
   rawValueConcat = (rawValue[1] << 8) | rawValue[0];  /* concatenate the two bytes into a single val by shifting the MSB up by one byte */
 
-  measuredValue = (float(rawValueConcat) / 1000) * resolution;  /* use the sensor resolution to convert raw value into an actual measurement */
+  measuredValue = convertRaw(rawValueConcat); /* use the sensor scale to convert raw value into an actual measurement */
 
   return (measuredValue);
 }
 
+/*********************************************************
+   @brief  Find the output frequency the device is set to
+   @retval the code for the output update frequency, as
+            passed to init()
+ *********************************************************/
+template <class Sensor>
+uint8_t IMUChild<Sensor>::getFrequencyCode() {
+  return (frequencyCode);
+}
+
+/*********************************************************
+   @brief  Convert a raw register value to a measurement
+   @param  the concatenated raw value from the device
+   @retval the value in g [ac] or dps [gy]
+ *********************************************************/
+template <class Sensor>
+float IMUChild<Sensor>::convertRaw(int16_t raw) {
+  return (raw * scale);
+}
+
 /*********************************************************
    @brief  Read data from the X axis
    @retval the measured X axis value in g [ac] or dps [gy]
  *********************************************************/
-float IMUChild::readX() {
-  float xValue = readValue(x_address);
+template <class Sensor>
+float IMUChild<Sensor>::readX() {
+  float xValue = readValue(Sensor::DATA_REG);
 
-  logFileLine.accelerometerX = xValue;
+  /* store the measurement in the log file structure, in the field for whichever sensor we are */
+  if (!Sensor::GYRO) {
+    logFileLine.accelerometerX = logInt16(xValue * LOG_ACCEL_SCALE);
+  }
+  else {
+    logFileLine.gyroscopeX = logInt16(xValue * LOG_GYRO_SCALE);
+  }
   
   return (xValue);
 }
@@ -240,76 +343,40 @@ float IMUChild::readX() {
    @brief  Read data from the Y axis
    @retval the measured Y axis value in g [ac] or dps [gy]
  *********************************************************/
-float IMUChild::readY() {
-  float yValue = readValue(y_address);
+template <class Sensor>
+float IMUChild<Sensor>::readY() {
+  float yValue = readValue(Sensor::DATA_REG + 2);
 
-  logFileLine.accelerometerY = yValue;
+  /* store the measurement in the log file structure, in the field for whichever sensor we are */
+  if (!Sensor::GYRO) {
+    logFileLine.accelerometerY = logInt16(yValue * LOG_ACCEL_SCALE);
+  }
+  else {
+    logFileLine.gyroscopeY = logInt16(yValue * LOG_GYRO_SCALE);
+  }
   
   return (yValue);
 }
 
 /*********************************************************
-   @brief  Read data from the Y axis
-   @retval the measured Y axis value in g [ac] or dps [gy]
+   @brief  Read data from the Z axis
+   @retval the measured Z axis value in g [ac] or dps [gy]
  *********************************************************/
-float IMUChild::readZ() {
-  float zValue = readValue(z_address);
+template <class Sensor>
+float IMUChild<Sensor>::readZ() {
+  float zValue = readValue(Sensor::DATA_REG + 4);
 
-  logFileLine.accelerometerZ = zValue;
+  /* store the measurement in the log file structure, in the field for whichever sensor we are */
+  if (!Sensor::GYRO) {
+    logFileLine.accelerometerZ = logInt16(zValue * LOG_ACCEL_SCALE);
+  }
+  else {
+    logFileLine.gyroscopeZ = logInt16(zValue * LOG_GYRO_SCALE);
+  }
   
   return (zValue);
 }
 
-/*********************************************************
-   @brief  measure standard deviation of noise in an axis
-   @retval the measurement noise standard devation in
-           g [ac] or dps [gy]
- *********************************************************/
-float IMUChild::measureNoiseZ() {
-  uint8_t numReadings = 50; /* how many readings to calculate standard deviation over */
-  /* stat variables */
-  float stdDev = 0;
-  float mean = 0;
-  float sum = 0;
-  float prev_mean = 0;
-
-  float accZ = 0; /* the acceleration in the z-direction in g */
-
-  float threshold = 0.3/GRAVITY_MAGNITUDE;  /* reject rubbish values that exceed a threshold of reasonable expectation */
-
-  uint32_t startTime = millis();
-  
-  /* for the specified number of readings, measure the acceleration */
-  for (uint8_t i = 1; i < numReadings; i++) {
-    // TODO: consider replacing with a non-blocking function?
-    delay(100); /* force rate of measurements to allow for proper processing */
-
-    accZ = readZ(); /* get z-axis acceleration */
-
-    /* |1 g - measured g| should be approx zero */
-    if (abs(1 - accZ) > threshold) {
-      i -= 1; /* for an erroneous reading, we should take the reading again to avoid skew */
-    }
-    else {
-      /* Welford's algorithm for calculating standard deviation in real time
-          allows us to sidestep a large array of floats which would very quickly eat up memory & limit the samples we can test!
-      */
-      mean = mean + (accZ - mean) / i;
-      sum = sum + (accZ - mean) * (accZ - prev_mean);
-      prev_mean = mean;
-    }
-
-    /* timeout control */
-    if((millis() - startTime) > 10000){
-      break; 
-    }
-  }
-
-  // TODO: determine if we should be dividing by n or by n-1
-  stdDev = pow(sum / float(numReadings), 0.5);
-
-  // TODO: consider putting a cap on stdDev incase of disturbance during setup
-  // TODO: maybe we should go between the measurement modes on the ground and measure stddev in each of them and store results internally??
-
-  return (stdDev);
-}
+/* the two children an IMU has (the template methods above are only compiled for these) */
+template class IMUChild<LSM6DSO32Accel>;
+template class IMUChild<LSM6DSO32Gyro>;
@@ -31,6 +31,10 @@
    const uint8_t IMU_SS = 5;
    PDC_LSM6DSO32 IMU(IMU_SS);
 
+   --- (GLOBALLY) AND A SECOND ONE, ON ITS OWN SLAVE SELECT PIN ---
+   const uint8_t IMU2_SS = 3;
+   PDC_LSM6DSO32 IMU2(IMU2_SS);
+
    --- CHECK IF IMU IS RESPONSIVE (REQUIRES SPI TO BE SET UP) ---
    if (!IMU.isAlive()) {
      // error!
@@ -40,8 +44,9 @@
    IMU.restart();
 
    --- CONFIGURE ACCELEROMETER TO UPDATE AT 3330Hz AND MEASURE ACROSS +/-32g ---
-   IMU.accel.init(ACC_ODR_3330, ACC_RNG_32);
-    // note that this .h file includes aliases for each possible update rate
+   IMU.accel.init<ACC_ODR_3330, ACC_RNG_32>();
+    // note that this .h file includes aliases for each possible update rate. the codes are checked when
+    // compiling, so a code the sensor doesn't have (e.g. a gyroscope range for the accelerometer) won't build
 
    --- READ Z AXIS ACCELERATION ---
    float accelZ = IMU.accel.readZ();
@@ -49,29 +54,70 @@
    --- READ Y AXIS ANGULAR RATE ---
    float rateY = IMU.gyro.readY();
 
+   --- READ ALL SIX AXES FROM THE SAME SAMPLE INSTANT ---
+   IMURawSample sample = IMU.readAll();
+   float accelZ = IMU.accel.convertRaw(sample.accelZ);
+
+   --- READ TWO IMUS BACK-TO-BACK ON THE BUS ---
+   uint8_t raw[2][ALL_DATA_BYTES];
+   IMU.queueReadAll(raw[0]);
+   IMU2.queueReadAll(raw[1]);
+   runSPIQueue();
+   IMURawSample sample2 = IMU2.unpackAll(raw[1]);
+
+   --- STREAM BOTH SENSORS THROUGH THE ON-CHIP FIFO AT 3330Hz, FLAGGING THE WATERMARK AT 64 WORDS ---
+   IMU.fifoInit(ACC_ODR_3330, GYR_ODR_3330, 64);
+   IMUFifoWord words[32];
+   uint16_t numWords = IMU.fifoRead(words, 32);
+   for (uint16_t i = 0; i < numWords; i++) {
+     if (words[i].tag == FIFO_TAG_ACCEL) {
+       float accelZ = IMU.accel.convertRaw(words[i].z);
+     }
+   }
+
  *******************************************************************/
 
 /* for detailed function information, see PDC_LSM6DSO32.cpp */
 
+#ifndef _PDC_LSM6DSO32
+#define _PDC_LSM6DSO32
+
 #include <Arduino.h>  /* bring some arduino syntax into the cpp files */
 #include "PDC_SPI.h"  /* grab our SPI functions */
 #include <stdio.h>    /* std stuff for cpp */
 #include "headers.h"
 #include "PDC_logFile.h"  /* include our log file line structure so we can access the global one defined in main */
 
-const float GRAVITY_MAGNITUDE = 9.80665;    /* set the magnitude of the gravity vector */
-
 /* DEVICE REGISTER ADDRESSES */
 const uint8_t ACCX_L_DATA_REG = 0x28; /* the address of the accelerometer LSB X-axis data register */
 const uint8_t GYRX_L_DATA_REG = 0x22; /* the address of the gyroscope LSB X-axis data register */
+const uint8_t ALL_DATA_BYTES  = 12;   /* the number of bytes across all gyroscope & accelerometer data registers (OUTX_L_G..OUTZ_H_A) */
 const uint8_t ACC_CTRL_REG    = 0x10; /* the address of the accelerometer control register */
 const uint8_t GYR_CTRL_REG    = 0x11; /* the address of the gyroscope control register */
 const uint8_t CTRL3_C_REG     = 0x12; /* the address of the register to reboot memory */
 const uint8_t CTRL5_C_REG     = 0x14; /* the address of the register to turn self-test on/off */
 const uint8_t WHO_AM_I_REG    = 0x0f; /* the address of the 'WHO_AM_I' (identification) register */
 
+const uint8_t FIFO_CTRL1_REG        = 0x07; /* the address of the FIFO watermark threshold register (bits [7:0]) */
+const uint8_t FIFO_CTRL2_REG        = 0x08; /* the address of the register holding FIFO watermark threshold bit 8 */
+const uint8_t FIFO_CTRL3_REG        = 0x09; /* the address of the FIFO batch data rate register */
+const uint8_t FIFO_CTRL4_REG        = 0x0A; /* the address of the FIFO mode register */
+const uint8_t FIFO_STATUS1_REG      = 0x3A; /* the address of the first FIFO status register (number of unread words, bits [7:0]) */
+const uint8_t FIFO_DATA_OUT_TAG_REG = 0x78; /* the address of the FIFO output tag register, which is followed by the six FIFO data registers */
+
 const uint8_t WHO_AM_I_VAL = 0b01101100;  /* the (fixed) value stored in the 'WHO_AM_I' register */
 
+/* FIFO CONFIGURATION */
+const uint8_t FIFO_MODE_BYPASS     = 0;    /* FIFO disabled (and emptied) */
+const uint8_t FIFO_MODE_CONTINUOUS = 6;    /* FIFO keeps collecting, with new samples overwriting the oldest if it fills */
+const uint16_t FIFO_MAX_WATERMARK  = 511;  /* the watermark threshold is a 9 bit value */
+const uint8_t FIFO_WORD_BYTES      = 7;    /* each FIFO word is a tag byte followed by three 2-byte axes */
+const uint8_t FIFO_MAX_BURST_WORDS = 36;   /* the most words we can read in one SPI transaction (36 * 7 = 252 bytes, as readSPI counts bytes in a uint8_t) */
+
+/* FIFO TAGS - IDENTIFY WHICH SENSOR A FIFO WORD CAME FROM */
+const uint8_t FIFO_TAG_GYRO  = 0x01;
+const uint8_t FIFO_TAG_ACCEL = 0x02;
+
 /************************************************************************
                    IMU CONFIG VALUES - WRITE TO CTRL_REG
     --------------------------------------------------------------------
@@ -127,51 +173,122 @@ const uint8_t GYR_RNG_500  = 2;
 const uint8_t GYR_RNG_1000 = 4;
 const uint8_t GYR_RNG_2000 = 6;
 
+/**************************************************************************
+    device descriptors for the two sensors on the LSM6DSO32
+      everything that differs between the accelerometer and gyroscope, all
+        known when compiling. IMUChild takes one of these as its template
+        parameter, so the register addresses are constants and init() can
+        check its codes with static_assert
+      sensitivity() is the size of one bit of output for a range code (g [ac];
+        dps [gy]), or 0 if the sensor has no such code. the values are the
+        datasheet's sensitivity table, not the full scale over 32768: the
+        output doesn't span exactly the range its code is named for (at
+        +/-250dps a bit is 8.75mdps, not 250/32768 = 7.63mdps)
+ **************************************************************************/
+struct LSM6DSO32Accel {
+  static constexpr uint8_t DATA_REG = ACCX_L_DATA_REG;  /* the LSB X-axis data register, with Y and Z two and four along */
+  static constexpr uint8_t CTRL_REG = ACC_CTRL_REG;     /* the control register (output frequency & measurement range) */
+  static constexpr uint8_t MAX_ODR = ACC_ODR_6660;      /* the highest output update frequency code */
+  static constexpr bool GYRO = false;
+
+  static constexpr float sensitivity(uint8_t range) {
+    return ((range == ACC_RNG_4) ? 0.122e-3 : (range == ACC_RNG_8) ? 0.244e-3 : (range == ACC_RNG_16) ? 0.488e-3 :
+            (range == ACC_RNG_32) ? 0.976e-3 : 0);
+  }
+};
+
+struct LSM6DSO32Gyro {
+  static constexpr uint8_t DATA_REG = GYRX_L_DATA_REG;
+  static constexpr uint8_t CTRL_REG = GYR_CTRL_REG;
+  static constexpr uint8_t MAX_ODR = GYR_ODR_6660;
+  static constexpr bool GYRO = true;
+
+  static constexpr float sensitivity(uint8_t range) {
+    return ((range == GYR_RNG_125) ? 4.375e-3 : (range == GYR_RNG_250) ? 8.75e-3 : (range == GYR_RNG_500) ? 17.5e-3 :
+            (range == GYR_RNG_1000) ? 35e-3 : (range == GYR_RNG_2000) ? 70e-3 : 0);
+  }
+};
+
+/**************************************************************************
+    a raw sample of all six axes
+      the members are in the same order as the device data registers
+        (gyroscope X,Y,Z then accelerometer X,Y,Z), and hold the raw two's
+        complement output. use convertRaw() on the accel or gyro child to get g or dps
+ **************************************************************************/
+struct IMURawSample {
+  int16_t gyroX;
+  int16_t gyroY;
+  int16_t gyroZ;
+  int16_t accelX;
+  int16_t accelY;
+  int16_t accelZ;
+};
+
+/**************************************************************************
+    a single word from the FIFO
+      the layout matches the FIFO output registers byte-for-byte (tag then
+        X,Y,Z LSB/MSB) so that burst reads can go straight into an array of
+        these words. packed so that no padding is inserted between members
+      after a read, the tag holds just the sensor tag (FIFO_TAG_ACCEL or
+        FIFO_TAG_GYRO) with the counter and parity bits shifted out
+ **************************************************************************/
+struct IMUFifoWord {
+  uint8_t tag;
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} __attribute__((packed));
+
 /**************************************************************************
     a child of the LSM6DSO32 IMU
-      this class can be instantiated for an accelerometer or a gyroscope
-      the class object then self contains useful bits of info like data
-        address registers, configuration parameters, etc.
-      includes methods to initialise, read data, measure noise
+      this class is instantiated for an accelerometer or a gyroscope by
+        its device descriptor (LSM6DSO32Accel or LSM6DSO32Gyro above)
+      the class object then self contains the configuration it was given
+        and the IMU it belongs to
+      includes methods to initialise and read data
  **************************************************************************/
+template <class Sensor>
 class IMUChild {
   private:
     float readValue(uint8_t LSB_address); /* a private method to read a value at the provided address */
+    void configure(uint8_t frequency, uint8_t range, float newScale); /* write a checked configuration to the device */
 
     /* ---------- ATTRIBUTES ---------- */
-    uint8_t devType;            /* the type of device 0 = accel, 1 = gyro */
-    float outputFrequency;      /* the rate at which the device output should refresh (Hz [ac/gy]) */
-    uint16_t measurementRange;  /* the full scale of measurements (+/- g [ac]; +/- dps [gy]) */
-    float resolution;           /* the resolution of the measurement (milli-g per bit [ac]; milli-dps per bit [gy]) */
-
+    uint8_t frequencyCode;      /* the code for the output update frequency the device is set to */
+    float scale;                /* Sensor::sensitivity() of the measurement range set (g [ac]; dps [gy]). kept here rather than
+                                   fixed by the type, as selfTest() changes the range at runtime */
 
-    uint8_t x_address;          /* the address of the LSB data register in the x-axis */
-    uint8_t y_address;          /* the address of the LSB data register in the y-axis */
-    uint8_t z_address;          /* the address of the LSB data register in the z-axis */
-    uint8_t CTRL_address;       /* the address of the control register (for output frequency / measurement range) */
-
-    static uint8_t slaveSelect; /* the pin on the PDC that connects to the IMU CS pin (static as is same for all children) */
+    uint8_t slaveSelect;        /* the pin on the PDC that connects to the CS pin of the IMU this child belongs to */
 
   public:
     /* ---------- INITIALISER ---------- */
     IMUChild(void): 
-      devType(0),
-      outputFrequency(0),
-      measurementRange(0),
-      resolution(0),
-      x_address(0),
-      y_address(0),
-      z_address(0),
-      CTRL_address(0)
+      frequencyCode(0),
+      scale(0),
+      slaveSelect(0)
     {};
     
     /* ---------- METHODS ---------- */
-    void addressSet(uint8_t x_add, uint8_t CTRL_add); /* remember the device data and control registers */
-    void init(uint8_t f, uint8_t r);  /* configure the device over SPI - set the measurement range & output frequency */
+    void slaveSelectSet(uint8_t CS);  /* remember the SS pin of the IMU this child belongs to */
+
+    /*********************************************************
+       @brief  Initialise the component
+       @tparam code for output update frequency
+       @tparam code for measurement range
+     *********************************************************/
+    template <uint8_t frequency, uint8_t range>
+    void init() {
+      static_assert(frequency <= Sensor::MAX_ODR, "not an output update frequency code");
+      static_assert(Sensor::sensitivity(range) != 0, "not a measurement range code for this sensor");
+
+      configure(frequency, range, Sensor::sensitivity(range));
+    }
+
     float readX();                    /* read data in the X axis */
     float readY();                    /* read data in the Y axis */
     float readZ();                    /* read data in the Z axis */
-    float measureNoiseZ();            /* measure sensor noise */
+    float convertRaw(int16_t raw);    /* convert a raw register value into g [ac] or dps [gy] */
+    uint8_t getFrequencyCode();       /* the code for the output update frequency the device is set to */
 };
 
 /**************************************************************************
@@ -187,18 +304,28 @@ class PDC_LSM6DSO32 {
     uint8_t slaveSelect;  /* the pin on the PDC that the IMU CS pin connects to. is set on contruction */
 
   public:
-    IMUChild accel; /* an accelerometer child */
-    IMUChild gyro;  /* a gyroscope child */
+    IMUChild<LSM6DSO32Accel> accel; /* an accelerometer child */
+    IMUChild<LSM6DSO32Gyro> gyro;   /* a gyroscope child */
 
     /* ---------- CONSTRUCTOR ---------- */
     PDC_LSM6DSO32(uint8_t CS) {
       slaveSelect = CS; /* set slaveSelect to the specified SS pin */
-      accel.addressSet(ACCX_L_DATA_REG, ACC_CTRL_REG);  /* tell the accelerometer where to find its addresses */
-      gyro.addressSet(GYRX_L_DATA_REG, GYR_CTRL_REG);   /* teel the gyroscope where to find its addresses */
+      accel.slaveSelectSet(CS); /* tell the accelerometer which IMU it's on */
+      gyro.slaveSelectSet(CS);  /* tell the gyroscope the same */
     };
 
     /* ---------- METHODS --------- */
-    bool isAlive(); /* check if connected and responsive */
-    void restart(); /* restart the device */
+    bool isAlive();           /* check if connected and responsive */
+    void restart();           /* restart the device */
     uint8_t selfTest();
+    IMURawSample readAll();   /* read all gyroscope and accelerometer axes in a single burst */
+    bool queueReadAll(uint8_t *rawValue);           /* queue the same burst to run with others (see runSPIQueue() in PDC_SPI.ino) */
+    IMURawSample unpackAll(const uint8_t *rawValue); /* turn the bytes of that burst into a sample */
+
+    void fifoInit(uint8_t accelRate, uint8_t gyroRate, uint16_t watermark); /* start batching samples into the FIFO in continuous mode */
+    void fifoStop();                                                        /* stop batching and empty the FIFO */
+    uint16_t fifoLevel();                                                   /* the number of unread words in the FIFO */
+    uint16_t fifoRead(IMUFifoWord *buffer, uint16_t maxWords);              /* drain up to maxWords words from the FIFO into the buffer */
 };
+
+#endif
@@ -1,3 +1,45 @@
+/* the SPI functions and device table. for details and example usage, see PDC_SPI.ino */
+
+#ifndef _PDC_SPI
+#define _PDC_SPI
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <SPI.h>      /* for SPISettings */
+
+const uint32_t CLOCK_RATE_10MHZ = 10000000; /* all devices on the bus are happy with 10MHz clock */
+
+/* the most devices the table can hold. every device read or written through these functions has to be added to it in
+   setup: on the PDC that's the IMU and the altimeter, and the SD card is driven by its own library. each entry is 18
+   bytes of SRAM on the nano, so there's no room kept spare - add one for each sensor fitted to the bus. a device that
+   isn't in the table reads as all zeros, so it fails its checks in setup */
+const uint8_t SPI_MAX_DEVICES = 2;
+const uint8_t SPI_QUEUE_SIZE = 1;   /* the most reads that can be queued up to run together. one for each IMU (see PDC_sensors.h) */
+
+/* a pointer to one of the processor's port output registers (volatile uint8_t * on the nano) */
+typedef decltype(portOutputRegister(0)) PDC_portRegister;
+
+/**************************************************************************
+    a device on the SPI bus
+      found by the pin on the PDC that connects to its slave select pin,
+        with everything a transaction needs worked out once, up front
+ **************************************************************************/
+struct PDC_spiDevice {
+  uint8_t pin;                  /* the pin on the PDC that connects to the device slave select pin */
+  PDC_portRegister selectPort;  /* the port output register that pin is on */
+  uint8_t selectMask;           /* and its bit in that register */
+  uint32_t clock;               /* [Hz] the clock rate the device is talked to at */
+  SPISettings settings;         /* the settings for beginTransaction() */
+
+  uint32_t transactions;        /* how many transactions there have been with the device */
+  uint32_t bytes;               /* how many bytes have been exchanged with it, including register addresses */
+};
+
+bool addSPIDevice(uint8_t deviceSelect, uint32_t clock);
+PDC_spiDevice *getSPIDevice(uint8_t deviceSelect);
 void readSPI(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result);
 void readSPIwithDummy(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result);
 void writeSPI(uint8_t deviceSelect, uint8_t registerSelect, uint8_t data);
+bool queueSPIRead(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result);
+void runSPIQueue();
+
+#endif
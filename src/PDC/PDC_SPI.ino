@@ -9,14 +9,26 @@
     2. all devices are MSB first
     3. all devices are compatible with mode 00 (clock idle low, output: falling edge, capture: rising edge);
 
+   Each device is added to a small table in setup, keyed by its slave select pin. the entry holds what every
+    transaction would otherwise work out again:
+    - the SPISettings, so they aren't rebuilt from the clock rate every time
+    - the port register and bit for the slave select pin. writing the register directly takes a couple of cycles,
+      where digitalWrite() looks the pin up in flash tables every time (~4us on the nano, twice per transaction).
+      the read-modify-write isn't atomic, which is fine as nothing else writes these ports from an interrupt
+    - how many transactions and bytes there have been with the device, for profiling
+   A pin that was never added has no entry, and isn't touched: a read from it gives all zeros, and a write does nothing.
+    a sensor left out of the table then fails its isAlive() check in setup, rather than taking a place it wasn't given
+   Data goes through SPI.transfer(buffer, n), which keeps the next byte ready while the last one is shifting, rather
+    than a call per byte. reads for several devices can be queued and then run together under one beginTransaction(),
+    so reading redundant sensors back-to-back costs only the bytes
+
  ************************** Example usage **************************
 
    --- DEFINE THE PDC PIN THAT CONNECTS TO THE DEVICE SS PIN ---
    const int device_SS = 5;
 
-   --- SET THIS PIN TO AN OUTPUT, AND TAKE IT HIGH (IDLE STATE) ---
-   pinMode(device_SS, OUTPUT);
-   digitalWrite(device_SS, HIGH);
+   --- ADD THE DEVICE TO THE TABLE. THIS SETS THE PIN TO AN OUTPUT, AND TAKES IT HIGH (IDLE STATE) ---
+   addSPIDevice(device_SS, CLOCK_RATE_10MHZ);
 
    --- INITIALISE THE SPI CHANNEL ---
    SPI.begin();
@@ -43,9 +55,118 @@
    uint8_t data = 0b10010101;      some data to write to the address based on what configuration we might want
    writeSPI(deviceSS, registerAddress, data);
 
+   --- READ FROM TWO DEVICES IN ONE GO ---
+   uint8_t first[12];
+   uint8_t second[12];
+   queueSPIRead(device_SS, registerAddress, 12, first);
+   queueSPIRead(otherDevice_SS, registerAddress, 12, second);
+   runSPIQueue();  the results are in first and second once this returns
+
+   --- SEE HOW BUSY THE DEVICE HAS BEEN ---
+   uint32_t bytes = getSPIDevice(device_SS)->bytes;
+
  ***************************************************************************************************************************************************/
 
-const uint32_t CLOCK_RATE_10MHZ = 10000000; /* all devices on the bus are happy with 10MHz clock */
+PDC_spiDevice spiDevices[SPI_MAX_DEVICES];  /* the device table */
+uint8_t numSPIDevices = 0;                  /* how many devices are in it */
+
+/**************************************************************************
+    a read waiting in the queue for runSPIQueue()
+ **************************************************************************/
+struct PDC_spiRead {
+  PDC_spiDevice *device;  /* the device to read from */
+  uint8_t registerSelect; /* the address of the first register to read (with the read bit set) */
+  uint8_t numBytes;       /* how many bytes to read */
+  uint8_t *result;        /* where to put them */
+};
+
+PDC_spiRead spiQueue[SPI_QUEUE_SIZE]; /* the reads waiting to run, in order */
+uint8_t spiQueueLength = 0;           /* how many there are */
+
+/**************************************************************************
+   @brief  Add a device to the table
+   @param  the pin on the PDC that connects to the device slave select pin
+   @param  the clock rate to talk to it at [Hz]
+   @retval 0 in case of success, 1 otherwise (the table is full)
+ **************************************************************************/
+bool addSPIDevice(uint8_t deviceSelect, uint32_t clock) {
+  /* if it's already in the table, just update its clock */
+  PDC_spiDevice *device = NULL;
+  for (uint8_t i = 0; i < numSPIDevices; i++) {
+    if (spiDevices[i].pin == deviceSelect) {
+      device = &spiDevices[i];
+    }
+  }
+
+  if (!device) {
+    if (numSPIDevices >= SPI_MAX_DEVICES) {
+      return (1);
+    }
+    device = &spiDevices[numSPIDevices];
+    numSPIDevices++;
+
+    device->pin = deviceSelect;
+    device->selectPort = portOutputRegister(digitalPinToPort(deviceSelect));
+    device->selectMask = digitalPinToBitMask(deviceSelect);
+    device->transactions = 0;
+    device->bytes = 0;
+
+    /* the pin is an output and idles high (not selected) */
+    digitalWrite(deviceSelect, HIGH);
+    pinMode(deviceSelect, OUTPUT);
+  }
+
+  device->clock = clock;
+  device->settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+
+  return (0);
+}
+
+/**************************************************************************
+   @brief  Find a device in the table
+   @param  the pin on the PDC that connects to the device slave select pin
+   @retval the device, or NULL if it was never added
+ **************************************************************************/
+PDC_spiDevice *getSPIDevice(uint8_t deviceSelect) {
+  /* there are only a handful of devices, so a search is as quick as anything */
+  for (uint8_t i = 0; i < numSPIDevices; i++) {
+    if (spiDevices[i].pin == deviceSelect) {
+      return (&spiDevices[i]);
+    }
+  }
+
+  return (NULL);
+}
+
+/**************************************************************************
+   @brief  Read registers from a device, inside a transaction that has
+            already begun with the device's settings
+   @param  the device
+   @param  the address of the register to read, with the read bit set
+   @param  the number of bytes that we want to read
+   @param  pointer to an array that we store the result in
+   @param  the number of dummy bytes the device sends before the data
+ **************************************************************************/
+void transferSPIRead(PDC_spiDevice *device, uint8_t registerSelect, uint8_t numBytes, uint8_t *result, uint8_t dummyBytes) {
+  *device->selectPort &= ~device->selectMask; /* to communicate with the device, we take its slave select pin on the PDC low */
+
+  SPI.transfer(registerSelect);     /* send the register address (with read bit) so device knows what to send us next */
+
+  /* clock the dummy bytes out and throw them away, so the data goes straight into the caller's array */
+  for (uint8_t i = 0; i < dummyBytes; i++) {
+    SPI.transfer(0x00);
+  }
+
+  /* send nothing. this is us 'listening' to the bus for the values that we have requested. if we have requested multiple
+     bytes, the device will auto-increment the address and send values from the next register in sequence */
+  memset(result, 0, numBytes);
+  SPI.transfer(result, numBytes);
+
+  *device->selectPort |= device->selectMask;  /* stop communications with device by setting the corresponding slave select on the PDC to high */
+
+  device->transactions++;
+  device->bytes += 1 + dummyBytes + numBytes;
+}
 
 /**************************************************************************
    @brief  Read register from device over SPI
@@ -55,29 +176,23 @@ const uint32_t CLOCK_RATE_10MHZ = 10000000; /* all devices on the bus are happy
    @param  pointer to an array that we store the result in
  **************************************************************************/
 void readSPI(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result) {
-  // TODO: lookup 'shiftout()' - seen it mentioned as alternative(?) to SPI.Transfer?
-
   /* ---------- SETUP ---------- */
+  PDC_spiDevice *device = getSPIDevice(deviceSelect);
+  if (!device) {
+    memset(result, 0, numBytes);  /* the device was never added, so there's nothing to talk to it with */
+    return;
+  }
+
   registerSelect = registerSelect | (1 << 7); /* format address r/w bit (MSB). read = 1, write = 0 */
 
   /* ---------- BEGIN TRANSACTION ---------- */
   /* begin a transaction over SPI using our params. this command also stops interrupts from preventing SPI comms */
-  SPI.beginTransaction(SPISettings(CLOCK_RATE_10MHZ, MSBFIRST, SPI_MODE0));
-  digitalWrite(deviceSelect, LOW);  /* to communicate with the device, we take its slave select pin on the PDC low */
+  SPI.beginTransaction(device->settings);
 
   /* ---------- READ FROM REGISTER(S) ---------- */
-  SPI.transfer(registerSelect);     /* send the register address (with read bit) so device knows what to send us next */
-
-  for (uint8_t i = 0; i < numBytes; i++) {
-    result[i] = SPI.transfer(0x00); /* send nothing. this is us 'listening' to the bus for the values that we have requested */
-    
-    /* if we have requested multiple bytes, the device will auto-increment 
-       the address and send values from the next register in sequence next time we 'listen' 
-    */
-  }
+  transferSPIRead(device, registerSelect, numBytes, result, 0);
 
   /* ---------- END TRANSACTION ---------- */
-  digitalWrite(deviceSelect, HIGH); /* stop communications with device by setting the corresponding slave select on the PDC to high */
   SPI.endTransaction();             /* we're done now! restart interrupt mechanisms */
 
   /* *result is then modified, and caller can access it for the read data */
@@ -94,16 +209,16 @@ void readSPI(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uin
             (size of array is number of useful bytes)
  **************************************************************************/
 void readSPIwithDummy(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result){
-  uint8_t numBytesWithDummy = numBytes + 1; /* the dummy means we need to read an additional byte */
-  uint8_t dummyBuffer[numBytesWithDummy];   /* this buffer will store our dummy byte and actual data */
-
-  /* read the data into the widened buffer */
-  readSPI(deviceSelect, registerSelect, numBytesWithDummy, dummyBuffer);
-  
-  /* transfer the requested data into the supplied buffer */
-  for(uint8_t i = 0; i < numBytes; i++){
-    result[i] = dummyBuffer[i + 1];
+  /* the same as readSPI(), but with one byte dropped on the wire rather than read into a bigger buffer and copied */
+  PDC_spiDevice *device = getSPIDevice(deviceSelect);
+  if (!device) {
+    memset(result, 0, numBytes);
+    return;
   }
+
+  SPI.beginTransaction(device->settings);
+  transferSPIRead(device, registerSelect | (1 << 7), numBytes, result, 1);
+  SPI.endTransaction();
 }
 
 /**************************************************************************
@@ -114,20 +229,82 @@ void readSPIwithDummy(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numB
  **************************************************************************/
 void writeSPI(uint8_t deviceSelect, uint8_t registerSelect, uint8_t data) {
   /* ---------- SETUP ---------- */
+  PDC_spiDevice *device = getSPIDevice(deviceSelect);
+  if (!device) {
+    return;
+  }
+
   /* format address r/w bit (MSB). read = 1, write = 0 */
   registerSelect = registerSelect | (0 << 7);
 
   /* ---------- BEGIN TRANSACTION ---------- */
   /* begin a transaction over SPI using our params. this command also stops interrupts from preventing SPI comms */
-  SPI.beginTransaction(SPISettings(CLOCK_RATE_10MHZ, MSBFIRST, SPI_MODE0));
-  digitalWrite(deviceSelect, LOW);  /* to communicate with the device, we take its slave select pin on the PDC low */
+  SPI.beginTransaction(device->settings);
+  *device->selectPort &= ~device->selectMask; /* to communicate with the device, we take its slave select pin on the PDC low */
 
   /* ---------- WRITE TO REGISTER ---------- */
   // TODO: is it possible or required to send more than one byte? if so, add support
-  SPI.transfer(registerSelect); /* send the register address (with write bit) so device knows where we want to put our data */
-  SPI.transfer(data);           /* send the data that we want to write to the selected register */
+  /* send the register address (with write bit) so device knows where we want to put our data, then the data */
+  uint8_t frame[2] = {registerSelect, data};
+  SPI.transfer(frame, 2);
 
   /* ---------- END TRANSACTION ---------- */
-  digitalWrite(deviceSelect, HIGH); /* stop communications with device by setting the corresponding slave select on the PDC to high */
+  *device->selectPort |= device->selectMask;  /* stop communications with device by setting the corresponding slave select on the PDC to high */
   SPI.endTransaction();             /* we're done now! restart interrupt mechanisms */
+
+  device->transactions++;
+  device->bytes += 2;
+}
+
+/**************************************************************************
+   @brief  Queue a register read to run with the others in runSPIQueue()
+   @param  the pin on the PDC that connects to the device slave select pin
+   @param  the address of the register to read
+   @param  the number of bytes that we want to read
+   @param  pointer to an array to store the result in. it's only filled
+            in when the queue runs, so it must still be there then
+   @retval 0 in case of success, 1 otherwise (the queue is full, or the
+            device was never added)
+ **************************************************************************/
+bool queueSPIRead(uint8_t deviceSelect, uint8_t registerSelect, uint8_t numBytes, uint8_t *result) {
+  PDC_spiDevice *device = getSPIDevice(deviceSelect);
+  if ((spiQueueLength >= SPI_QUEUE_SIZE) || !device) {
+    return (1);
+  }
+
+  PDC_spiRead &read = spiQueue[spiQueueLength];
+  read.device = device;
+  read.registerSelect = registerSelect | (1 << 7); /* read bit */
+  read.numBytes = numBytes;
+  read.result = result;
+  spiQueueLength++;
+
+  return (0);
+}
+
+/**************************************************************************
+   @brief  Run every queued read, in order, and empty the queue
+ **************************************************************************/
+void runSPIQueue() {
+  if (spiQueueLength == 0) {
+    return;
+  }
+
+  /* one transaction for the lot, unless a device needs a different clock */
+  uint32_t clock = spiQueue[0].device->clock;
+  SPI.beginTransaction(spiQueue[0].device->settings);
+
+  for (uint8_t i = 0; i < spiQueueLength; i++) {
+    PDC_spiRead &read = spiQueue[i];
+    if (read.device->clock != clock) {
+      SPI.endTransaction();
+      clock = read.device->clock;
+      SPI.beginTransaction(read.device->settings);
+    }
+
+    transferSPIRead(read.device, read.registerSelect, read.numBytes, read.result, 0);
+  }
+
+  SPI.endTransaction();
+  spiQueueLength = 0;
 }
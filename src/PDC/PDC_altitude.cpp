@@ -0,0 +1,42 @@
+/* for example usage, see PDC_altitude.h */
+
+#include "PDC_altitude.h"
+
+/* altitude [m] at ALT_TABLE_MIN_PRESSURE + (i * ALT_TABLE_STEP), from 44330 * (1 - (p / 101325)^0.190295) */
+const float ALTITUDE_TABLE[ALT_TABLE_ENTRIES] PROGMEM = {
+   5575.210,  5428.893,  5284.882,  5143.095,  5003.458,  4865.900,
+   4730.352,  4596.750,  4465.032,  4335.141,  4207.020,  4080.617,
+   3955.880,  3832.763,  3711.217,  3591.200,  3472.668,  3355.582,
+   3239.902,  3125.592,  3012.616,  2900.938,  2790.528,  2681.352,
+   2573.380,  2466.583,  2360.933,  2256.403,  2152.966,  2050.598,
+   1949.273,  1848.969,  1749.663,  1651.332,  1553.956,  1457.514,
+   1361.987,  1267.355,  1173.599,  1080.702,   988.647,   897.416,
+    806.993,   717.363,   628.509,   540.418,   453.074,   366.464,
+    280.574,   195.391,   110.901,    27.093,   -56.046,  -138.527,
+   -220.363,  -301.564,  -382.141,  -462.105,  -541.466,  -620.235,
+   -698.420
+};
+
+/*********************************************************
+   @brief  Convert pressure to altitude
+   @param  the atmospheric pressure [Pa]
+   @retval the altitude above sea level [m]
+ *********************************************************/
+float pressureToAltitude(float pressure) {
+  float position = (pressure - ALT_TABLE_MIN_PRESSURE) * (1.0 / ALT_TABLE_STEP); /* how far along the table we are, in entries */
+  uint8_t index = 0;                                                             /* the table entry below us */
+
+  /* find the entry, clamping to the end segments - outside the table we extrapolate along them */
+  if (position >= (ALT_TABLE_ENTRIES - 2)) {
+    index = ALT_TABLE_ENTRIES - 2;
+  }
+  else if (position > 0) {
+    index = uint8_t(position);
+  }
+
+  float lower = pgm_read_float(&ALTITUDE_TABLE[index]);     /* the entries either side of us are in flash */
+  float upper = pgm_read_float(&ALTITUDE_TABLE[index + 1]);
+
+  /* linearly interpolate between them */
+  return (lower + (upper - lower) * (position - float(index)));
+}
@@ -0,0 +1,37 @@
+/*******************************************************************
+   In this file we define a fast pressure -> altitude conversion
+   The standard atmosphere equation
+      altitude = 44330 * (1 - (p / 1013.25hPa)^0.190295)
+    needs a pow() call, which on the nano (no floating point unit)
+    is by far the most expensive part of reading the altimeter.
+   Instead, the equation has been evaluated offline every 10hPa
+    from 500hPa to 1100hPa (roughly -700m to 5500m, which covers any
+    launch site we're likely to use plus the height of the flight),
+    and the table is stored in flash (PROGMEM) so it costs no RAM.
+    between table entries we interpolate linearly, so a conversion
+    is one multiply to find the entry, two flash reads and one
+    multiply-add.
+   Maximum error against the full equation is 0.3m within the table
+    band (worst at the low pressure end, where the curve bends most).
+    outside the band the end segments are extrapolated, so the error
+    grows the further out we go.
+ ************************** Example usage **************************
+
+   --- CONVERT A PRESSURE [Pa] TO ALTITUDE ABOVE SEA LEVEL [m] ---
+   float altitude = pressureToAltitude(101325.0);
+
+ *******************************************************************/
+
+#ifndef _PDC_ALTITUDE
+#define _PDC_ALTITUDE
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files (and PROGMEM) */
+#include <stdio.h>    /* std stuff for cpp */
+
+const float ALT_TABLE_MIN_PRESSURE = 50000.0; /* [Pa] the pressure of the first table entry */
+const float ALT_TABLE_STEP         = 1000.0;  /* [Pa] the pressure step between table entries */
+const uint8_t ALT_TABLE_ENTRIES    = 61;      /* the number of entries in the table (50000Pa to 110000Pa inclusive) */
+
+float pressureToAltitude(float pressure); /* convert pressure [Pa] to altitude above sea level [m] */
+
+#endif
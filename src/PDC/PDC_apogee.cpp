@@ -0,0 +1,168 @@
+/* for example usage, see PDC_apogee.h */
+
+#include "PDC_apogee.h"  /* include the definition of the class */
+
+/*********************************************************
+   @brief  Forget everything, ready for a new flight
+ *********************************************************/
+void PDC_apogee::reset() {
+  launched = 0;
+  launchTime = 0;
+  decided = 0;
+  decisionTime = 0;
+  detectors = 0;
+  for (uint8_t i = 0; i < APOGEE_DETECTORS; i++) {
+    detectorTime[i] = 0;
+  }
+
+  velocityBelow = 0;
+
+  windowIndex = 0;
+  windowCount = 0;
+  lowestPressure = INFINITY;
+}
+
+/*********************************************************
+   @brief  Start the clock at liftoff
+   @param  the time of liftoff [us]
+ *********************************************************/
+void PDC_apogee::launch(uint32_t time) {
+  if (!launched) {
+    launched = 1;
+    launchTime = time;
+  }
+}
+
+/*********************************************************
+   @brief  Give the velocity detector a new estimate
+   @param  the vertical velocity estimate [m/s]
+   @param  the time of the estimate [us]
+ *********************************************************/
+void PDC_apogee::updateVelocity(float velocity, uint32_t time) {
+  updateTime(time);
+
+  if (!launched || ((time - launchTime) < config.lockoutTime)) {
+    return;
+  }
+
+  /* it has to stay below the threshold, so one noisy estimate starts the count again */
+  if (velocity < -config.velocityThreshold) {
+    if (velocityBelow < config.velocityCount) {
+      velocityBelow++;
+    }
+  }
+  else {
+    velocityBelow = 0;
+  }
+
+  if (velocityBelow >= config.velocityCount) {
+    fire(APOGEE_DETECTOR_VELOCITY, time);
+  }
+}
+
+/*********************************************************
+   @brief  Give the pressure detector a new sample
+   @param  the (fresh) altimeter pressure [Pa]
+   @param  the time of the sample [us]
+ *********************************************************/
+void PDC_apogee::updatePressure(float pressure, uint32_t time) {
+  updateTime(time);
+
+  /* keep the window full from the start, so there's a whole window to average as soon as the lockout ends */
+  pressureWindow[windowIndex] = pressure;
+  windowIndex = (windowIndex + 1) % APOGEE_WINDOW;
+  if (windowCount < APOGEE_WINDOW) {
+    windowCount++;
+  }
+
+  if (!launched || ((time - launchTime) < config.lockoutTime) || (windowCount < APOGEE_WINDOW)) {
+    return;
+  }
+
+  /* add the window up from scratch each time, rather than keeping a running total that would drift */
+  float average = 0;
+  for (uint8_t i = 0; i < APOGEE_WINDOW; i++) {
+    average += pressureWindow[i];
+  }
+  average /= APOGEE_WINDOW;
+
+  /* pressure is lowest at apogee, so once it has risen far enough above the lowest we've seen, we're past it */
+  if (average < lowestPressure) {
+    lowestPressure = average;
+  }
+  else if ((average - lowestPressure) > config.pressureRise) {
+    fire(APOGEE_DETECTOR_PRESSURE, time);
+  }
+}
+
+/*********************************************************
+   @brief  Let the timer detector check the time
+   @param  the current time [us]
+ *********************************************************/
+void PDC_apogee::updateTime(uint32_t time) {
+  if (launched && ((time - launchTime) >= config.backupTime)) {
+    fire(APOGEE_DETECTOR_TIMER, time);
+  }
+}
+
+/*********************************************************
+   @brief  Record a detector's vote, and declare apogee if
+            there are enough
+   @param  the detector that has fired
+   @param  the time it fired [us]
+ *********************************************************/
+void PDC_apogee::fire(uint8_t detector, uint32_t time) {
+  /* each detector only votes once, and its time is when it first fired */
+  if (detectors & (1 << detector)) {
+    return;
+  }
+  detectors |= (1 << detector);
+  detectorTime[detector] = time - launchTime;
+
+  uint8_t votes = 0;
+  for (uint8_t i = 0; i < APOGEE_DETECTORS; i++) {
+    if (detectors & (1 << i)) {
+      votes += config.votes[i];
+    }
+  }
+
+  if (!decided && (votes >= config.votesNeeded)) {
+    decided = 1;
+    decisionTime = time - launchTime;
+  }
+}
+
+/*********************************************************
+   @brief  Check if apogee has been declared
+   @retval 1 if it has, 0 otherwise
+ *********************************************************/
+bool PDC_apogee::isApogee() {
+  return (decided);
+}
+
+/*********************************************************
+   @brief  Find which detectors have fired
+   @retval bit n is set if detector n has fired
+ *********************************************************/
+uint8_t PDC_apogee::getDetectors() {
+  return (detectors);
+}
+
+/*********************************************************
+   @brief  Find when a detector fired
+   @param  the detector
+   @retval the time after liftoff that it fired [us], or 0
+            if it hasn't
+ *********************************************************/
+uint32_t PDC_apogee::getDetectorTime(uint8_t detector) {
+  return ((detector < APOGEE_DETECTORS) ? detectorTime[detector] : 0);
+}
+
+/*********************************************************
+   @brief  Find when apogee was declared
+   @retval the time after liftoff [us], or 0 if it hasn't
+            been
+ *********************************************************/
+uint32_t PDC_apogee::getDecisionTime() {
+  return (decisionTime);
+}
@@ -0,0 +1,147 @@
+/*******************************************************************
+   In this file we define the apogee detection engine
+   No one measurement tells us reliably that we've reached apogee,
+    so several independent detectors run side by side, and each
+    one votes when it thinks apogee has passed:
+    + VELOCITY: the Kalman velocity estimate has been below
+       -velocityThreshold for velocityCount estimates in a row. the
+       threshold gives some hysteresis, so noise on an estimate
+       that is hovering around zero can't trigger it
+    + PRESSURE: the average of the last APOGEE_WINDOW altimeter
+       samples has risen pressureRise above the lowest average seen.
+       this uses the altimeter alone, so it still works if the
+       accelerometer (and so the filter) has gone wrong
+    + TIMER: backupTime has passed since liftoff - the backstop in
+       case both sensors have failed
+   Apogee is declared once the votes of the detectors that have
+    fired add up to votesNeeded, so the voting is set by the weights
+    (e.g. weights {1, 1, 2} with 2 needed: both sensors agree, or the
+    timer alone). the sensor detectors can't vote until lockoutTime
+    after liftoff, which covers the motor burn and the pressure
+    errors that come with it
+   The engine only sees the numbers it is given, with their times,
+    so exactly the same code can be replayed on logged or simulated
+    flight data (see tools/PDC_apogeeReplay.cpp)
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE AN ENGINE WITH THE DEFAULT CONFIGURATION ---
+   PDC_apogee apogeeDetector(APOGEE_DEFAULT_CONFIG);
+
+   --- AT LIFTOFF, START THE CLOCK ---
+   apogeeDetector.launch(micros());
+
+   --- FEED IT EACH NEW MEASUREMENT AS IT ARRIVES, AND CHECK FOR A DECISION ---
+   apogeeDetector.updateVelocity(velocityEstimate, micros());
+   apogeeDetector.updatePressure(pressure, micros());
+   apogeeDetector.updateTime(micros());
+   if (apogeeDetector.isApogee()) {
+     // apogee!
+   }
+
+   --- SEE WHICH DETECTORS HAVE FIRED, AND WHEN ---
+   if (apogeeDetector.getDetectors() & (1 << APOGEE_DETECTOR_PRESSURE)) {
+     uint32_t firedAfter = apogeeDetector.getDetectorTime(APOGEE_DETECTOR_PRESSURE); // [us] after liftoff
+   }
+
+ *******************************************************************/
+
+#ifndef _PDC_APOGEE
+#define _PDC_APOGEE
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+/* ---------- DETECTORS ---------- */
+const uint8_t APOGEE_DETECTOR_VELOCITY = 0;
+const uint8_t APOGEE_DETECTOR_PRESSURE = 1;
+const uint8_t APOGEE_DETECTOR_TIMER    = 2;
+const uint8_t APOGEE_DETECTORS         = 3;
+
+const uint8_t APOGEE_WINDOW = 8;  /* [samples] the pressure detector averages this many (0.32s at 25Hz) */
+
+/**************************************************************************
+    the settings for the apogee detection engine
+ **************************************************************************/
+struct PDC_apogeeConfig {
+  uint32_t lockoutTime;             /* [us] after liftoff before the sensor detectors can vote */
+  uint32_t backupTime;              /* [us] after liftoff when the timer votes */
+  float velocityThreshold;          /* [m/s] how far below zero the velocity estimate has to be */
+  uint8_t velocityCount;            /* how many estimates in a row have to be below it */
+  float pressureRise;               /* [Pa] how far the pressure has to rise above its lowest */
+  uint8_t votes[APOGEE_DETECTORS];  /* the weight of each detector's vote */
+  uint8_t votesNeeded;              /* the total weight needed to declare apogee */
+};
+
+/*
+    the lockout and backup times come from the flight the motor gives. until the motor is chosen, that's the flight the
+     host build flies (tools/host/PDC_hostSensors.cpp flies these same numbers): boost for the burn time, then coast.
+     with no drag, apogee comes 22.5s after liftoff. drag only ever brings it earlier, so that's the latest it can be
+     for a given motor, and a motor that gives 10% more impulse than its nominal takes it to 24.5s
+    + replaying those flights (tools/PDC_apogeeReplay.cpp, lockout=0) neither sensor detector votes before apogee, so
+       the lockout only has to cover what the model leaves out: the burnout transient, and drag. it ends halfway to
+       the no-drag apogee, 4.5 burn times in. for apogee to come before then, drag would have to average over 1.3g
+       through the coast, far more than it does at the ~200m/s (Mach 0.6) the rocket burns out at
+    + the timer votes just after the latest apogee, so if both sensors have failed the parachute still goes out
+       within ~2.5s of a nominal apogee (~25m/s of fall), rather than after 7.5s (~75m/s) as it used to
+*/
+constexpr float APOGEE_FLIGHT_BOOST = 8.0;           /* [g] the motor's mean acceleration */
+constexpr float APOGEE_FLIGHT_BURN_TIME = 2.5;       /* [s] */
+constexpr float APOGEE_FLIGHT_IMPULSE_SPREAD = 0.1;  /* how far over its nominal total impulse the motor can be */
+constexpr float APOGEE_FLIGHT_APOGEE_TIME = APOGEE_FLIGHT_BURN_TIME * (1 + APOGEE_FLIGHT_BOOST); /* [s] after liftoff, with no drag */
+constexpr float APOGEE_FLIGHT_LATEST_APOGEE_TIME = APOGEE_FLIGHT_BURN_TIME * (1 + APOGEE_FLIGHT_BOOST * (1 + APOGEE_FLIGHT_IMPULSE_SPREAD));
+
+const PDC_apogeeConfig APOGEE_DEFAULT_CONFIG = {
+  uint32_t(0.5 * APOGEE_FLIGHT_APOGEE_TIME * 1e6),         /* no sensor votes for 11.25s, halfway to apogee */
+  uint32_t((APOGEE_FLIGHT_LATEST_APOGEE_TIME + 0.5) * 1e6), /* the timer votes 25s after liftoff, just after the latest apogee */
+  1.0,        /* the velocity estimate must be below -1m/s... */
+  3,          /* ...for 3 estimates (0.12s at the 25Hz flight task rate) */
+  10.0,       /* the average pressure must rise 10Pa (~0.8m) above its lowest */
+  {1, 1, 2},  /* velocity and pressure have one vote each, the timer two */
+  2           /* so both sensors have to agree, or the timer decides on its own */
+};
+
+/**************************************************************************
+    a class for detecting apogee
+ **************************************************************************/
+class PDC_apogee {
+  private:
+    void fire(uint8_t detector, uint32_t time); /* record a detector's vote and count up the votes */
+
+    /* ---------- ATTRIBUTES ---------- */
+    const PDC_apogeeConfig &config; /* the settings, which stay in the caller's (constant) storage */
+
+    bool launched;                      /* the clock has started */
+    uint32_t launchTime;                /* [us] the time of liftoff */
+    bool decided;                       /* apogee has been declared */
+    uint32_t decisionTime;              /* [us] after liftoff that apogee was declared */
+    uint8_t detectors;                  /* bit n is set once detector n has fired */
+    uint32_t detectorTime[APOGEE_DETECTORS]; /* [us] after liftoff that each detector fired */
+
+    uint8_t velocityBelow;              /* how many velocity estimates in a row have been below the threshold */
+
+    float pressureWindow[APOGEE_WINDOW]; /* [Pa] the most recent pressure samples */
+    uint8_t windowIndex;                /* where the next sample goes */
+    uint8_t windowCount;                /* how many samples are in the window */
+    float lowestPressure;               /* [Pa] the lowest window average since the lockout ended */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_apogee(const PDC_apogeeConfig &configuration):
+      config(configuration)
+    {
+      reset();
+    };
+
+    /* ---------- METHODS --------- */
+    void reset();                                   /* forget everything, ready for a new flight */
+    void launch(uint32_t time);                     /* start the clock at liftoff [us] */
+    void updateVelocity(float velocity, uint32_t time); /* a new velocity estimate [m/s] at a time [us] */
+    void updatePressure(float pressure, uint32_t time); /* a new altimeter sample [Pa] at a time [us] */
+    void updateTime(uint32_t time);                 /* let the timer check the time [us] */
+    bool isApogee();                                /* check if apogee has been declared */
+    uint8_t getDetectors();                         /* which detectors have fired, as bits */
+    uint32_t getDetectorTime(uint8_t detector);     /* [us] after liftoff that a detector fired */
+    uint32_t getDecisionTime();                     /* [us] after liftoff that apogee was declared */
+};
+
+#endif
@@ -0,0 +1,188 @@
+/* for example usage, see PDC_attitude.h */
+
+#include "PDC_attitude.h"  /* include the definition of the class */
+#include "PDC_profiler.h"  /* for timing the update */
+
+/*********************************************************
+   @brief  Fast approximate inverse square root
+   @param  the value (must be positive)
+   @retval 1/sqrt(value)
+ *********************************************************/
+float invSqrt(float x) {
+  /* halving the exponent bits of a float roughly halves its log, which is a good first guess at x^-0.5. one
+     Newton step then squares the error away. this relies on float being 32 bit IEEE, as it is on the nano */
+  union {
+    float f;
+    int32_t i;
+  } guess = {x};
+
+  guess.i = 0x5f3759df - (guess.i >> 1);
+  guess.f *= 1.5 - (0.5 * x * guess.f * guess.f);
+
+  return (guess.f);
+}
+
+/*********************************************************
+   @brief  Start from the attitude given by gravity alone
+   @param  the accelerometer reading at rest [g], x
+   @param  y
+   @param  z
+ *********************************************************/
+void PDC_attitude::init(float ax, float ay, float az) {
+  /* roll and pitch from the direction of gravity. there's nothing to give us yaw, so that starts at zero */
+  float roll = atan2(ay, az);
+  float pitch = atan2(-ax, sqrt(ay * ay + az * az));
+
+  float cr = cos(roll / 2);
+  float sr = sin(roll / 2);
+  float cp = cos(pitch / 2);
+  float sp = sin(pitch / 2);
+
+  q0 = cr * cp;
+  q1 = sr * cp;
+  q2 = cr * sp;
+  q3 = -sr * sp;
+
+  integralX = integralY = integralZ = 0;
+  running = 0;
+}
+
+/*********************************************************
+   @brief  Update the attitude with a new IMU sample
+   @param  the gyroscope rate [dps], x
+   @param  y
+   @param  z
+   @param  the accelerometer reading [g], x
+   @param  y
+   @param  z
+   @param  the time of the sample [us]
+ *********************************************************/
+void PDC_attitude::update(float gx, float gy, float gz, float ax, float ay, float az, uint32_t time) {
+  PROFILE_SECTION(PROFILE_ATTITUDE);
+
+  /* the first sample just starts the clock. unsigned difference, so the micros() rollover doesn't matter */
+  if (!running) {
+    lastTime = time;
+    running = 1;
+    return;
+  }
+  uint32_t elapsed = time - lastTime;
+  if (int32_t(elapsed) <= 0) {
+    return;
+  }
+  lastTime = time;
+  float dt = elapsed * 1e-6;
+
+  gx *= ATTITUDE_DEG_TO_RAD;
+  gy *= ATTITUDE_DEG_TO_RAD;
+  gz *= ATTITUDE_DEG_TO_RAD;
+
+  /* ---------- correct towards the accelerometer ---------- */
+  /* only when it's (near enough) measuring gravity alone. comparing |a|^2 saves a square root */
+  float accelSquared = ax * ax + ay * ay + az * az;
+  if ((accelSquared > ATTITUDE_GRAVITY_MIN) && (accelSquared < ATTITUDE_GRAVITY_MAX)) {
+    float recipNorm = invSqrt(accelSquared);  /* only the direction matters, so 0.2% error in the length is fine */
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    /* the direction the accelerometer should be reading gravity in, if our attitude is right (half of it - the
+       2s are folded into the gains below) */
+    float vx = q1 * q3 - q0 * q2;
+    float vy = q0 * q1 + q2 * q3;
+    float vz = q0 * q0 - 0.5 + q3 * q3;
+
+    /* the error is the rotation between the two, a x v */
+    float ex = ay * vz - az * vy;
+    float ey = az * vx - ax * vz;
+    float ez = ax * vy - ay * vx;
+
+    integralX += (2 * ATTITUDE_KI) * ex * dt;
+    integralY += (2 * ATTITUDE_KI) * ey * dt;
+    integralZ += (2 * ATTITUDE_KI) * ez * dt;
+
+    gx += (2 * ATTITUDE_KP) * ex + integralX;
+    gy += (2 * ATTITUDE_KP) * ey + integralY;
+    gz += (2 * ATTITUDE_KP) * ez + integralZ;
+  }
+  else {
+    /* the integral still applies, it's our best guess at what's left of the bias */
+    gx += integralX;
+    gy += integralY;
+    gz += integralZ;
+  }
+
+  /* ---------- rotate by the rate over dt ---------- */
+  /* q = q + (0.5 * q * (0, g)) * dt */
+  gx *= 0.5 * dt;
+  gy *= 0.5 * dt;
+  gz *= 0.5 * dt;
+
+  float a = q0;
+  float b = q1;
+  float c = q2;
+  q0 += -b * gx - c * gy - q3 * gz;
+  q1 += a * gx + c * gz - q3 * gy;
+  q2 += a * gy - b * gz + q3 * gx;
+  q3 += a * gz + b * gy - c * gx;
+
+  /* ---------- renormalise, so rounding doesn't build up ---------- */
+  /* one step only moves |q|^2 a tiny way from 1, and close to 1, 1/sqrt(x) = (3 - x)/2 to within 3(x - 1)^2/8.
+     that's far closer than invSqrt() gets (0.2%), which matters here as the angles assume |q| = 1 */
+  float recipNorm = 0.5 * (3 - (q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3));
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+/*********************************************************
+   @brief  Get the attitude quaternion
+   @param  returns w, x, y, z
+ *********************************************************/
+void PDC_attitude::getQuaternion(float q[4]) {
+  q[0] = q0;
+  q[1] = q1;
+  q[2] = q2;
+  q[3] = q3;
+}
+
+/*********************************************************
+   @brief  Get the direction of gravity
+   @param  returns the unit vector that gravity pulls
+            along, in the body frame ((0, 0, -1) when
+            level)
+ *********************************************************/
+void PDC_attitude::getGravity(float g[3]) {
+  g[0] = -2 * (q1 * q3 - q0 * q2);
+  g[1] = -2 * (q0 * q1 + q2 * q3);
+  g[2] = -(q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3);
+}
+
+/*********************************************************
+   @brief  Get the roll
+   @retval rotation about the body x axis [deg]
+ *********************************************************/
+float PDC_attitude::getRoll() {
+  return (atan2(2 * (q0 * q1 + q2 * q3), 1 - 2 * (q1 * q1 + q2 * q2)) * ATTITUDE_RAD_TO_DEG);
+}
+
+/*********************************************************
+   @brief  Get the pitch
+   @retval rotation about the body y axis [deg]
+ *********************************************************/
+float PDC_attitude::getPitch() {
+  float s = 2 * (q0 * q2 - q3 * q1);
+  s = constrain(s, -1.0, 1.0); /* rounding can take it just past +/-1 at +/-90deg, where asin isn't defined */
+
+  return (asin(s) * ATTITUDE_RAD_TO_DEG);
+}
+
+/*********************************************************
+   @brief  Get the yaw
+   @retval rotation about the body z axis since startup
+            [deg]
+ *********************************************************/
+float PDC_attitude::getYaw() {
+  return (atan2(2 * (q0 * q3 + q1 * q2), 1 - 2 * (q2 * q2 + q3 * q3)) * ATTITUDE_RAD_TO_DEG);
+}
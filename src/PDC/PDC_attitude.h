@@ -0,0 +1,88 @@
+/*******************************************************************
+   In this file we define the attitude estimator
+   The attitude is kept as a unit quaternion, rotating the body
+    (IMU) frame into the Earth frame. every IMU sample turns it by
+    the gyroscope rate over the time since the last sample, and then
+    nudges it so that 'down' agrees with the accelerometer (a Mahony
+    complementary filter: the gyroscope is trusted over short times,
+    the accelerometer over long times). the nudge is only made when
+    the accelerometer reads close to 1g - under thrust, or in free
+    fall, it isn't measuring gravity, so the gyroscope carries on
+    alone
+   The cost is the same for every update: about 50 multiplies and no
+    divides, square roots or trig functions, which would each cost
+    as much as tens of multiplies on the nano. the accelerometer is
+    normalised with a fast inverse square root (an integer trick and
+    one Newton step, within 0.2%), and the quaternion, which only
+    ever drifts a tiny way from unit length, with a first order
+    approximation of one. roll, pitch and yaw do need trig, so
+    they're only worked out when asked for
+   The accelerometer can't see rotation about the vertical, so yaw is
+    relative to the heading at startup, and drifts with the gyroscope
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE AN ESTIMATOR ---
+   PDC_attitude attitude;
+
+   --- START LEVEL WITH THE AVERAGE ACCELEROMETER READING AT REST [g] ---
+   attitude.init(accelX, accelY, accelZ);
+
+   --- UPDATE WITH EVERY SAMPLE: RATES IN dps, ACCELERATION IN g, TIME IN us ---
+   attitude.update(gyroX, gyroY, gyroZ, accelX, accelY, accelZ, micros());
+
+   --- READ THE ATTITUDE ---
+   float roll = attitude.getRoll();    // [deg]
+   float pitch = attitude.getPitch();  // [deg]
+   float yaw = attitude.getYaw();      // [deg]
+   float down[3];
+   attitude.getGravity(down);          // unit vector, body frame
+
+ *******************************************************************/
+
+#ifndef _PDC_ATTITUDE
+#define _PDC_ATTITUDE
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+const float ATTITUDE_KP = 1.0;            /* proportional gain, how hard the accelerometer pulls (rad/s per unit of error) */
+const float ATTITUDE_KI = 0.02;           /* integral gain, which soaks up any gyroscope bias left after calibration */
+const float ATTITUDE_GRAVITY_MIN = 0.81;  /* [g^2] only trust the accelerometer for 'down' when |a|^2 is within */
+const float ATTITUDE_GRAVITY_MAX = 1.21;  /* [g^2]  these (0.9g to 1.1g) */
+
+const float ATTITUDE_DEG_TO_RAD = 0.017453293;
+const float ATTITUDE_RAD_TO_DEG = 57.29577951;
+
+float invSqrt(float x); /* fast approximate 1/sqrt(x), to within 0.2% */
+
+/**************************************************************************
+    a class for estimating attitude from the IMU
+ **************************************************************************/
+class PDC_attitude {
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    float q0, q1, q2, q3;                           /* the attitude quaternion (w, x, y, z) */
+    float integralX, integralY, integralZ;          /* [rad/s] the integral of the error */
+    uint32_t lastTime;                              /* [us] the time of the last update */
+    bool running;                                   /* the first update just starts the clock */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_attitude():
+      q0(1), q1(0), q2(0), q3(0),
+      integralX(0), integralY(0), integralZ(0),
+      lastTime(0),
+      running(0)
+    {};
+
+    /* ---------- METHODS --------- */
+    void init(float ax, float ay, float az);        /* start from the attitude given by gravity alone (yaw 0) */
+    void update(float gx, float gy, float gz, float ax, float ay, float az, uint32_t time); /* a new sample [dps], [g], [us] */
+    void getQuaternion(float q[4]);                 /* the attitude quaternion (w, x, y, z) */
+    void getGravity(float g[3]);                    /* the direction of gravity in the body frame, as a unit vector */
+    float getRoll();                                /* [deg] rotation about x */
+    float getPitch();                               /* [deg] rotation about y */
+    float getYaw();                                 /* [deg] rotation about z, since startup */
+};
+
+#endif
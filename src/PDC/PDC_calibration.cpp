@@ -0,0 +1,174 @@
+/* for example usage, see PDC_calibration.h */
+
+#include "PDC_calibration.h"  /* include the definition of the class */
+#include "PDC_altitude.h"     /* for converting the pressure noise to altitude */
+
+/*********************************************************
+   @brief  Add a sample to the statistics
+   @param  the sample
+ *********************************************************/
+void PDC_welford::add(float value) {
+  /* stop counting rather than wrap around */
+  if (count == 0xFFFF) {
+    return;
+  }
+
+  count++;
+  float delta = value - mean;
+  mean += delta / count;
+  sumSquares += delta * (value - mean); /* uses the mean both before and after this sample */
+}
+
+/*********************************************************
+   @brief  Change the units of the statistics
+   @param  the factor every sample is multiplied by
+ *********************************************************/
+void PDC_welford::scale(float factor) {
+  mean *= factor;
+  sumSquares *= factor * factor;
+}
+
+/*********************************************************
+   @brief  Find the sample variance
+   @retval the variance (0 with fewer than two samples)
+ *********************************************************/
+float PDC_welford::variance() {
+  if (count < 2) {
+    return (0);
+  }
+
+  /* divide by n - 1, as the mean is estimated from the same samples */
+  return (sumSquares / (count - 1));
+}
+
+/*********************************************************
+   @brief  Find the sample standard deviation
+   @retval the standard deviation
+ *********************************************************/
+float PDC_welford::stdDev() {
+  return (sqrt(variance()));
+}
+
+/*********************************************************
+   @brief  Find how well the mean is known
+   @retval the standard error of the mean
+ *********************************************************/
+float PDC_welford::standardError() {
+  if (count < 2) {
+    return (INFINITY);
+  }
+
+  return (sqrt(variance() / count));
+}
+
+/*********************************************************
+   @brief  Find how well the standard deviation is known
+   @retval the standard error of the standard deviation,
+            relative to it (for gaussian samples)
+ *********************************************************/
+float PDC_welford::stdDevError() {
+  if (count < 2) {
+    return (INFINITY);
+  }
+
+  return (1.0 / sqrt(2.0 * (count - 1)));
+}
+
+/*********************************************************
+   @brief  Calibrate the IMU and altimeter together
+   @param  the IMU, already configured
+   @param  the altimeter, already configured
+   @param  the longest to keep trying for [ms]
+   @retval 0 in case of success, 1 otherwise (timed out
+            before every statistic was known well enough,
+            though all of them are still filled in)
+ *********************************************************/
+bool PDC_calibration::run(PDC_LSM6DSO32 &IMU, PDC_BMP388 &altimeter, uint16_t timeout) {
+  IMUFifoWord words[CALIBRATION_BURST_WORDS];
+  uint16_t numWords = 0;
+  altimeterSample sample;
+
+  for (uint8_t i = 0; i < 3; i++) {
+    accel[i] = PDC_welford();
+    gyro[i] = PDC_welford();
+  }
+  pressure = PDC_welford();
+
+  /* batch both IMU sensors at the rate they're configured to output at. no watermark, we just take what's there */
+  IMU.fifoInit(IMU.accel.getFrequencyCode(), IMU.gyro.getFrequencyCode(), 0);
+
+  uint32_t startTime = millis();
+
+  while (!(imuConfident() && altimeterConfident())) {
+    /* the IMU statistics are kept in raw counts, and converted once at the end, rather than converting every sample */
+    numWords = IMU.fifoRead(words, CALIBRATION_BURST_WORDS);
+    for (uint8_t i = 0; i < numWords; i++) {
+      PDC_welford *axes = (words[i].tag == FIFO_TAG_ACCEL) ? accel : (words[i].tag == FIFO_TAG_GYRO) ? gyro : NULL;
+      if (axes) {
+        axes[0].add(words[i].x);
+        axes[1].add(words[i].y);
+        axes[2].add(words[i].z);
+      }
+    }
+
+    /* the altimeter has no FIFO, so only count fresh samples, otherwise we'd see the same value many times */
+    sample = altimeter.readSample();
+    if (sample.status & STATUS_DRDY_PRESS) {
+      pressure.add(sample.pressure);
+    }
+
+    /* timeout control */
+    if ((millis() - startTime) > timeout) {
+      break;
+    }
+  }
+
+  duration = millis() - startTime;
+
+  IMU.fifoStop();
+
+  /* the conversion from raw counts is linear, so the statistics can be converted as a whole */
+  for (uint8_t i = 0; i < 3; i++) {
+    accel[i].scale(IMU.accel.convertRaw(1));
+    gyro[i].scale(IMU.gyro.convertRaw(1));
+  }
+
+  return (!(imuConfident() && altimeterConfident()));
+}
+
+/*********************************************************
+   @brief  Check if the IMU statistics are known well
+            enough
+   @retval 1 if the noise of every axis is known well
+            enough, 0 otherwise (the gyroscope biases are
+            known much better than that by then)
+ *********************************************************/
+bool PDC_calibration::imuConfident() {
+  for (uint8_t i = 0; i < 3; i++) {
+    if ((accel[i].stdDevError() > CALIBRATION_IMU_NOISE_PRECISION) || (gyro[i].stdDevError() > CALIBRATION_IMU_NOISE_PRECISION)) {
+      return (0);
+    }
+  }
+
+  return (1);
+}
+
+/*********************************************************
+   @brief  Check if the altimeter statistics are known well
+            enough
+   @retval 1 if the noise and the pad pressure are both
+            known well enough, 0 otherwise
+ *********************************************************/
+bool PDC_calibration::altimeterConfident() {
+  return ((pressure.stdDevError() <= CALIBRATION_ALTIMETER_NOISE_PRECISION) && (pressure.standardError() <= CALIBRATION_PRESSURE_PRECISION));
+}
+
+/*********************************************************
+   @brief  Find the altitude noise
+   @retval the altitude noise standard deviation [m] at
+            the mean pressure on the pad
+ *********************************************************/
+float PDC_calibration::altitudeNoise() {
+  /* the pressure noise is tiny compared to the pressure, so the altitude curve is a straight line across it */
+  return (pressureToAltitude(pressure.mean - pressure.stdDev()) - pressureToAltitude(pressure.mean));
+}
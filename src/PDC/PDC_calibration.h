@@ -0,0 +1,108 @@
+/*******************************************************************
+   In this file we define the on-the-pad sensor calibration
+   While the rocket sits still on the pad, the IMU and altimeter
+    are sampled together, each at its own configured output rate:
+    the IMU through its on-chip FIFO, so no sample is missed while
+    we're busy with the altimeter, and the altimeter whenever its
+    data-ready flag says there's a fresh sample.
+   Every axis keeps a running mean and variance (Welford's
+    algorithm - numerically stable, and no array of samples to
+    store), and calibration finishes as soon as every statistic is
+    known well enough, rather than after a fixed number of samples.
+    the altimeter is by far the slowest sensor, so in practice that
+    is ~2s at 25Hz, and the IMU is known far better than it needs
+    to be by then
+   What comes out:
+    - the noise standard deviation of every accelerometer and
+      gyroscope axis, and of the altitude
+    - the gyroscope bias (the mean rate at rest)
+    - the mean pressure on the pad, for the ground reference
+    - the number of samples each of these is actually based on
+ ************************** Example usage **************************
+
+   --- CALIBRATE THE IMU AND ALTIMETER, GIVING UP AFTER 2s ---
+   PDC_calibration calibration;
+   if (calibration.run(IMU, altimeter, 2000) != 0) {
+     // didn't reach the target in time, but the statistics are still usable
+   }
+
+   --- READ THE RESULTS ---
+   float accelNoiseZ = calibration.accel[2].stdDev();  // [g]
+   float gyroBiasX = calibration.gyro[0].mean;         // [dps]
+   uint16_t samples = calibration.pressure.count;
+   float altitudeNoise = calibration.altitudeNoise();  // [m]
+
+ *******************************************************************/
+
+#ifndef _PDC_CALIBRATION
+#define _PDC_CALIBRATION
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+#include "PDC_LSM6DSO32.h"  /* the sensors it calibrates */
+#include "PDC_BMP388.h"
+
+/*
+    every statistic has a target for its standard error, and calibration goes on until all of them are met:
+    + the noise figures become the Kalman filter's measurement variances (see PDC_kalman.ino). a standard deviation
+       from n samples of gaussian noise has a relative standard error of 1/sqrt(2(n-1)), so the targets below need 201
+       IMU samples (60ms at 3330Hz) and 51 altimeter samples (2s at 25Hz). the gains do follow the noise: 10% out on
+       the altitude noise moves the altimeter's position gain by ~17%, and 5% out on the accelerometer's by 9-16%. but
+       the filter's error is at its minimum when the variances are right, so it's flat there - simulated, either
+       mistake changes the rms velocity and height errors by under 2%. the altitude noise is the one that costs pad
+       time, so its target is the looser one
+    + the ground pressure must be known to within 1Pa (~8cm of height at the launch site)
+*/
+const float CALIBRATION_IMU_NOISE_PRECISION = 0.05;       /* relative standard error of each IMU axis' noise */
+const float CALIBRATION_ALTIMETER_NOISE_PRECISION = 0.1;  /* relative standard error of the altimeter noise */
+const float CALIBRATION_PRESSURE_PRECISION = 1.0;         /* [Pa] standard error of the mean pad pressure */
+const uint8_t CALIBRATION_BURST_WORDS = 8;          /* FIFO words to read at a time (7 bytes each, on the stack, where setup's calibration is the deepest the stack goes - see PDC.ino) */
+
+/**************************************************************************
+    the running statistics of one quantity (Welford's algorithm)
+ **************************************************************************/
+class PDC_welford {
+  public:
+    uint16_t count;     /* the number of samples so far */
+    float mean;         /* the mean of the samples so far */
+    float sumSquares;   /* the sum of squared differences from the mean */
+
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_welford():
+      count(0),
+      mean(0),
+      sumSquares(0)
+    {};
+
+    /* ---------- METHODS ---------- */
+    void add(float value);        /* add a sample */
+    void scale(float factor);     /* change the units of the statistics, as if every sample had been multiplied by factor */
+    float variance();             /* the sample variance */
+    float stdDev();               /* the sample standard deviation */
+    float standardError();        /* the standard error of the mean */
+    float stdDevError();          /* the standard error of the standard deviation, as a fraction of it */
+};
+
+/**************************************************************************
+    the calibration of the IMU and altimeter together
+ **************************************************************************/
+class PDC_calibration {
+  public:
+    PDC_welford accel[3];   /* [g] each accelerometer axis */
+    PDC_welford gyro[3];    /* [dps] each gyroscope axis. the means are the biases */
+    PDC_welford pressure;   /* [Pa] the altimeter */
+    uint32_t duration;      /* [ms] how long the calibration took */
+
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_calibration():
+      duration(0)
+    {};
+
+    /* ---------- METHODS ---------- */
+    bool run(PDC_LSM6DSO32 &IMU, PDC_BMP388 &altimeter, uint16_t timeout); /* sample both sensors until confident, or out of time */
+    bool imuConfident();      /* check if the IMU statistics are known well enough */
+    bool altimeterConfident(); /* check if the altimeter statistics are known well enough */
+    float altitudeNoise();    /* the altitude noise standard deviation [m] at the pad pressure */
+};
+
+#endif
@@ -1,5 +1,10 @@
 #include "PDC_logFile.h"  /* include our log file line structure so we can access the global one defined in main */
 
-void initKalman();
-void kalmanPredict();
-void kalmanUpdate();
+void initKalman(float accelNoise, float altitudeNoise);
+void kalmanUpdateAccel(float acceleration, uint32_t time);
+void kalmanUpdateBaro(float height, uint32_t time);
+void kalmanSteadyState(float accelNoise, float altitudeNoise);
+void kalmanPredict(uint32_t time);
+void kalmanLog();
+void kalmanPropagate(float dt);
+void kalmanCorrect(uint8_t measuredState, float measurement, float variance);
@@ -1,113 +1,250 @@
-Matrix<numStates, numStates> F_matrix = {1.0,                      0.0, 0.0,
-                                         kalmanTime,               1.0, 0.0,
-                                         0.5 * pow(kalmanTime, 2), 0.0, 1.0
-                                        };    /* state transition matrix which maps previous state to current state  */
-Matrix<numMeasurements, numStates> H_matrix;  /* measurement matrix which maps the measurements to the state variables */
-Matrix<numStates, numMeasurements> K_matrix;  /* kalman gain matrix which weights our measurements against the underlying model */
+/*
+    the filter propagates with the time that has actually passed between steps, rather than assuming that every step
+     is exactly kalmanTime long. that means F, Q and the covariance P have to be worked out again at every step, so
+     they are written out by hand for our particular model, using only the non-zero terms (if the states or
+     measurements change, these need to be changed to match!)
+    with dt the time since the last step, the model is constant acceleration:
+     F = | 1       0   0 |    acceleration carries over
+         | dt      1   0 |    velocity integrates acceleration
+         | dt^2/2  dt  1 |    position integrates velocity and acceleration
+    and the process noise Q is what a white noise jerk of spectral density KALMAN_JERK_NOISE does over dt
+*/
+constexpr float KALMAN_JERK_NOISE = 25.0; /* gives Q(0,0) = 1 at the nominal kalmanTime step */
+
+/* the starting covariance comes from a table worked out for this model and these task rates. if any of them
+   change, the table must be generated again (see tools/PDC_kalmanTable.cpp) */
+static_assert(KALMAN_JERK_NOISE == KALMAN_TABLE_JERK_NOISE, "Kalman table is for a different process noise, regenerate it");
+static_assert(IMU_TASK_PERIOD == KALMAN_TABLE_IMU_PERIOD, "Kalman table is for a different IMU rate, regenerate it");
+static_assert(ALTIMETER_TASK_PERIOD == KALMAN_TABLE_ALTIMETER_PERIOD, "Kalman table is for a different altimeter rate, regenerate it");
+static_assert((KALMAN_TABLE_ACCEL_NOISE_RATIO == 2) && (KALMAN_TABLE_ALTITUDE_NOISE_RATIO == 2), "kalmanSteadyState() needs a table in octaves of the noise");
+
+const float GRAVITY = 9.80665;         /* [m/s^2] standard gravity, to get the accelerometer from g to m/s^2 */
+
+Matrix<numStates, numStates> P_matrix;  /* error covariance matrix. kept symmetric */
+float accelerationVariance;             /* [(m/s^2)^2] accelerometer measurement noise, measured in setup */
+float altitudeVariance;                 /* [m^2] altimeter measurement noise, measured in setup */
+
+uint32_t kalmanLastTime;  /* [us] the time that the state was last propagated to */
+bool kalmanRunning = 0;   /* the first measurement just starts the clock */
+
+/*
+    the accelerometer and altimeter each correct the state on their own, as soon as they have a new sample, so each
+     contributes at its own rate (the IMU at hundreds of Hz, the altimeter at 25Hz). the filter is stepped forward to
+     the time of the sample, and then corrected with that one measurement. with one measurement at a time, the
+     innovation covariance is a single number, so there's no matrix inverse - just a divide
+*/
 
 /**************************************************************************
-   @brief  Initialise the kalman filter based on steady-state assumption
+   @brief  Initialise the kalman filter
+   @param  accelerometer (z-axis) noise standard deviation [g]
+   @param  altimeter noise standard deviation [m]
  **************************************************************************/
-void initKalman() {
-  /* ---------- Define Matrices ---------- */
-  /* fill all matrices with 0 to start */
+void initKalman(float accelNoise, float altitudeNoise) {
   stateMatrix.Fill(0.0);
-  previousStateMatrix.Fill(0.0);
-  predictedStateMatrix.Fill(0.0);
-  measurementMatrix.Fill(0.0);
-
-  H_matrix.Fill(0.0); /* fill with zeroes */
-  K_matrix.Fill(0.0); /* fill with zeroes */
-  H_matrix(0, 0) = 1.0; /* 0,0 in measurement says that we have an accelerometer measurement */
-  H_matrix(1, 2) = 1.0; /* 1,2 in measurement says that we have a displacement measurement */
-
-  /* create an identity matrix the size of the number of states */
-  Matrix<numStates, numStates> stateIdentity;
-  stateIdentity.Fill(0.0);
-  for (int i = 0; i < numStates; i++) {
-    stateIdentity(i, i) = 1.0;
+  kalmanRunning = 0;
+
+  /* ---------- measurement noise --------- */
+  /* both are measured on the pad in setup (see PDC_calibration.h) */
+  accelerationVariance = sq(accelNoise * GRAVITY);  /* in m/s^2, square for variance */
+  altitudeVariance = sq(altitudeNoise);
+
+  /* ---------- initialise error covariance matrix, P ---------- */
+  /* with the noise known, P would settle to the same steady-state whatever it started from - but that takes minutes
+     of filtering. that steady-state was worked out offline, so just look it up */
+  kalmanSteadyState(accelNoise, altitudeNoise);
+}
+
+/**************************************************************************
+   @brief  Find where a noise level falls in one axis of the table
+   @param  the noise standard deviation
+   @param  the noise at the first row or column
+   @param  the number of rows or columns
+   @retval the row or column, with the fraction of the way to the next,
+            kept to the edges of the table
+ **************************************************************************/
+static float kalmanTableIndex(float noise, float noiseMin, uint8_t steps) {
+  /* the table is in octaves of the noise, so the octave is the exponent of noise/noiseMin = mantissa * 2^exponent (with
+     the mantissa in [0.5, 1)), and within it the noise is interpolated linearly. no log() - and as the small entries of
+     P go as powers of the noise, that's closer to the true P between the rows than interpolating in the log was */
+  int exponent;
+  float mantissa = frexp(noise / noiseMin, &exponent);
+  float index = (exponent - 1) + (2 * mantissa - 1);
+  return (constrain(index, 0.0, float(steps - 1)));
+}
+
+/**************************************************************************
+   @brief  Set the error covariance to its steady-state value, by
+            interpolating the table of it in PDC_kalmanTable.h (a table
+            of P rather than of the gains K, as the gains are worked out
+            from P at every step anyway)
+   @param  accelerometer noise standard deviation [g]
+   @param  altimeter noise standard deviation [m]
+ **************************************************************************/
+void kalmanSteadyState(float accelNoise, float altitudeNoise) {
+  float row = kalmanTableIndex(accelNoise, KALMAN_TABLE_ACCEL_NOISE_MIN, KALMAN_TABLE_ACCEL_NOISE_STEPS);
+  float column = kalmanTableIndex(altitudeNoise, KALMAN_TABLE_ALTITUDE_NOISE_MIN, KALMAN_TABLE_ALTITUDE_NOISE_STEPS);
+
+  /* the cell we're in. the last row and column are the far edge of the cell before them */
+  uint8_t i = min(uint8_t(row), uint8_t(KALMAN_TABLE_ACCEL_NOISE_STEPS - 2));
+  uint8_t j = min(uint8_t(column), uint8_t(KALMAN_TABLE_ALTITUDE_NOISE_STEPS - 2));
+  float rowFraction = row - i;
+  float columnFraction = column - j;
+
+  /* bilinear interpolation of each of the unique entries, straight out of flash */
+  float entry[KALMAN_TABLE_ENTRY_SIZE];
+  for (uint8_t n = 0; n < KALMAN_TABLE_ENTRY_SIZE; n++) {
+    float lower = pgm_read_float(&KALMAN_TABLE[i][j][n]) + columnFraction * (pgm_read_float(&KALMAN_TABLE[i][j + 1][n]) - pgm_read_float(&KALMAN_TABLE[i][j][n]));
+    float upper = pgm_read_float(&KALMAN_TABLE[i + 1][j][n]) + columnFraction * (pgm_read_float(&KALMAN_TABLE[i + 1][j + 1][n]) - pgm_read_float(&KALMAN_TABLE[i + 1][j][n]));
+    entry[n] = lower + rowFraction * (upper - lower);
   }
 
-  /* and another that is size of the number of measurements */
-  Matrix<numMeasurements, numMeasurements> measurementIdentity;
-  measurementIdentity.Fill(0.0);
-  for (uint8_t i = 0; i < numMeasurements; i++) {
-    measurementIdentity(i, i) = 1.0;
+  /* the entries are the upper triangle, row by row */
+  P_matrix(0, 0) = entry[0];
+  P_matrix(0, 1) = P_matrix(1, 0) = entry[1];
+  P_matrix(0, 2) = P_matrix(2, 0) = entry[2];
+  P_matrix(1, 1) = entry[3];
+  P_matrix(1, 2) = P_matrix(2, 1) = entry[4];
+  P_matrix(2, 2) = entry[5];
+}
+
+/**************************************************************************
+   @brief  Correct the state with an accelerometer measurement
+   @param  the measured upwards acceleration [g], as the accelerometer
+            reads it (so +1g at rest)
+   @param  the time the measurement was taken [us]
+ **************************************************************************/
+void kalmanUpdateAccel(float acceleration, uint32_t time) {
+  PROFILE_SECTION(PROFILE_KALMAN);
+
+  kalmanPredict(time);
+
+  /* the state is the acceleration of the rocket, so take off the 1g the accelerometer feels from gravity */
+  kalmanCorrect(0, (acceleration - 1.0) * GRAVITY, accelerationVariance);
+
+  kalmanLog();
+}
+
+/**************************************************************************
+   @brief  Correct the state with an altimeter measurement
+   @param  the measured height above the launch site [m]
+   @param  the time the measurement was taken [us]
+ **************************************************************************/
+void kalmanUpdateBaro(float height, uint32_t time) {
+  PROFILE_SECTION(PROFILE_KALMAN);
+
+  kalmanPredict(time);
+  kalmanCorrect(2, height, altitudeVariance);
+  kalmanLog();
+}
+
+/**************************************************************************
+   @brief  Kalman predict the state of the system at a given time
+   @param  the time to predict to [us]
+ **************************************************************************/
+void kalmanPredict(uint32_t time) {
+  /* the first call just marks the time that the filter starts from */
+  if (!kalmanRunning) {
+    kalmanLastTime = time;
+    kalmanRunning = 1;
+    return;
   }
 
-  /* the P,Q,R matrices are needed for setup, but not for operation, so are defined locally */
-
-  Matrix<numStates, numStates> P_matrix = stateIdentity;                    /* error covariance matrix (initial guess = identity) */
-  Matrix<numStates, numStates> Q_matrix = stateIdentity;                    /* process noise covariance matrix */
-  Matrix<numMeasurements, numMeasurements> R_matrix = measurementIdentity;  /* measurement noise covariance matrix */
-
-  /* ---------- initialise measurement noise covariance matrix, R --------- */
-  // TODO: either measure noise and create R matrix from this, or ask sensors which mode they are in and use
-  // an enum to get the noise stats as per datasheet. current values are temporary!
-  // this is useful for altimeter too, as we know altitude is fixed and can find variance of altitude as a single number
-  // rather than taking it separately for pressure and temperature!
-  // the looping would be slower but would save memory that would be used for storing an enum which we'd probably only use once
-  // and the loop would still allow us to change R based on the setups of the sensors
-
-  R_matrix(0, 0) = pow(IMU.accel.measureNoiseZ(), 2);       /* measure accelerometer noise standard deviation in z-axis, square for variance */
-  R_matrix(1,1) = pow(altimeter.measureAltitudeNoise(), 2); /* measure altitude noise standard deviation, square for variance */
-
-  /* ---------- initialise process noise covariance matrix ---------- */
-  // TODO: really think about how this is going to be determined. Is a 'throw in the air' test going to allow us to get some understanding?
-    // what about re-creating this kalman filter in simulation land, applying the measurement noise to some flight profile?
-  Q_matrix(0,0) = 1;
-  Q_matrix(1,1) = 1;
-  Q_matrix(2,2) = 1;
-
-  /* ---------- initialise Kalman Gain matrix, K ---------- */
-  Matrix<numMeasurements, numMeasurements> sum_HPHT_R;  /* declare matrix for an interim storage */
-
-  /* iterative calculations for K and P */
-  // TODO: determine how many iterations needed for convergence
-  for (uint8_t i = 0; i < 5; i++) {
-    /* ---------- K = PH^T[HPH^T + R]^-1 ---------- */
-    sum_HPHT_R = (H_matrix * P_matrix * ~H_matrix) + R_matrix;  /* store the term to be inverted */
-    K_matrix = (P_matrix * ~H_matrix) * sum_HPHT_R.Inverse();   /* multiply P*H^T by (H*P*H^T + R)^1 and store in K */
-
-    /* ---------- P = (I - KH)P ---------- */
-    P_matrix = (stateIdentity - (K_matrix * H_matrix)) * P_matrix;
-
-    /* ---------- P = FPF^T + Q ---------- */
-    P_matrix = (F_matrix * P_matrix * ~F_matrix) + Q_matrix;
-
-    //Serial.println("  Matrices: ");
-    //Serial << " P: " << P_matrix << '\n';
-    //Serial << " K: " << K_matrix << '\n';
-    //Serial << " R: " << R_matrix << '\n';
-    //Serial << " Q: " << Q_matrix << '\n';
+  /* unsigned difference, so the micros() rollover doesn't matter. never step backwards */
+  uint32_t elapsed = time - kalmanLastTime;
+  if (int32_t(elapsed) <= 0) {
+    return;
   }
+  kalmanLastTime = time;
 
-  // TODO: manual calculation of K and P for arbitrary setup to verify the above has worked
+  kalmanPropagate(elapsed * 1e-6);
 }
 
 /**************************************************************************
-   @brief  Kalman predict the current state of the system
+   @brief  Write the current estimates to the log file line
  **************************************************************************/
-void kalmanPredict() {
-  /* x_k+1 = F*x_k */
-  predictedStateMatrix = F_matrix * previousStateMatrix;
+void kalmanLog() {
+  logFileLine.estimateAccelerationZ = logInt16(stateMatrix(0,0) * LOG_EST_ACCEL_SCALE);
+  logFileLine.estimateVelocityZ = logInt16(stateMatrix(1,0) * LOG_EST_VELOCITY_SCALE);
+  logInt24(logFileLine.estimatePositionZ, stateMatrix(2,0) * LOG_EST_POSITION_SCALE, true);
 }
 
 /**************************************************************************
-   @brief  Kalman update the current state of the system
+   @brief  Propagate the state and covariance forward in time
+   @param  the time step [s]
  **************************************************************************/
-void kalmanUpdate() {
-  /* take measurements of the Z acceleration (IMU) and the altitude (altimeter) and modify the measurement matrix */
-  measurementMatrix(0,0) = IMU.accel.readZ();
-  measurementMatrix(1,0) = altimeter.readAltitude();
-
-  /* x_k = x_k-1 + K*[z_k - H*x_k-1] */
-  stateMatrix = predictedStateMatrix + K_matrix * (measurementMatrix - H_matrix * predictedStateMatrix);
-
-  /* write the estimates to the log file line structure */
-  logFileLine.estimateAccelerationZ = stateMatrix(0,0);
-  logFileLine.estimateVelocityZ = stateMatrix(1,0);
-  logFileLine.estimatePositionZ = stateMatrix(2,0);
-  
-  previousStateMatrix = stateMatrix;
+void kalmanPropagate(float dt) {
+  float halfDt2 = 0.5 * dt * dt;
+
+  /* ---------- x = F*x ---------- */
+  /* the terms go in the order the matrix product adds them (along the row of F), so the result is the same to the bit */
+  float accelerationEstimate = stateMatrix(0, 0);
+  float velocityEstimate = stateMatrix(1, 0);
+  stateMatrix(1, 0) = dt * accelerationEstimate + velocityEstimate;
+  stateMatrix(2, 0) = halfDt2 * accelerationEstimate + dt * velocityEstimate + stateMatrix(2, 0);
+
+  /* ---------- P = F*P*F^T + Q ---------- */
+  /* rows 1 and 2 of F*P (row 0 is just row 0 of P) */
+  float FP10 = dt * P_matrix(0, 0) + P_matrix(1, 0);
+  float FP11 = dt * P_matrix(0, 1) + P_matrix(1, 1);
+  float FP20 = halfDt2 * P_matrix(0, 0) + dt * P_matrix(1, 0) + P_matrix(2, 0);
+  float FP21 = halfDt2 * P_matrix(0, 1) + dt * P_matrix(1, 1) + P_matrix(2, 1);
+  float FP22 = halfDt2 * P_matrix(0, 2) + dt * P_matrix(1, 2) + P_matrix(2, 2);
+
+  /* then (F*P)*F^T, only the upper triangle as it's symmetric. P(0,0) doesn't change */
+  float P01 = FP10;
+  float P02 = FP20;
+  float P11 = dt * FP10 + FP11;
+  float P12 = dt * FP20 + FP21;
+  float P22 = halfDt2 * FP20 + dt * FP21 + FP22;
+
+  /* Q for a white noise jerk: q * | dt       dt^2/2   dt^3/6  |
+                                   | dt^2/2   dt^3/3   dt^4/8  |
+                                   | dt^3/6   dt^4/8   dt^5/20 | */
+  float qDt = KALMAN_JERK_NOISE * dt;
+  float qDt2 = qDt * dt;
+  float qDt3 = qDt2 * dt;
+  float qDt4 = qDt3 * dt;
+
+  P_matrix(0, 0) += qDt;
+  P_matrix(0, 1) = P_matrix(1, 0) = P01 + qDt2 / 2;
+  P_matrix(0, 2) = P_matrix(2, 0) = P02 + qDt3 / 6;
+  P_matrix(1, 1) = P11 + qDt3 / 3;
+  P_matrix(1, 2) = P_matrix(2, 1) = P12 + qDt4 / 8;
+  P_matrix(2, 2) = P22 + (qDt4 * dt) / 20;
+}
+
+/**************************************************************************
+   @brief  Correct the state and covariance with a single measurement of
+            one of the states
+   @param  the state that was measured (0: acceleration, 2: position)
+   @param  the measurement
+   @param  the variance of the measurement
+ **************************************************************************/
+void kalmanCorrect(uint8_t measuredState, float measurement, float variance) {
+  /* H picks out one state, so P*H^T is column k of P, and H*P*H^T is just P(k,k) */
+  const uint8_t k = measuredState;
+
+  /* ---------- K = P*H^T / (H*P*H^T + R) ---------- */
+  float inverseS = 1.0 / (P_matrix(k, k) + variance);
+  float PHt[numStates];  /* column k of P, taken before P changes */
+  float K[numStates];
+  for (uint8_t i = 0; i < numStates; i++) {
+    PHt[i] = P_matrix(i, k);
+    K[i] = PHt[i] * inverseS;
+  }
+
+  /* ---------- x = x + K*(z - H*x) ---------- */
+  float innovation = measurement - stateMatrix(k, 0);
+  for (uint8_t i = 0; i < numStates; i++) {
+    stateMatrix(i, 0) += K[i] * innovation;
+  }
+
+  /* ---------- P = P - K*(H*P) ---------- */
+  /* H*P is row k of P, which is column k as P is symmetric. work out the upper triangle and mirror it, so P stays exactly symmetric */
+  for (uint8_t i = 0; i < numStates; i++) {
+    for (uint8_t j = i; j < numStates; j++) {
+      P_matrix(i, j) -= K[i] * PHt[j];
+      P_matrix(j, i) = P_matrix(i, j);
+    }
+  }
 }
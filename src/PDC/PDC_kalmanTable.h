@@ -0,0 +1,99 @@
+/*******************************************************************
+   GENERATED BY tools/PDC_kalmanTable.cpp - DO NOT EDIT BY HAND
+   The steady-state Kalman filter covariance, just after an
+    altimeter correction, for a grid of sensor noise levels.
+    see PDC_kalman.ino for how it is used
+   Rows are accelerometer noise 0.001*2^i [g], columns altimeter
+    noise 0.05*2^j [m]. each entry is the upper triangle of P:
+    P00, P01, P02, P11, P12, P22 in m/s^2, m/s and m units
+   It holds P rather than the gains K: the filter propagates with
+    the time that has really passed, so it works K out from P at
+    every step, and P is all it needs to start converged
+ *******************************************************************/
+
+#ifndef _PDC_KALMAN_TABLE
+#define _PDC_KALMAN_TABLE
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files (and PROGMEM) */
+
+/* ---------- WHAT THE TABLE WAS GENERATED FOR ---------- */
+constexpr float KALMAN_TABLE_JERK_NOISE = 25.000000;
+constexpr uint32_t KALMAN_TABLE_IMU_PERIOD = 4000;        /* [us] */
+constexpr uint32_t KALMAN_TABLE_ALTIMETER_PERIOD = 40000;  /* [us] */
+
+/* ---------- GRID ---------- */
+const float KALMAN_TABLE_ACCEL_NOISE_MIN = 0.001000;      /* [g] */
+constexpr float KALMAN_TABLE_ACCEL_NOISE_RATIO = 2.000000;   /* between rows */
+const uint8_t KALMAN_TABLE_ACCEL_NOISE_STEPS = 7;
+const float KALMAN_TABLE_ALTITUDE_NOISE_MIN = 0.050000;      /* [m] */
+constexpr float KALMAN_TABLE_ALTITUDE_NOISE_RATIO = 2.000000;   /* between columns */
+const uint8_t KALMAN_TABLE_ALTITUDE_NOISE_STEPS = 7;
+const uint8_t KALMAN_TABLE_ENTRY_SIZE = 6;
+
+const float KALMAN_TABLE[KALMAN_TABLE_ACCEL_NOISE_STEPS][KALMAN_TABLE_ALTITUDE_NOISE_STEPS][KALMAN_TABLE_ENTRY_SIZE] PROGMEM = {
+  { /* accelerometer noise 0.001g */
+    {9.6078074e-05, 1.9251953e-07, 2.4681464e-10, 6.1906623e-05, 5.6829075e-05, 1.0547600e-04}, /* 0.05m */
+    {9.6078074e-05, 1.9252244e-07, 2.4995056e-10, 8.7825255e-05, 1.1437792e-04, 3.0020883e-04}, /* 0.1m */
+    {9.6078074e-05, 1.9252391e-07, 2.5219210e-10, 1.2448074e-04, 2.2977924e-04, 8.5290109e-04}, /* 0.2m */
+    {9.6078074e-05, 1.9252465e-07, 2.5378907e-10, 1.7632013e-04, 4.6101131e-04, 2.4199716e-03}, /* 0.4m */
+    {9.6078074e-05, 1.9252502e-07, 2.5492436e-10, 2.4963260e-04, 9.2408279e-04, 6.8599740e-03}, /* 0.8m */
+    {9.6078074e-05, 1.9252520e-07, 2.5573007e-10, 3.5331244e-04, 1.8510846e-03, 1.9433535e-02}, /* 1.6m */
+    {9.6078074e-05, 1.9252530e-07, 2.5630112e-10, 4.9993813e-04, 3.7063030e-03, 5.5027646e-02}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.002g */
+    {3.8321301e-04, 7.7227595e-07, 1.0010136e-09, 6.3482138e-05, 5.7782894e-05, 1.0634793e-04}, /* 0.05m */
+    {3.8321301e-04, 7.7228796e-07, 1.0138402e-09, 9.0063265e-05, 1.1630384e-04, 3.0270648e-04}, /* 0.1m */
+    {3.8321301e-04, 7.7229401e-07, 1.0230089e-09, 1.2765570e-04, 2.3365713e-04, 8.6002915e-04}, /* 0.2m */
+    {3.8321301e-04, 7.7229705e-07, 1.0295421e-09, 1.8082017e-04, 4.6880412e-04, 2.4402610e-03}, /* 0.4m */
+    {3.8321301e-04, 7.7229858e-07, 1.0341871e-09, 2.5600660e-04, 9.3972095e-04, 6.9176189e-03}, /* 0.8m */
+    {3.8321301e-04, 7.7229935e-07, 1.0374835e-09, 3.6233665e-04, 1.8824355e-03, 1.9597097e-02}, /* 1.6m */
+    {3.8321301e-04, 7.7229973e-07, 1.0398200e-09, 5.1271030e-04, 3.7691102e-03, 5.5491308e-02}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.004g */
+    {1.5157511e-03, 3.1232938e-06, 4.2215603e-09, 6.9657414e-05, 6.1446386e-05, 1.0963034e-04}, /* 0.05m */
+    {1.5157511e-03, 3.1233477e-06, 4.2773725e-09, 9.8836014e-05, 1.2370248e-04, 3.1211141e-04}, /* 0.1m */
+    {1.5157511e-03, 3.1233749e-06, 4.3172826e-09, 1.4010201e-04, 2.4855650e-04, 8.8687469e-04}, /* 0.2m */
+    {1.5157511e-03, 3.1233886e-06, 4.3457275e-09, 1.9846180e-04, 4.9874797e-04, 2.5166843e-03}, /* 0.4m */
+    {1.5157511e-03, 3.1233954e-06, 4.3659540e-09, 2.8099561e-04, 9.9981463e-04, 7.1347673e-03}, /* 0.8m */
+    {1.5157511e-03, 3.1233989e-06, 4.3803145e-09, 3.9771648e-04, 2.0029149e-03, 2.0213275e-02}, /* 1.6m */
+    {1.5157511e-03, 3.1234006e-06, 4.3904979e-09, 5.6278503e-04, 4.0104829e-03, 5.7238110e-02}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.008g */
+    {5.8165787e-03, 1.2985830e-05, 2.0216125e-08, 9.2758218e-05, 7.4271113e-05, 1.2039548e-04}, /* 0.05m */
+    {5.8165787e-03, 1.2986143e-05, 2.0510496e-08, 1.3166407e-04, 1.4961983e-04, 3.4298280e-04}, /* 0.1m */
+    {5.8165787e-03, 1.2986301e-05, 2.0721230e-08, 1.8668722e-04, 3.0077304e-04, 9.7504811e-04}, /* 0.2m */
+    {5.8165787e-03, 1.2986381e-05, 2.0871549e-08, 2.6450310e-04, 6.0372407e-04, 2.7678026e-03}, /* 0.4m */
+    {5.8165787e-03, 1.2986421e-05, 2.0978499e-08, 3.7455235e-04, 1.2105378e-03, 7.8485098e-03}, /* 0.8m */
+    {5.8165787e-03, 1.2986441e-05, 2.1054457e-08, 5.3018620e-04, 2.4254545e-03, 2.2239018e-02}, /* 1.6m */
+    {5.8165787e-03, 1.2986451e-05, 2.1108338e-08, 7.5028618e-04, 4.8571112e-03, 6.2981766e-02}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.016g */
+    {2.0441194e-02, 5.7590069e-05, 1.2708911e-07, 1.7124752e-04, 1.1138182e-04, 1.4703054e-04}, /* 0.05m */
+    {2.0441194e-02, 5.7593050e-05, 1.2936547e-07, 2.4330157e-04, 2.2475005e-04, 4.1954122e-04}, /* 0.1m */
+    {2.0441194e-02, 5.7594558e-05, 1.3099966e-07, 3.4520687e-04, 4.5233059e-04, 1.1940681e-03}, /* 0.2m */
+    {2.0441194e-02, 5.7595318e-05, 1.3216766e-07, 4.8932659e-04, 9.0868549e-04, 3.3922930e-03}, /* 0.4m */
+    {2.0441194e-02, 5.7595700e-05, 1.3299984e-07, 6.9314538e-04, 1.8230837e-03, 9.6249215e-03}, /* 0.8m */
+    {2.0441194e-02, 5.7595892e-05, 1.3359144e-07, 9.8139061e-04, 3.6542680e-03, 2.7283739e-02}, /* 1.6m */
+    {2.0441194e-02, 5.7595989e-05, 1.3401135e-07, 1.3890323e-03, 7.3200135e-03, 7.7291073e-02}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.032g */
+    {6.1120868e-02, 2.7158276e-04, 1.0380841e-06, 4.1129037e-04, 1.9846087e-04, 1.9527224e-04}, /* 0.05m */
+    {6.1120868e-02, 2.7162692e-04, 1.0631099e-06, 5.8533730e-04, 4.0167947e-04, 5.5885618e-04}, /* 0.1m */
+    {6.1120868e-02, 2.7164935e-04, 1.0811693e-06, 8.3150021e-04, 8.1015536e-04, 1.5939460e-03}, /* 0.2m */
+    {6.1120868e-02, 2.7166069e-04, 1.0941242e-06, 1.1796436e-03, 1.6299908e-03, 4.5351370e-03}, /* 0.4m */
+    {6.1120868e-02, 2.7166640e-04, 1.1033782e-06, 1.6720045e-03, 3.2737404e-03, 1.2881218e-02}, /* 0.8m */
+    {6.1120868e-02, 2.7166927e-04, 1.1099690e-06, 2.3683161e-03, 6.5670077e-03, 3.6541929e-02}, /* 1.6m */
+    {6.1120868e-02, 2.7167071e-04, 1.1146532e-06, 3.3530552e-03, 1.3161700e-02, 1.0357359e-01}  /* 3.2m */
+  },
+  { /* accelerometer noise 0.064g */
+    {1.5467382e-01, 1.2647580e-03, 9.0656043e-06, 1.1019628e-03, 3.7901415e-04, 2.6776766e-04}, /* 0.05m */
+    {1.5467385e-01, 1.2655198e-03, 9.3735706e-06, 1.5724056e-03, 7.7072664e-04, 7.6984826e-04}, /* 0.1m */
+    {1.5467386e-01, 1.2659091e-03, 9.5976463e-06, 2.2378256e-03, 1.5596618e-03, 2.2028945e-03}, /* 0.2m */
+    {1.5467386e-01, 1.2661068e-03, 9.7593235e-06, 3.1789512e-03, 3.1453271e-03, 6.2822588e-03}, /* 0.4m */
+    {1.5467386e-01, 1.2662067e-03, 9.8752899e-06, 4.5099600e-03, 6.3276831e-03, 1.7872923e-02}, /* 0.8m */
+    {1.5467386e-01, 1.2662571e-03, 9.9581221e-06, 6.3923302e-03, 1.2707988e-02, 5.0761634e-02}, /* 1.6m */
+    {1.5467386e-01, 1.2662824e-03, 1.0017113e-05, 9.0544314e-03, 2.5490651e-02, 1.4399625e-01}  /* 3.2m */
+  }
+};
+
+#endif
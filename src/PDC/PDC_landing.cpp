@@ -0,0 +1,91 @@
+/* for example usage, see PDC_landing.h */
+
+#include "PDC_landing.h"  /* include the definition of the class */
+
+/*********************************************************
+   @brief  Forget everything, ready to fly again
+ *********************************************************/
+void PDC_landing::reset() {
+  descending = 0;
+  descentTime = 0;
+  still = 0;
+  stillPressure = 0;
+  stillTime = 0;
+
+  detected = 0;
+  backstop = 0;
+  detectionTime = 0;
+}
+
+/*********************************************************
+   @brief  Start the clock for the backstop
+   @param  the time the descent started [us]
+ *********************************************************/
+void PDC_landing::descend(uint32_t time) {
+  descending = 1;
+  descentTime = time;
+}
+
+/*********************************************************
+   @brief  Give the detector a new sample
+   @param  the vertical velocity [m/s]
+   @param  the pressure [Pa]
+   @param  the time of the sample [us]
+   @retval 1 once landing has been declared, 0 until then
+ *********************************************************/
+bool PDC_landing::update(float velocity, float pressure, uint32_t time) {
+  if (detected) {
+    return (1);
+  }
+
+  /* the backstop, if the descent has been going for too long */
+  if (descending && ((time - descentTime) >= config.backstopTime)) {
+    detected = 1;
+    backstop = 1;
+    detectionTime = time;
+    return (1);
+  }
+
+  /* a sample that isn't still starts the count again, and one that is still is measured against the pressure of the
+     first one, so a slow drift can't creep through the band a sample at a time */
+  bool isStill = (fabs(velocity) <= config.maxSpeed) && still && (fabs(pressure - stillPressure) <= config.pressureBand);
+  if (!isStill) {
+    still = (fabs(velocity) <= config.maxSpeed);
+    stillPressure = pressure;
+    stillTime = time;
+    return (0);
+  }
+
+  if ((time - stillTime) >= config.holdTime) {
+    detected = 1;
+    detectionTime = time;
+  }
+
+  return (detected);
+}
+
+/*********************************************************
+   @brief  Check if landing has been declared
+   @retval 1 if it has, 0 otherwise
+ *********************************************************/
+bool PDC_landing::isLanded() {
+  return (detected);
+}
+
+/*********************************************************
+   @brief  Check if it was the backstop that declared
+            landing, rather than the sensors
+   @retval 1 if it was, 0 otherwise
+ *********************************************************/
+bool PDC_landing::wasBackstop() {
+  return (backstop);
+}
+
+/*********************************************************
+   @brief  Find when landing was declared
+   @retval the time of the sample it was declared on [us]
+            (0 until it has been)
+ *********************************************************/
+uint32_t PDC_landing::getDetectionTime() {
+  return (detectionTime);
+}
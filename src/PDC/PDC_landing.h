@@ -0,0 +1,101 @@
+/*******************************************************************
+   In this file we define the landing detector
+   Landing is when the log file is closed, so it has to be noticed,
+    but there's no hurry: the worst a late decision does is log a
+    few more seconds of sitting on the ground. it's given the
+    velocity estimate and the altimeter pressure as they come in,
+    and decides on them together:
+    + still: the velocity is within maxSpeed of zero, and the
+       pressure is within pressureBand of what it was when the
+       rocket went still. the band is wider than the altimeter
+       noise, but any steady descent leaves it in well under the
+       hold time. either one leaving starts the count again, from
+       the sample that left
+    + landing is declared once it's been still for holdTime
+    + BACKSTOP: backstopTime after the descent started, landing is
+       declared whatever the sensors say, in case they never settle
+       (e.g. a sensor has failed, or it's hanging in a tree in the
+       wind), so the log is always closed in the end
+   Each sample costs a couple of compares, with nothing kept but
+    the reference pressure and the time it was set
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE A DETECTOR WITH THE DEFAULT CONFIGURATION ---
+   PDC_landing landingDetector(LANDING_DEFAULT_CONFIG);
+
+   --- AT APOGEE, START THE CLOCK FOR THE BACKSTOP ---
+   landingDetector.descend(micros());
+
+   --- FEED IT THE VELOCITY [m/s] AND PRESSURE [Pa] ---
+   if (landingDetector.update(velocity, pressure, micros())) {
+     // landed!
+   }
+
+   --- SEE WHEN, AND WHETHER IT WAS THE BACKSTOP ---
+   uint32_t landingTime = landingDetector.getDetectionTime();  // [us]
+   bool backstop = landingDetector.wasBackstop();
+
+ *******************************************************************/
+
+#ifndef _PDC_LANDING
+#define _PDC_LANDING
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+/**************************************************************************
+    the settings for the landing detector
+ **************************************************************************/
+struct PDC_landingConfig {
+  float maxSpeed;         /* [m/s] the fastest the velocity estimate can be, either way, and still count as still */
+  float pressureBand;     /* [Pa] how far the pressure can stray from where it was when the rocket went still */
+  uint32_t holdTime;      /* [us] how long it has to be still for */
+  uint32_t backstopTime;  /* [us] after the descent started, declare landing whatever the sensors say */
+};
+
+/* the band is ~2.5m of height, against the altimeter's few Pa of noise. even a slow 1m/s descent leaves it in under
+   3s, so over the hold time it can only be met on the ground */
+constexpr PDC_landingConfig LANDING_DEFAULT_CONFIG = {
+  2.0,          /* still to within 2m/s... */
+  30.0,         /* ...and 30Pa... */
+  5000000,      /* ...for 5s */
+  1200000000    /* 20 minutes after apogee: more than any descent under our parachute from our apogee takes */
+};
+static_assert(LANDING_DEFAULT_CONFIG.holdTime < LANDING_DEFAULT_CONFIG.backstopTime, "landing has to be able to be seen before the backstop");
+
+/**************************************************************************
+    a class for detecting landing
+ **************************************************************************/
+class PDC_landing {
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    const PDC_landingConfig &config; /* the settings, which stay in the caller's (constant) storage */
+
+    bool descending;        /* the descent has started, so the backstop clock is running */
+    uint32_t descentTime;   /* [us] the time it started */
+    bool still;             /* the last sample was still */
+    float stillPressure;    /* [Pa] the pressure when it went still */
+    uint32_t stillTime;     /* [us] the time it went still */
+
+    bool detected;          /* landing has been declared */
+    bool backstop;          /* it was the backstop that declared it */
+    uint32_t detectionTime; /* [us] the time it was declared */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_landing(const PDC_landingConfig &configuration):
+      config(configuration)
+    {
+      reset();
+    };
+
+    /* ---------- METHODS --------- */
+    void reset();                                                   /* forget everything, ready to fly again */
+    void descend(uint32_t time);                                    /* the descent has started at a time [us] */
+    bool update(float velocity, float pressure, uint32_t time);     /* a new velocity [m/s] and pressure [Pa] at a time [us]. returns 1 once landing has been declared */
+    bool isLanded();                                                /* check if landing has been declared */
+    bool wasBackstop();                                             /* check if it was the backstop that declared it */
+    uint32_t getDetectionTime();                                    /* [us] the time landing was declared */
+};
+
+#endif
@@ -0,0 +1,121 @@
+/* for example usage, see PDC_liftoff.h */
+
+#include "PDC_liftoff.h"  /* include the definition of the class */
+
+/*********************************************************
+   @brief  Forget everything, ready to wait again
+ *********************************************************/
+void PDC_liftoff::reset() {
+  thresholdSquared = config.threshold * config.threshold;
+
+  /* keep a bad config to something that works: a window of at least one sample (or windowTop would be a shift by -1)
+     and at most the width of the bits, needing at least one sample above (or it would go off at rest), and no more
+     than the window holds (or it could never go off) */
+  uint8_t size = constrain(config.windowSize, 1, LIFTOFF_MAX_WINDOW);
+  samplesNeeded = constrain(config.samplesNeeded, 1, size);
+
+  /* a shift by the full width of the type isn't defined, so the widest window is a special case */
+  windowMask = (size < 32) ? ((uint32_t(1) << size) - 1) : 0xFFFFFFFF;
+  windowTop = uint32_t(1) << (size - 1);
+
+  window = 0;
+  above = 0;
+  met = 0;
+  metTime = 0;
+  onset = 0;
+  onsetTime = 0;
+
+  detected = 0;
+  detectionTime = 0;
+  latency = 0;
+}
+
+/*********************************************************
+   @brief  Give the detector a new sample
+   @param  the acceleration along x [g]
+   @param  the acceleration along y [g]
+   @param  the acceleration along z [g]
+   @param  the time of the sample [us]
+   @retval 1 once liftoff has been declared, 0 until then
+ *********************************************************/
+bool PDC_liftoff::update(float x, float y, float z, uint32_t time) {
+  if (detected) {
+    return (1);
+  }
+
+  bool isAbove = ((x * x) + (y * y) + (z * z)) > thresholdSquared;
+
+  /* keep a running count of the set bits, so there's no counting through the window: take off the bit that's
+     about to fall out of the top, then shift the new one in at the bottom */
+  if (window & windowTop) {
+    above--;
+  }
+  window = ((window << 1) | isAbove) & windowMask;
+  if (isAbove) {
+    above++;
+  }
+
+  /* the latency is measured from the first sample above the threshold since the window was last empty */
+  if (above == 0) {
+    onset = 0;
+  }
+  else if (!onset) {
+    onset = 1;
+    onsetTime = time;
+  }
+
+  if (above < samplesNeeded) {
+    met = 0;
+    return (0);
+  }
+
+  if (!met) {
+    met = 1;
+    metTime = time;
+  }
+
+  if ((time - metTime) >= config.sustainTime) {
+    detected = 1;
+    detectionTime = time;
+    latency = time - onsetTime;
+  }
+
+  return (detected);
+}
+
+/*********************************************************
+   @brief  Check if liftoff has been declared
+   @retval 1 if it has, 0 otherwise
+ *********************************************************/
+bool PDC_liftoff::isLiftoff() {
+  return (detected);
+}
+
+/*********************************************************
+   @brief  Check if a sample has gone over the threshold
+            since the window was last empty, so liftoff
+            may be on its way
+   @retval 1 if one has, 0 otherwise
+ *********************************************************/
+bool PDC_liftoff::hasOnset() {
+  return (onset);
+}
+
+/*********************************************************
+   @brief  Find when liftoff was declared
+   @retval the time of the sample it was declared on [us]
+            (0 until it has been)
+ *********************************************************/
+uint32_t PDC_liftoff::getDetectionTime() {
+  return (detectionTime);
+}
+
+/*********************************************************
+   @brief  Find how long liftoff took to declare
+   @retval the time from the first sample above the
+            threshold to the decision [us] (0 until it
+            has been declared)
+ *********************************************************/
+uint32_t PDC_liftoff::getLatency() {
+  return (latency);
+}
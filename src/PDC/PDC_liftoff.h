@@ -0,0 +1,108 @@
+/*******************************************************************
+   In this file we define the liftoff detector
+   Liftoff is the one decision that starts everything else, so it
+    has to be quick, but must never be made by a knock on the pad.
+    the detector is given every accelerometer sample and decides
+    on the size of the acceleration, whichever way it points, so a
+    rail that isn't quite vertical doesn't delay it:
+    + each sample is above the threshold or not. the square of the
+       magnitude is compared with the square of the threshold, so
+       there is no square root
+    + the last windowSize answers are kept as bits, and the window
+       is met while at least samplesNeeded of them are above. a
+       sample or two lost to noise in the motor's rise doesn't
+       start the count again
+    + liftoff is declared once the window has been met for
+       sustainTime without a break. a knock is over long before
+   Each sample costs the same few multiplies, compares and shifts,
+    whatever has come before, so it can be fed from the IMU task,
+    a FIFO drain, or an interrupt
+   The detection latency, from the first sample above the threshold
+    in the run that was declared, to the sample it was declared on,
+    is kept for the log and for tuning
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE A DETECTOR WITH THE DEFAULT CONFIGURATION ---
+   PDC_liftoff liftoffDetector(LIFTOFF_DEFAULT_CONFIG);
+
+   --- FEED IT EVERY ACCELEROMETER SAMPLE [g] ---
+   if (liftoffDetector.update(accelX, accelY, accelZ, micros())) {
+     // liftoff!
+   }
+
+   --- SEE WHEN, AND HOW LONG IT TOOK TO BE SURE ---
+   uint32_t liftoffTime = liftoffDetector.getDetectionTime();  // [us]
+   uint32_t latency = liftoffDetector.getLatency();            // [us]
+
+ *******************************************************************/
+
+#ifndef _PDC_LIFTOFF
+#define _PDC_LIFTOFF
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+const uint8_t LIFTOFF_MAX_WINDOW = 32;  /* [samples] the window is kept as the bits of a uint32_t */
+
+/**************************************************************************
+    the settings for the liftoff detector
+ **************************************************************************/
+struct PDC_liftoffConfig {
+  float threshold;        /* [g] the size of acceleration that counts as the motor (1g at rest) */
+  uint8_t windowSize;     /* [samples] how many of the latest samples make up the window (1 to LIFTOFF_MAX_WINDOW) */
+  uint8_t samplesNeeded;  /* how many of those have to be above the threshold (1 to windowSize) */
+  uint32_t sustainTime;   /* [us] how long the window has to be met for */
+};
+
+/* any motor that gets the rocket off the rail safely pulls well over 3g, so these don't depend on which one we fly.
+   the window lets a ragged first few milliseconds of thrust through, where a straight run of samples wouldn't */
+constexpr PDC_liftoffConfig LIFTOFF_DEFAULT_CONFIG = {
+  3.0,    /* three times what it reads at rest, in any direction */
+  6,      /* over the last 6 samples (24ms at the 250Hz IMU rate)... */
+  4,      /* ...at least 4 are above */
+  10000   /* for 10ms without a break, which no knock on the pad lasts */
+};
+static_assert((LIFTOFF_DEFAULT_CONFIG.windowSize >= 1) && (LIFTOFF_DEFAULT_CONFIG.windowSize <= LIFTOFF_MAX_WINDOW), "liftoff window must be 1 to LIFTOFF_MAX_WINDOW samples");
+static_assert((LIFTOFF_DEFAULT_CONFIG.samplesNeeded >= 1) && (LIFTOFF_DEFAULT_CONFIG.samplesNeeded <= LIFTOFF_DEFAULT_CONFIG.windowSize), "liftoff needs 1 to windowSize samples above the threshold");
+
+/**************************************************************************
+    a class for detecting liftoff
+ **************************************************************************/
+class PDC_liftoff {
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    const PDC_liftoffConfig &config; /* the settings, which stay in the caller's (constant) storage */
+    float thresholdSquared;          /* [g^2] the threshold, squared once up front */
+    uint32_t windowMask;             /* the bits of the window that are in use */
+    uint32_t windowTop;              /* the bit of the oldest sample in the window */
+    uint8_t samplesNeeded;           /* the config's, kept within the window */
+
+    uint32_t window;        /* bit n is set if the sample n samples ago was above the threshold */
+    uint8_t above;          /* how many bits of the window are set */
+    bool met;               /* the window is currently met */
+    uint32_t metTime;       /* [us] the time it was first met, this time */
+    bool onset;             /* there's been a sample above the threshold since the window was last empty */
+    uint32_t onsetTime;     /* [us] the time of that sample */
+
+    bool detected;          /* liftoff has been declared */
+    uint32_t detectionTime; /* [us] the time it was declared */
+    uint32_t latency;       /* [us] from onsetTime to detectionTime */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_liftoff(const PDC_liftoffConfig &configuration):
+      config(configuration)
+    {
+      reset();
+    };
+
+    /* ---------- METHODS --------- */
+    void reset();                                       /* forget everything, ready to wait again */
+    bool update(float x, float y, float z, uint32_t time); /* a new sample [g] at a time [us]. returns 1 once liftoff has been declared */
+    bool isLiftoff();                                   /* check if liftoff has been declared */
+    bool hasOnset();                                    /* check if a sample has gone over the threshold that could still become liftoff */
+    uint32_t getDetectionTime();                        /* [us] the time liftoff was declared */
+    uint32_t getLatency();                              /* [us] from the first sample above the threshold to the decision */
+};
+
+#endif
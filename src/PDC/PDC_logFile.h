@@ -1,29 +1,175 @@
 #ifndef _LOGFILE /* include guard */
 #define _LOGFILE
 
-/* a structure containing the latest measurements to be written to the SD card or main OBC */
+#include <stdint.h>  /* the fixed width types in the record, so the decoder can include this on its own */
+
+/************************************************************************
+                             LOG RECORD UNITS
+    --------------------------------------------------------------------
+    to keep records small, every measurement is logged as a whole
+     number of these units, rounded to the nearest and held at the
+     limits of its field. the number of units in one of each quantity
+     is written in the file header, and the decoder converts back
+    + acceleration: counts of the IMU at +/-32g (int16), so nothing is
+       lost to the log
+    + angular rate: counts of the IMU at +/-250dps (int16), less the
+       bias measured on the pad. +/-286dps
+    + temperature:  1/100 degC (int16)
+    + pressure:     1/64 Pa, 0 to 262kPa (24 bit unsigned)
+    + altitude:     1cm, +/-83km (24 bit signed)
+    + estimates:    1cm/s^2 (int16), 1/32 m/s +/-1024m/s (int16)
+                     and 1cm (24 bit signed)
+ ************************************************************************/
+constexpr float LOG_ACCEL_SCALE      = 1 / 0.976e-3f;  /* [1/g] the sensitivity at the IMU's flight range (PDC.ino checks it) */
+constexpr float LOG_GYRO_SCALE       = 1 / 8.75e-3f;   /* [1/dps] */
+const float LOG_TEMPERATURE_SCALE    = 100;   /* [1/degC] */
+const float LOG_PRESSURE_SCALE       = 64;    /* [1/Pa] */
+const float LOG_ALTITUDE_SCALE       = 100;   /* [1/m] */
+const float LOG_EST_ACCEL_SCALE      = 100;   /* [s^2/m] */
+const float LOG_EST_VELOCITY_SCALE   = 32;    /* [s/m] */
+const float LOG_EST_POSITION_SCALE   = 100;   /* [1/m] */
+
+/* a structure containing the latest measurements to be written to the SD card or main OBC.
+   packed so that the layout written to the SD card is the same on any machine that decodes it.
+   measurements are in the units above - use the logInt functions below to fill them in */
 struct PDC_logFileFields{
-  uint8_t logTime;    // TODO: ensure data types are correct (logTime definitely isnt!)
+  uint32_t logTime;             /* [us] micros() when the record was taken */
   uint8_t flightPhase;
-  float accelerometerX;
-  float accelerometerY;
-  float accelerometerZ;
-  float gyroscopeX;
-  float gyroscopeY;
-  float gyroscopeZ;
-  float altimeterTemperature;
-  float altimeterPressure;
-  float altimeterAltitude;
-  float light1;
-  float light2;
-  float light3;
-  float light4;
-  float estimateAccelerationZ;
-  float estimateVelocityZ;
-  float estimatePositionZ;
-  uint8_t note;
-};
+  uint8_t apogeeDetectors;      /* bit n is set once apogee detector n has fired (see PDC_apogee.h) */
+  int16_t accelerometerX;
+  int16_t accelerometerY;
+  int16_t accelerometerZ;
+  int16_t gyroscopeX;
+  int16_t gyroscopeY;
+  int16_t gyroscopeZ;
+  int16_t altimeterTemperature;
+  uint8_t altimeterPressure[3]; /* 24 bits, least significant byte first */
+  uint8_t altimeterAltitude[3]; /* 24 bits, two's complement */
+  uint16_t light1;              /* ADC counts */
+  uint16_t light2;
+  uint16_t light3;
+  uint16_t light4;
+  int16_t estimateAccelerationZ;
+  int16_t estimateVelocityZ;
+  uint8_t estimatePositionZ[3];
+  uint8_t note;                 /* 0, or one of the LOG_NOTE values below */
+} __attribute__((packed));
+
+const uint8_t LOG_NOTE_PAD_SAMPLE = 1;  /* an accelerometer sample from the pad ring, so the other fields are all 0 */
+
+/* on the pad, the accelerometer samples are kept in a ring of these, much smaller than a record, until liftoff, when
+   they're turned into records and logged (see PDC.ino). they're in the same units as a record */
+struct PDC_padIMUSample {
+  uint16_t time;                /* [us] the bottom 16 bits of micros() when it was taken */
+  int16_t accelerometer[3];
+} __attribute__((packed));
+
+/*********************************************************
+   @brief  round a value, already in log units, into an
+            int16 field, held at the field's limits
+   @param  the value
+   @retval the field
+ *********************************************************/
+inline int16_t logInt16(float value) {
+  if (value >= 32767) {
+    return (32767);
+  }
+  if (value <= -32768) {
+    return (-32768);
+  }
+  return (int16_t((value >= 0) ? (value + 0.5f) : (value - 0.5f)));
+}
+
+/*********************************************************
+   @brief  round a value, already in log units, into a
+            24 bit field, held at the field's limits
+   @param  the field
+   @param  the value
+   @param  true for two's complement, false for unsigned
+ *********************************************************/
+inline void logInt24(uint8_t *field, float value, bool isSigned) {
+  const float highest = isSigned ? 8388607.0f : 16777215.0f;
+  const float lowest = isSigned ? -8388608.0f : 0.0f;
+  int32_t rounded;
+
+  if (value >= highest) {
+    rounded = int32_t(highest);
+  }
+  else if (value <= lowest) {
+    rounded = int32_t(lowest);
+  }
+  else {
+    rounded = int32_t((value >= 0) ? (value + 0.5f) : (value - 0.5f));
+  }
+
+  field[0] = rounded & 0xFF;
+  field[1] = (rounded >> 8) & 0xFF;
+  field[2] = (rounded >> 16) & 0xFF;
+}
+
+/*********************************************************
+   @brief  read a 24 bit field back
+   @param  the field
+   @param  true for two's complement, false for unsigned
+   @retval the value, in log units
+ *********************************************************/
+inline int32_t logReadInt24(const uint8_t *field, bool isSigned) {
+  int32_t value = int32_t(field[0]) | (int32_t(field[1]) << 8) | (int32_t(field[2]) << 16);
+
+  /* carry the sign bit up through the top byte */
+  if (isSigned && (value & 0x800000L)) {
+    value -= 0x1000000L;
+  }
+
+  return (value);
+}
 
 extern struct PDC_logFileFields logFileLine;
 
+/************************************************************************
+                         BINARY LOG FILE FORMAT
+    --------------------------------------------------------------------
+    the log file is a sequence of 512 byte blocks, so that every write
+     to the SD card is one whole, aligned sector. each block starts
+     with a PDC_logBlockHeader, which says what the rest of it holds:
+    + LOG_BLOCK_FILE_HEADER: a PDC_logFileHeader describing the records
+       that follow. written each time the file is opened
+    + LOG_BLOCK_DATA: numRecords PDC_logFileFields records back to
+       back, with the unused end of the block zeroed
+    all values are little endian. see tools/PDC_logDecoder.cpp to
+     convert a log back into .csv
+ ************************************************************************/
+const uint16_t LOG_BLOCK_SIZE        = 512;         /* the size of an SD card sector */
+const uint32_t LOG_FILE_MAGIC        = 0x4C434450;  /* 'PDCL' - identifies a PDC log file header */
+const uint8_t LOG_FILE_VERSION       = 3;           /* bump this whenever the record or header layout changes */
+const uint8_t LOG_BLOCK_FILE_HEADER  = 0x48;        /* 'H' */
+const uint8_t LOG_BLOCK_DATA         = 0x44;        /* 'D' */
+
+/* the start of every block */
+struct PDC_logBlockHeader{
+  uint16_t sequence;    /* counts up from 0 for each block written since the file was opened */
+  uint8_t type;         /* LOG_BLOCK_FILE_HEADER or LOG_BLOCK_DATA */
+  uint8_t numRecords;   /* the number of records in a data block */
+} __attribute__((packed));
+
+/* the contents of a file header block, after the block header */
+struct PDC_logFileHeader{
+  uint32_t magic;           /* LOG_FILE_MAGIC */
+  uint8_t version;          /* LOG_FILE_VERSION */
+  uint16_t recordSize;      /* sizeof(PDC_logFileFields) */
+  uint8_t recordsPerBlock;  /* the most records a data block can hold */
+
+  /* how many record units there are in one of each quantity (LOG_..._SCALE) */
+  float accelScale;
+  float gyroScale;
+  float temperatureScale;
+  float pressureScale;
+  float altitudeScale;
+  float estimateAccelScale;
+  float estimateVelocityScale;
+  float estimatePositionScale;
+} __attribute__((packed));
+
+const uint8_t LOG_RECORDS_PER_BLOCK = (LOG_BLOCK_SIZE - sizeof(PDC_logBlockHeader)) / sizeof(PDC_logFileFields);
+
 #endif
@@ -0,0 +1,68 @@
+/* for example usage, see PDC_profiler.h */
+
+#include "PDC_profiler.h"  /* include the definition of the class */
+
+/*********************************************************
+   @brief  Add a run of a section to the table
+   @param  the section (PROFILE_...)
+   @param  how long it took [ticks]
+ *********************************************************/
+void PDC_profiler::record(uint8_t section, uint32_t ticks) {
+  if (section >= PROFILE_SECTIONS) {
+    return;
+  }
+
+  PDC_profileSection &s = sections[section];
+
+  if ((s.count == 0) || (ticks < s.minimum)) {
+    s.minimum = ticks;
+  }
+  if (ticks > s.maximum) {
+    s.maximum = ticks;
+  }
+  s.count++;
+  s.total += ticks;
+
+  /* the bin is the number of bits the time takes up, so a handful of shifts at most */
+  uint8_t bin = 0;
+  while (ticks && (bin < PROFILE_BINS - 1)) {
+    ticks >>= 1;
+    bin++;
+  }
+  if (s.bins[bin] < 0xFFFF) {
+    s.bins[bin]++;
+  }
+}
+
+/*********************************************************
+   @brief  Empty the table
+ *********************************************************/
+void PDC_profiler::reset() {
+  memset(sections, 0, sizeof(sections));
+}
+
+/*********************************************************
+   @brief  Get the statistics for a section
+   @param  the section (PROFILE_...)
+   @retval the section's entry in the table
+ *********************************************************/
+const PDC_profileSection &PDC_profiler::getSection(uint8_t section) {
+  return (sections[(section < PROFILE_SECTIONS) ? section : 0]);
+}
+
+/*********************************************************
+   @brief  Send the table in binary
+            (see 'PROFILE DUMP FORMAT' in PDC_profiler.h)
+   @param  the serial port to send it on
+ *********************************************************/
+void PDC_profiler::dump(HardwareSerial &port) {
+  PDC_profileHeader header;
+  header.magic = PROFILE_MAGIC;
+  header.version = PROFILE_VERSION;
+  header.sections = PROFILE_SECTIONS;
+  header.bins = PROFILE_BINS;
+  header.nsPerTick = PROFILE_NS_PER_TICK;
+
+  port.write((const uint8_t *)&header, sizeof(header));
+  port.write((const uint8_t *)sections, sizeof(sections));
+}
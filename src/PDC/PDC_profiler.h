@@ -0,0 +1,166 @@
+/*******************************************************************
+   In this file we define the profiler, which times the sections
+    of code that the loop spends its time in
+   A section is timed by putting a marker at the top of the scope
+    that it covers. the time from the marker to the end of the
+    scope is added to the section's entry in a fixed table:
+    + how many times it has run
+    + the shortest, longest and total (for the mean) time
+    + a histogram of the times, in powers of two, which shows up
+       the odd slow run (e.g. an SD card write that takes 100ms)
+       that the mean hides
+   The profiler is only compiled in when PDC_PROFILE is 1 (set it
+    below, or pass -DPDC_PROFILE=1). otherwise the markers compile
+    to nothing, and the table takes no RAM. each marker costs two
+    clock reads and a few adds, and the table 48 bytes of SRAM a
+    section
+   On the PDC the clock is micros() (4us resolution on the nano).
+    on the host build (see tools/host) it is std::chrono instead,
+    in ns, so the host's simulated clock isn't disturbed, and the
+    same sections can be compared on both. the dump says which
+   The table can be dumped on demand in binary (see 'PROFILE DUMP
+    FORMAT' below), which is much smaller and quicker to send than
+    text
+ ************************** Example usage **************************
+
+   --- (GLOBALLY, IN PDC.ino) CREATE THE TABLE ---
+   #if PDC_PROFILE
+   PDC_profiler profiler;
+   #endif
+
+   --- TIME A FUNCTION (OR ANY SCOPE) AS ONE OF THE SECTIONS ---
+   void kalmanUpdateAccel(float accel, uint32_t time) {
+     PROFILE_SECTION(PROFILE_KALMAN);
+     ...
+   }
+
+   --- SEND THE TABLE OVER SERIAL ---
+   profiler.dump(Serial);
+
+   --- OR LOOK AT ONE SECTION ---
+   const PDC_profileSection &kalman = profiler.getSection(PROFILE_KALMAN);
+   uint32_t longest = kalman.maximum;  // [ticks, see PROFILE_NS_PER_TICK]
+
+ *******************************************************************/
+
+/* for detailed function information, see PDC_profiler.cpp */
+
+#ifndef _PDC_PROFILER
+#define _PDC_PROFILER
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+#ifndef PDC_PROFILE
+#define PDC_PROFILE 0 /* 1 to compile the profiler in */
+#endif
+
+/* ---------- SECTIONS ---------- */
+const uint8_t PROFILE_IMU_READ       = 0;  /* reading and fusing every IMU (PDC_sensors::readIMUs) */
+const uint8_t PROFILE_ALTIMETER_READ = 1;  /* reading, compensating and fusing every altimeter (PDC_sensors::readAltimeters) */
+const uint8_t PROFILE_ALTITUDE       = 2;  /* turning a pressure into height above the pad (PDC_BMP388::heightAboveGround) */
+const uint8_t PROFILE_KALMAN         = 3;  /* a Kalman filter predict and correct step (PDC_kalman.ino) */
+const uint8_t PROFILE_ATTITUDE       = 4;  /* an attitude update (PDC_attitude::update) */
+const uint8_t PROFILE_LOG_PUSH       = 5;  /* taking and queueing a log record (logTask) */
+const uint8_t PROFILE_SD_WRITE       = 6;  /* adding a record to the card, and writing the block when it's full (PDC_254::writeRecord) */
+const uint8_t PROFILE_SECTIONS       = 7;
+
+/* bin 0 counts times of 0 ticks, bin n times from 2^(n-1) up to 2^n ticks, and the last bin everything longer */
+const uint8_t PROFILE_BINS = 16;
+
+/* ---------- CLOCK ---------- */
+#ifdef PDC_HOST
+#include <chrono>
+const uint16_t PROFILE_NS_PER_TICK = 1;
+
+inline uint32_t profileNow() {
+  return (uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()));
+}
+#else
+const uint16_t PROFILE_NS_PER_TICK = 1000;
+
+inline uint32_t profileNow() {
+  return (micros());
+}
+#endif
+
+/************************************************************************
+                         PROFILE DUMP FORMAT
+    --------------------------------------------------------------------
+    a PDC_profileHeader, followed by one PDC_profileSection for each
+     of the header's sections, in section order. all values are
+     little endian
+ ************************************************************************/
+const uint32_t PROFILE_MAGIC   = 0x50434450;  /* 'PDCP' - identifies a profile dump */
+const uint8_t PROFILE_VERSION  = 1;           /* bump this whenever the dump layout changes */
+const uint8_t PROFILE_DUMP_COMMAND = 'P';     /* send this over serial to ask for a dump */
+
+struct PDC_profileHeader {
+  uint32_t magic;       /* PROFILE_MAGIC */
+  uint8_t version;      /* PROFILE_VERSION */
+  uint8_t sections;     /* PROFILE_SECTIONS */
+  uint8_t bins;         /* PROFILE_BINS */
+  uint16_t nsPerTick;   /* PROFILE_NS_PER_TICK */
+} __attribute__((packed));
+
+/* the statistics for one section. the total wraps after 2^32 ticks (~71 minutes in a section on the PDC), and each
+   bin stops counting at 65535 */
+struct PDC_profileSection {
+  uint32_t count;               /* how many times the section has run */
+  uint32_t minimum;             /* [ticks] the shortest run */
+  uint32_t maximum;             /* [ticks] the longest run */
+  uint32_t total;               /* [ticks] all of the runs together */
+  uint16_t bins[PROFILE_BINS];  /* the histogram */
+} __attribute__((packed));
+
+/**************************************************************************
+    a class for keeping the profile of every section
+ **************************************************************************/
+class PDC_profiler {
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    PDC_profileSection sections[PROFILE_SECTIONS];
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_profiler():
+      sections()
+    {};
+
+    /* ---------- METHODS --------- */
+    void record(uint8_t section, uint32_t ticks);             /* add a run of a section to the table */
+    void reset();                                             /* empty the table */
+    const PDC_profileSection &getSection(uint8_t section);    /* the statistics for a section */
+    void dump(HardwareSerial &port);                          /* send the table in binary */
+};
+
+#if PDC_PROFILE
+extern PDC_profiler profiler;
+
+/**************************************************************************
+    a marker that times the rest of the scope it's in as a section
+      use PROFILE_SECTION() rather than making one directly, so that
+        it disappears when the profiler isn't compiled in
+ **************************************************************************/
+class PDC_profileScope {
+  private:
+    uint8_t section;  /* the section being timed */
+    uint32_t start;   /* [ticks] when the scope was entered */
+
+  public:
+    PDC_profileScope(uint8_t timedSection):
+      section(timedSection),
+      start(profileNow())
+    {};
+
+    ~PDC_profileScope() {
+      profiler.record(section, profileNow() - start);
+    };
+};
+
+#define PROFILE_SECTION(section) PDC_profileScope profileScope(section)
+#else
+#define PROFILE_SECTION(section)
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/*******************************************************************
+   In this file we define a fixed size ring buffer (FIFO queue)
+    for passing things from one part of the code to another
+   It is single-producer/single-consumer: exactly one place puts
+    items in (push) and exactly one place takes them out (pop).
+    the producer only ever writes 'head' and the consumer only ever
+    writes 'tail', so no locking is needed, and either side can
+    safely be an interrupt routine
+   The storage is a plain array inside the object - no heap - and
+    the capacity must be a power of two so that wrapping the
+    indexes around is a cheap mask rather than a divide
+   If the buffer is full, push() refuses the new item and counts
+    it as dropped, rather than overwriting something the consumer
+    hasn't read yet
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE A BUFFER THAT HOLDS UP TO 8 LOG RECORDS ---
+   PDC_ringBuffer<PDC_logFileFields, 8> logQueue;
+
+   --- (PRODUCER) ADD A RECORD ---
+   if (logQueue.push(logFileLine) != 0) {
+     // full! the record was dropped
+   }
+
+   --- (CONSUMER) TAKE THE OLDEST RECORD OUT, IF THERE IS ONE ---
+   PDC_logFileFields record;
+   if (logQueue.pop(record) == 0) {
+     // do something with record
+   }
+
+   --- (CONSUMER) OR JUST LOOK AT IT, LEAVING IT IN ---
+   if (logQueue.peek(record) == 0) {
+     // decide what to do with record
+   }
+
+ *******************************************************************/
+
+#ifndef _PDC_RINGBUFFER
+#define _PDC_RINGBUFFER
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+/* stop the compiler from moving memory reads/writes across this point. the indexes are volatile, but the items
+   aren't, so without this an item could be copied after the index that says it's ready */
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/**************************************************************************
+    a single-producer/single-consumer ring buffer
+      T:        the type of item to hold
+      CAPACITY: the number of items it can hold. a power of two, and at
+                most 128 so the indexes are single bytes (which the AVR
+                reads and writes in one go, even from an interrupt)
+ **************************************************************************/
+template <typename T, uint8_t CAPACITY>
+class PDC_ringBuffer {
+    static_assert((CAPACITY > 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "ring buffer capacity must be a power of two");
+    static_assert(CAPACITY <= 128, "ring buffer capacity must be at most 128");
+
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    T items[CAPACITY];        /* the storage */
+    volatile uint8_t head;    /* free-running count of items pushed. only written by the producer */
+    volatile uint8_t tail;    /* free-running count of items popped. only written by the consumer */
+    volatile uint16_t drops;  /* how many items were refused because the buffer was full. only written by the producer */
+    volatile uint8_t peak;    /* the most items that have been waiting at once. only written by the producer */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_ringBuffer() {
+      head = 0;
+      tail = 0;
+      drops = 0;
+      peak = 0;
+    };
+
+    /* ---------- METHODS ---------- */
+    /*********************************************************
+       @brief  Add an item to the back of the queue
+                (producer only)
+       @param  the item to add
+       @retval 0 in case of success, 1 if the buffer was full
+     *********************************************************/
+    bool push(const T &item) {
+      uint8_t h = head;
+      /* the counts are free-running, so their difference is the fill level even when they wrap */
+      uint8_t level = uint8_t(h - tail);
+
+      if (level >= CAPACITY) {
+        drops++;
+        return (1);
+      }
+
+      items[h & (CAPACITY - 1)] = item;
+      RING_BUFFER_BARRIER();  /* the item must be in place before the consumer can see it */
+      head = h + 1;
+
+      if (level + 1 > peak) {
+        peak = level + 1;
+      }
+
+      return (0);
+    }
+
+    /*********************************************************
+       @brief  Take the item from the front of the queue
+                (consumer only)
+       @param  where to put the item
+       @retval 0 in case of success, 1 if the buffer was empty
+     *********************************************************/
+    bool pop(T &item) {
+      uint8_t t = tail;
+
+      if (t == head) {
+        return (1);
+      }
+
+      item = items[t & (CAPACITY - 1)];
+      RING_BUFFER_BARRIER();  /* finish copying the item before the producer is allowed to reuse its slot */
+      tail = t + 1;
+
+      return (0);
+    }
+
+    /*********************************************************
+       @brief  Look at the item at the front of the queue,
+                leaving it there (consumer only)
+       @param  where to put a copy of the item
+       @retval 0 in case of success, 1 if the buffer was empty
+     *********************************************************/
+    bool peek(T &item) {
+      uint8_t t = tail;
+
+      if (t == head) {
+        return (1);
+      }
+
+      item = items[t & (CAPACITY - 1)];
+
+      return (0);
+    }
+
+    /*********************************************************
+       @brief  Get the number of items waiting
+       @retval the number of items
+     *********************************************************/
+    uint8_t count() {
+      return (uint8_t(head - tail));
+    }
+
+    /*********************************************************
+       @brief  Get the number of items refused because the
+                buffer was full
+       @retval the number of dropped items
+     *********************************************************/
+    uint16_t dropped() {
+      return (drops);
+    }
+
+    /*********************************************************
+       @brief  Get the most items that have been waiting at
+                once (how close we've come to dropping)
+       @retval the high-water mark
+     *********************************************************/
+    uint8_t highWaterMark() {
+      return (peak);
+    }
+};
+
+#endif
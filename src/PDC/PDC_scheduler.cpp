@@ -0,0 +1,123 @@
+/* for example usage, see PDC_scheduler.h */
+
+#include "PDC_scheduler.h"  /* include the definition of the class */
+
+/*********************************************************
+   @brief  Add a task to the table
+   @param  the function to run
+   @param  the time between releases [us]
+   @param  the time after release by which the task
+            should have finished [us]
+   @retval the ID of the task, or MAX_TASKS if the table
+            is already full
+ *********************************************************/
+uint8_t PDC_scheduler::addTask(void (*callback)(), uint32_t period, uint32_t deadline) {
+  /* no room left, so signify an error by returning an invalid ID */
+  if (numTasks >= MAX_TASKS) {
+    return (MAX_TASKS);
+  }
+
+  PDC_task &task = tasks[numTasks];
+
+  task.callback = callback;
+  task.period = period;
+  task.deadline = deadline;
+  task.nextRelease = clock();
+
+  numTasks++;
+  resetStats();
+
+  return (numTasks - 1);
+}
+
+/*********************************************************
+   @brief  Release every task from the current time
+ *********************************************************/
+void PDC_scheduler::start() {
+  uint32_t now = clock();
+
+  for (uint8_t i = 0; i < numTasks; i++) {
+    tasks[i].nextRelease = now;
+  }
+
+  resetStats();
+}
+
+/*********************************************************
+   @brief  Run the highest priority task that is due
+   @retval 1 if a task was run, 0 if nothing was due
+ *********************************************************/
+bool PDC_scheduler::run() {
+  uint32_t now = clock();
+
+  /* the table is in priority order, so the first task that is due is the one to run */
+  for (uint8_t i = 0; i < numTasks; i++) {
+    PDC_task &task = tasks[i];
+
+    /* times are compared by difference so that the micros() rollover (~70 mins) doesn't upset anything */
+    uint32_t lateness = now - task.nextRelease;
+    if (int32_t(lateness) < 0) {
+      continue; /* not due yet */
+    }
+
+    task.callback();
+
+    uint32_t finish = clock();
+    uint32_t runTime = finish - now;
+
+    /* ---------- STATISTICS ---------- */
+    if (lateness > task.maxJitter) {
+      task.maxJitter = lateness;
+    }
+    if (runTime > task.maxRunTime) {
+      task.maxRunTime = runTime;
+    }
+    if ((finish - task.nextRelease) > task.deadline) {
+      task.overruns++;
+    }
+    task.runCount++;
+
+    /* ---------- NEXT RELEASE ---------- */
+    /* stay on the fixed grid so that the average rate is exact */
+    task.nextRelease += task.period;
+
+    /* but if we've fallen more than a whole period behind, don't try and catch up with a burst of back-to-back runs.
+       drop the missed releases (and count them) instead */
+    while (int32_t(finish - task.nextRelease) >= int32_t(task.period)) {
+      task.nextRelease += task.period;
+      task.skipped++;
+    }
+
+    return (1);
+  }
+
+  return (0);
+}
+
+/*********************************************************
+   @brief  Get a task's timing statistics
+   @param  the ID returned by addTask()
+   @retval the task entry, or NULL if there is no task
+            with that ID
+ *********************************************************/
+const PDC_task *PDC_scheduler::getTask(uint8_t taskID) {
+  /* an ID that was never handed out (e.g. the MAX_TASKS that addTask() returns when the table is full) has no task */
+  if (taskID >= numTasks) {
+    return (NULL);
+  }
+
+  return (&tasks[taskID]);
+}
+
+/*********************************************************
+   @brief  Clear the timing statistics of every task
+ *********************************************************/
+void PDC_scheduler::resetStats() {
+  for (uint8_t i = 0; i < numTasks; i++) {
+    tasks[i].maxJitter = 0;
+    tasks[i].maxRunTime = 0;
+    tasks[i].runCount = 0;
+    tasks[i].overruns = 0;
+    tasks[i].skipped = 0;
+  }
+}
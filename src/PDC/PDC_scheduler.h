@@ -0,0 +1,95 @@
+/*******************************************************************
+   In this file we define a small cooperative scheduler for the PDC
+   Rather than spinning through everything as fast as loop() allows,
+    each job (reading the IMU, reading the altimeter, stepping the
+    Kalman filter, logging, telemetry) is registered as a task with
+    its own period and deadline. every call to run() starts at most
+    one task - the first (highest priority) one that is due - so a
+    slow, low priority task like logging can delay a high priority
+    task by at most one of its own run times, and can never starve it.
+   Tasks are released on a fixed grid (release += period), so the
+    average rate is exact even when individual starts are late.
+   For each task we keep track of:
+    - jitter:   how late the task started compared to its release
+    - run time: how long the task took
+    - overruns: how many times it finished after its deadline
+    - skipped:  how many releases were missed entirely because the
+                task was more than a whole period late
+   The time source is passed in on construction, so the scheduler
+    can run against micros() on the PDC or against a simulated clock
+    on a host machine.
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE A SCHEDULER THAT USES micros() ---
+   PDC_scheduler scheduler(micros);
+
+   --- (IN SETUP) ADD TASKS IN ORDER OF PRIORITY ---
+     run 'readIMU' every 2ms, and require it to finish within 1ms of its release
+   uint8_t imuTask = scheduler.addTask(readIMU, 2000, 1000);
+   scheduler.start();
+
+   --- (IN LOOP) RUN WHATEVER IS DUE ---
+   scheduler.run();
+
+   --- CHECK HOW THE TASK IS BEHAVING ---
+   const PDC_task *task = scheduler.getTask(imuTask);
+   if (task) {
+     uint16_t overruns = task->overruns;
+   }
+
+ *******************************************************************/
+
+#ifndef _PDC_SCHEDULER
+#define _PDC_SCHEDULER
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+
+/* the most tasks that can be registered. the table is statically allocated (30 bytes a task on the nano), so it holds just the
+   ones PDC.ino registers: IMU, altimeter, flight, log and telemetry */
+const uint8_t MAX_TASKS = 5;
+
+/**************************************************************************
+    a single periodic task, along with its timing statistics
+      all times are in microseconds
+ **************************************************************************/
+struct PDC_task {
+  void (*callback)();   /* the function to run */
+  uint32_t period;      /* time between releases */
+  uint32_t deadline;    /* time after release by which the task should have finished */
+  uint32_t nextRelease; /* the time the task is next due to start */
+
+  uint32_t maxJitter;   /* worst start time relative to release */
+  uint32_t maxRunTime;  /* worst time taken to run */
+  uint32_t runCount;    /* how many times the task has run */
+  uint16_t overruns;    /* how many times the task finished after its deadline */
+  uint16_t skipped;     /* how many releases were dropped because the task fell more than a period behind */
+};
+
+/**************************************************************************
+    a class for the cooperative scheduler
+      tasks are held in priority order (first added = highest priority)
+ **************************************************************************/
+class PDC_scheduler {
+  private:
+    /* ---------- ATTRIBUTES ---------- */
+    PDC_task tasks[MAX_TASKS];  /* the task table */
+    uint8_t numTasks;           /* how many tasks are in the table */
+    uint32_t (*clock)();        /* the time source, returning microseconds */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_scheduler(uint32_t (*clockSource)()) {
+      clock = clockSource;  /* remember where to get the time from */
+      numTasks = 0;         /* and start with an empty table */
+    };
+
+    /* ---------- METHODS ---------- */
+    uint8_t addTask(void (*callback)(), uint32_t period, uint32_t deadline); /* add a task below all existing ones in priority. returns its ID */
+    void start();                                                            /* release every task from now */
+    bool run();                                                              /* run the highest priority task that is due. returns 1 if one ran */
+    const PDC_task *getTask(uint8_t taskID);                                 /* get a task's timing statistics. NULL if there's no such task */
+    void resetStats();                                                       /* clear the timing statistics of every task */
+};
+
+#endif
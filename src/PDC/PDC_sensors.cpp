@@ -0,0 +1,383 @@
+/* for example usage, see PDC_sensors.h */
+
+#include "PDC_sensors.h"  /* include the definition of the class */
+#include "PDC_profiler.h" /* for timing the reads */
+
+/*********************************************************
+   @brief  Hand over an IMU
+   @param  the IMU. added after (less trusted than) any
+            already added
+   @retval 0 in case of success, 1 otherwise
+ *********************************************************/
+bool PDC_sensors::addIMU(PDC_LSM6DSO32 &imu) {
+  if (numIMUs >= SENSOR_MAX_IMUS) {
+    return (1);
+  }
+
+  imus[numIMUs] = &imu;
+  numIMUs++;
+  return (0);
+}
+
+/*********************************************************
+   @brief  Hand over an altimeter
+   @param  the altimeter. added after (less trusted than)
+            any already added
+   @retval 0 in case of success, 1 otherwise
+ *********************************************************/
+bool PDC_sensors::addAltimeter(PDC_BMP388 &altimeter) {
+  if (numAltimeters >= SENSOR_MAX_ALTIMETERS) {
+    return (1);
+  }
+
+  altimeters[numAltimeters] = &altimeter;
+  numAltimeters++;
+  return (0);
+}
+
+/*********************************************************
+   @brief  Find how many IMUs have been added
+   @retval the number of IMUs, failed or not
+ *********************************************************/
+uint8_t PDC_sensors::getIMUCount() {
+  return (numIMUs);
+}
+
+/*********************************************************
+   @brief  Find how many altimeters have been added
+   @retval the number of altimeters, failed or not
+ *********************************************************/
+uint8_t PDC_sensors::getAltimeterCount() {
+  return (numAltimeters);
+}
+
+/*********************************************************
+   @brief  Get an IMU, for setting it up
+   @param  the unit (in the order they were added). must
+            be less than getIMUCount()
+   @retval the IMU
+ *********************************************************/
+PDC_LSM6DSO32 &PDC_sensors::getIMU(uint8_t unit) {
+  return (*imus[unit]);
+}
+
+/*********************************************************
+   @brief  Get an altimeter, for setting it up
+   @param  the unit (in the order they were added). must
+            be less than getAltimeterCount()
+   @retval the altimeter
+ *********************************************************/
+PDC_BMP388 &PDC_sensors::getAltimeter(uint8_t unit) {
+  return (*altimeters[unit]);
+}
+
+/*********************************************************
+   @brief  Stop using an IMU
+   @param  the unit
+ *********************************************************/
+void PDC_sensors::failIMU(uint8_t unit) {
+  failedIMUs |= (1 << unit);
+}
+
+/*********************************************************
+   @brief  Stop using an altimeter
+   @param  the unit
+ *********************************************************/
+void PDC_sensors::failAltimeter(uint8_t unit) {
+  failedAltimeters |= (1 << unit);
+}
+
+/*********************************************************
+   @brief  Find which IMUs aren't being used
+   @retval bit n is set if IMU n has failed
+ *********************************************************/
+uint8_t PDC_sensors::getFailedIMUs() {
+  return (failedIMUs);
+}
+
+/*********************************************************
+   @brief  Find which altimeters aren't being used
+   @retval bit n is set if altimeter n has failed
+ *********************************************************/
+uint8_t PDC_sensors::getFailedAltimeters() {
+  return (failedAltimeters);
+}
+
+/*********************************************************
+   @brief  Find the most trusted IMU that's still in use
+   @retval the unit. if every IMU has failed, 0, so that
+            there is always one to talk to
+ *********************************************************/
+uint8_t PDC_sensors::getPrimaryIMU() {
+  for (uint8_t i = 0; i < numIMUs; i++) {
+    if (!(failedIMUs & (1 << i))) {
+      return (i);
+    }
+  }
+  return (0);
+}
+
+/*********************************************************
+   @brief  Find the most trusted altimeter that's still in
+            use
+   @retval the unit. if every altimeter has failed, 0, so
+            that there is always one to talk to
+ *********************************************************/
+uint8_t PDC_sensors::getPrimaryAltimeter() {
+  for (uint8_t i = 0; i < numAltimeters; i++) {
+    if (!(failedAltimeters & (1 << i))) {
+      return (i);
+    }
+  }
+  return (0);
+}
+
+/*********************************************************
+   @brief  Set the gyroscope bias of an IMU
+   @param  the unit
+   @param  the rate it reads at rest, x, y and z [dps]
+ *********************************************************/
+void PDC_sensors::setGyroBias(uint8_t unit, const float bias[3]) {
+  for (uint8_t i = 0; i < 3; i++) {
+    gyroBias[unit][i] = bias[i];
+  }
+}
+
+/*********************************************************
+   @brief  Set the pressure offset of an altimeter
+   @param  the unit
+   @param  how much higher it reads than the primary
+            altimeter [Pa]
+ *********************************************************/
+void PDC_sensors::setPressureOffset(uint8_t unit, float offset) {
+  pressureOffset[unit] = offset;
+}
+
+/*********************************************************
+   @brief  The median of a few values
+   @param  the values, which are sorted in place
+   @param  how many there are (at least one)
+   @retval the median. with an even number, the mean of
+            the middle two
+ *********************************************************/
+float PDC_sensors::median(float *values, uint8_t count) {
+  /* there are only ever a handful, so an insertion sort is as quick as anything */
+  for (uint8_t i = 1; i < count; i++) {
+    float value = values[i];
+    uint8_t j = i;
+    while ((j > 0) && (values[j - 1] > value)) {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = value;
+  }
+
+  if (count & 1) {
+    return (values[count / 2]);
+  }
+  return ((values[count / 2 - 1] + values[count / 2]) / 2);
+}
+
+/*********************************************************
+   @brief  Read and fuse every IMU
+   @param  returns the fused reading. left alone if no IMU
+            gave a good reading
+   @retval 0 in case of success, 1 otherwise
+ *********************************************************/
+bool PDC_sensors::readIMUs(PDC_imuReading &reading) {
+  PROFILE_SECTION(PROFILE_IMU_READ);
+
+  uint8_t rawValue[SENSOR_MAX_IMUS][ALL_DATA_BYTES];
+  IMURawSample raw[SENSOR_MAX_IMUS];
+  uint8_t unitRead = 0;  /* bit n is set if IMU n was read */
+
+  /* ---------- READ ---------- */
+  /* every burst back-to-back in one transaction, so the samples are as close together as they can be. the maths can wait */
+  for (uint8_t u = 0; u < numIMUs; u++) {
+    if (!(failedIMUs & (1 << u))) {
+      if (imus[u]->queueReadAll(rawValue[u]) != 0) {
+        memset(rawValue[u], 0, ALL_DATA_BYTES); /* couldn't be queued, so it reads as a dead unit */
+      }
+      unitRead |= (1 << u);
+    }
+  }
+  runSPIQueue();
+
+  for (uint8_t u = 0; u < numIMUs; u++) {
+    if (unitRead & (1 << u)) {
+      raw[u] = imus[u]->unpackAll(rawValue[u]);
+    }
+  }
+
+  /* ---------- CHECK AND CONVERT ---------- */
+  float values[6][SENSOR_MAX_IMUS]; /* accelerometer x, y, z then gyroscope x, y, z, from each good unit */
+  uint8_t goodUnits[SENSOR_MAX_IMUS];
+  uint8_t numGood = 0;
+
+  for (uint8_t u = 0; u < numIMUs; u++) {
+    if (!(unitRead & (1 << u))) {
+      continue;
+    }
+
+    /* a chip that has gone (or a broken bus) reads the same word everywhere. on a working chip, six identical noisy axes won't happen */
+    const IMURawSample &s = raw[u];
+    if ((s.gyroX == s.gyroY) && (s.gyroY == s.gyroZ) && (s.gyroZ == s.accelX) && (s.accelX == s.accelY) && (s.accelY == s.accelZ)) {
+      if (++imuFaults[u] >= SENSOR_FAULT_LIMIT) {
+        failedIMUs |= (1 << u);
+      }
+      continue;
+    }
+
+    values[0][numGood] = imus[u]->accel.convertRaw(s.accelX);
+    values[1][numGood] = imus[u]->accel.convertRaw(s.accelY);
+    values[2][numGood] = imus[u]->accel.convertRaw(s.accelZ);
+    values[3][numGood] = imus[u]->gyro.convertRaw(s.gyroX) - gyroBias[u][0];
+    values[4][numGood] = imus[u]->gyro.convertRaw(s.gyroY) - gyroBias[u][1];
+    values[5][numGood] = imus[u]->gyro.convertRaw(s.gyroZ) - gyroBias[u][2];
+    goodUnits[numGood] = u;
+    numGood++;
+  }
+
+  if (numGood == 0) {
+    return (1);
+  }
+
+  /* ---------- FUSE ---------- */
+  /* the median needs the values sorted, so work on a copy and keep the unit order for voting */
+  float fused[6];
+  for (uint8_t axis = 0; axis < 6; axis++) {
+    float sorted[SENSOR_MAX_IMUS];
+    for (uint8_t i = 0; i < numGood; i++) {
+      sorted[i] = values[axis][i];
+    }
+    fused[axis] = median(sorted, numGood);
+  }
+
+  /* ---------- VOTE ---------- */
+  /* with three or more, the median has already ignored a unit that's out on its own, so just count it against that unit */
+  for (uint8_t i = 0; i < numGood; i++) {
+    bool outvoted = 0;
+    if (numGood >= 3) {
+      for (uint8_t axis = 0; axis < 6; axis++) {
+        float tolerance = (axis < 3) ? SENSOR_ACCEL_TOLERANCE : SENSOR_GYRO_TOLERANCE;
+        if (fabs(values[axis][i] - fused[axis]) > tolerance) {
+          outvoted = 1;
+        }
+      }
+    }
+
+    uint8_t u = goodUnits[i];
+    if (!outvoted) {
+      imuFaults[u] = 0;
+    }
+    else if (++imuFaults[u] >= SENSOR_FAULT_LIMIT) {
+      failedIMUs |= (1 << u);
+    }
+  }
+
+  for (uint8_t i = 0; i < 3; i++) {
+    reading.accel[i] = fused[i];
+    reading.gyro[i] = fused[i + 3];
+  }
+  reading.units = numGood;
+
+  return (0);
+}
+
+/*********************************************************
+   @brief  Read and fuse every altimeter
+   @retval the fused sample. STATUS_DRDY_PRESS is set in
+            its status if at least one altimeter had a
+            fresh pressure. if none did, it's the last fused
+            sample again, with nothing set
+ *********************************************************/
+altimeterSample PDC_sensors::readAltimeters() {
+  PROFILE_SECTION(PROFILE_ALTIMETER_READ);
+
+  altimeterSample samples[SENSOR_MAX_ALTIMETERS];
+  uint8_t unitRead = 0;  /* bit n is set if altimeter n was read */
+
+  /* ---------- READ ---------- */
+  for (uint8_t u = 0; u < numAltimeters; u++) {
+    if (!(failedAltimeters & (1 << u))) {
+      samples[u] = altimeters[u]->readSample();
+      unitRead |= (1 << u);
+    }
+  }
+
+  /* ---------- CHECK ---------- */
+  /* zeroed, though only the first numGood are ever read, as with room for just one altimeter the compiler can't tell */
+  float pressures[SENSOR_MAX_ALTIMETERS] = {};
+  float temperatures[SENSOR_MAX_ALTIMETERS] = {};
+  uint8_t goodUnits[SENSOR_MAX_ALTIMETERS];
+  uint8_t numGood = 0;
+  uint8_t status = 0;
+
+  for (uint8_t u = 0; u < numAltimeters; u++) {
+    if (!(unitRead & (1 << u))) {
+      continue;
+    }
+
+    bool bad = 0;
+    if (samples[u].status & STATUS_DRDY_PRESS) {
+      altimeterStale[u] = 0;
+
+      /* written so that a NaN fails it too */
+      if (!((samples[u].pressure > SENSOR_PRESSURE_MIN) && (samples[u].pressure < SENSOR_PRESSURE_MAX))) {
+        bad = 1;
+      }
+    }
+    else {
+      /* nothing new isn't a fault in itself - we read a little faster than the altimeter updates - but it
+         shouldn't go on for long */
+      if (altimeterStale[u] < SENSOR_STALE_LIMIT) {
+        altimeterStale[u]++;
+        continue;
+      }
+      bad = 1;
+    }
+
+    if (bad) {
+      if (++altimeterFaults[u] >= SENSOR_FAULT_LIMIT) {
+        failedAltimeters |= (1 << u);
+      }
+      continue;
+    }
+
+    pressures[numGood] = samples[u].pressure - pressureOffset[u];
+    temperatures[numGood] = samples[u].temperature;
+    goodUnits[numGood] = u;
+    numGood++;
+    status |= samples[u].status;
+  }
+
+  if (numGood == 0) {
+    altimeterSample stale = lastAltimeterSample;
+    stale.status = 0;
+    return (stale);
+  }
+
+  /* ---------- FUSE ---------- */
+  float sorted[SENSOR_MAX_ALTIMETERS];
+  for (uint8_t i = 0; i < numGood; i++) {
+    sorted[i] = pressures[i];
+  }
+  float pressure = median(sorted, numGood);
+
+  /* ---------- VOTE ---------- */
+  for (uint8_t i = 0; i < numGood; i++) {
+    uint8_t u = goodUnits[i];
+    if ((numGood < 3) || (fabs(pressures[i] - pressure) <= SENSOR_PRESSURE_TOLERANCE)) {
+      altimeterFaults[u] = 0;
+    }
+    else if (++altimeterFaults[u] >= SENSOR_FAULT_LIMIT) {
+      failedAltimeters |= (1 << u);
+    }
+  }
+
+  lastAltimeterSample.status = status;
+  lastAltimeterSample.pressure = pressure;
+  lastAltimeterSample.temperature = median(temperatures, numGood);
+
+  return (lastAltimeterSample);
+}
@@ -0,0 +1,172 @@
+/*******************************************************************
+   In this file we define the sensor manager, which looks after
+    every IMU and altimeter on the PDC and turns them into one
+    reading of each
+   Each IMU and altimeter is its own class object with its own slave
+    select pin (see PDC_LSM6DSO32.h and PDC_BMP388.h). the manager
+    is given references to them in setup, in order of preference,
+    and from then on:
+    - reads every healthy unit of a kind back-to-back, one burst
+      each, and only does the conversions once the bus is free. the
+      samples are then as close together in time as the bus allows,
+      and a second IMU costs one more 12 byte burst (~15us at 10MHz),
+      not another task. the IMU bursts are queued and run under a
+      single SPI transaction (see PDC_SPI.ino)
+    - fuses them, axis by axis, with the median of the units that
+      gave a good reading (the mean, with two)
+    - rejects a reading that is plainly broken - every IMU word the
+      same (a floating or shorted bus reads all 0x00 or 0xFF), a
+      pressure outside anything we could fly through, or an
+      altimeter that has stopped reporting fresh samples. with three
+      or more units, a reading too far from the median is outvoted
+      too. two units that disagree can't tell which of them is right,
+      so both are kept
+    - drops a unit from the bus altogether once it has given
+      SENSOR_FAULT_LIMIT bad readings in a row. a bad reading only
+      ever costs the sample it came in, so a failing unit never holds
+      up the loop, and a failed one no longer costs any bus time
+   Each unit is calibrated on its own, so the gyroscope bias of each
+    IMU, and the pressure offset of each altimeter from the most
+    trusted one (the BMP388 is only good to +/-50Pa absolute), are
+    taken off before fusing. units that read differently at rest then
+    still agree
+ ************************** Example usage **************************
+
+   --- (GLOBALLY) CREATE THE SENSORS AND THE MANAGER ---
+   PDC_LSM6DSO32 IMU(IMU_SS);
+   PDC_LSM6DSO32 IMU2(IMU2_SS);
+   PDC_BMP388 altimeter(altimeter_SS);
+   PDC_sensors sensors;
+
+   --- (IN SETUP) HAND THEM OVER, MOST TRUSTED FIRST ---
+   sensors.addIMU(IMU);
+   sensors.addIMU(IMU2);
+   sensors.addAltimeter(altimeter);
+
+   --- DON'T USE A UNIT THAT FAILED ITS CHECKS IN SETUP ---
+   if (!sensors.getIMU(1).isAlive()) {
+     sensors.failIMU(1);
+   }
+
+   --- TAKE EACH IMU'S GYROSCOPE BIAS OFF ITS READINGS [dps] ---
+   sensors.setGyroBias(0, bias);
+
+   --- AND EACH ALTIMETER'S DIFFERENCE FROM THE PRIMARY ONE [Pa] ---
+   sensors.setPressureOffset(1, calibration2.pressure.mean - calibration.pressure.mean);
+
+   --- READ ALL OF THE IMUS, FUSED ---
+   PDC_imuReading reading;
+   if (sensors.readIMUs(reading) != 0) {
+     // no IMU gave a good reading
+   }
+   float accelZ = reading.accel[2];  // [g]
+
+   --- READ ALL OF THE ALTIMETERS, FUSED ---
+   altimeterSample sample = sensors.readAltimeters();
+   if (sample.status & STATUS_DRDY_PRESS) {
+     // a fresh pressure from at least one altimeter
+   }
+
+   --- CHECK FOR UNITS THAT HAVE BEEN DROPPED ---
+   if (sensors.getFailedIMUs() & (1 << 1)) {
+     // the second IMU has failed
+   }
+
+ *******************************************************************/
+
+/* for detailed function information, see PDC_sensors.cpp */
+
+#ifndef _PDC_SENSORS
+#define _PDC_SENSORS
+
+#include <Arduino.h>  /* bring some arduino syntax into the cpp files */
+#include <stdio.h>    /* std stuff for cpp */
+#include "PDC_LSM6DSO32.h"  /* the sensors we manage */
+#include "PDC_BMP388.h"
+
+/* the most units that can be managed. three is the fewest that can outvote a bad one, but the tables here, the SPI
+   queue and the arrays readIMUs() keeps on the stack are all sized by these, so they're held to the units that are
+   fitted. each extra IMU costs ~75 bytes of SRAM, stack included (see the budget in PDC.ino) */
+const uint8_t SENSOR_MAX_IMUS = 1;        /* the most IMUs that can be managed */
+const uint8_t SENSOR_MAX_ALTIMETERS = 1;  /* the most altimeters that can be managed */
+static_assert(SPI_QUEUE_SIZE >= SENSOR_MAX_IMUS, "the SPI queue must hold a read for every IMU");
+/* each unit handed over must also have been added to the SPI device table (see PDC_SPI.h), which only has room for the
+   units that are fitted. one that wasn't reads as all zeros, and is dropped */
+
+const uint8_t SENSOR_FAULT_LIMIT = 50;    /* bad readings in a row before a unit is dropped (0.1s of IMU, 2s of altimeter) */
+const uint8_t SENSOR_STALE_LIMIT = 10;    /* reads in a row without a fresh pressure before an altimeter's reading counts as bad (0.4s at 25Hz) */
+
+const float SENSOR_ACCEL_TOLERANCE = 0.5;       /* [g] how far an accelerometer axis can be from the median before it's outvoted */
+const float SENSOR_GYRO_TOLERANCE = 20;         /* [dps] the same for a gyroscope axis */
+const float SENSOR_PRESSURE_TOLERANCE = 200;    /* [Pa] the same for pressure (~17m at sea level) */
+const float SENSOR_PRESSURE_MIN = 30000;        /* [Pa] the lowest pressure we could fly through (~9km) */
+const float SENSOR_PRESSURE_MAX = 110000;       /* [Pa] the highest pressure we could see on the ground */
+
+/**************************************************************************
+    a fused reading from the IMUs
+ **************************************************************************/
+struct PDC_imuReading {
+  float accel[3]; /* [g] x, y, z */
+  float gyro[3];  /* [dps] x, y, z, with each unit's bias taken off */
+  uint8_t units;  /* how many IMUs the reading is made from */
+};
+
+/**************************************************************************
+    a class for managing redundant IMUs and altimeters
+ **************************************************************************/
+class PDC_sensors {
+  private:
+    float median(float *values, uint8_t count);  /* the median of a few values (sorts them in place) */
+
+    /* ---------- ATTRIBUTES ---------- */
+    PDC_LSM6DSO32 *imus[SENSOR_MAX_IMUS];           /* the IMUs, in order of preference */
+    PDC_BMP388 *altimeters[SENSOR_MAX_ALTIMETERS];  /* the altimeters, in order of preference */
+    uint8_t numIMUs;                                /* how many IMUs have been added */
+    uint8_t numAltimeters;                          /* how many altimeters have been added */
+
+    float gyroBias[SENSOR_MAX_IMUS][3];             /* [dps] each IMU's gyroscope output at rest */
+    float pressureOffset[SENSOR_MAX_ALTIMETERS];    /* [Pa] how much higher each altimeter reads than the primary one */
+    uint8_t imuFaults[SENSOR_MAX_IMUS];             /* bad readings in a row from each IMU */
+    uint8_t altimeterFaults[SENSOR_MAX_ALTIMETERS]; /* bad readings in a row from each altimeter */
+    uint8_t altimeterStale[SENSOR_MAX_ALTIMETERS];  /* reads in a row without a fresh pressure from each altimeter */
+    uint8_t failedIMUs;                             /* bit n is set once IMU n has been dropped */
+    uint8_t failedAltimeters;                       /* bit n is set once altimeter n has been dropped */
+
+    altimeterSample lastAltimeterSample;            /* the last fused altimeter sample, for reads with nothing fresh */
+
+  public:
+    /* ---------- CONSTRUCTOR ---------- */
+    PDC_sensors():
+      numIMUs(0),
+      numAltimeters(0),
+      gyroBias(),
+      pressureOffset(),
+      imuFaults(),
+      altimeterFaults(),
+      altimeterStale(),
+      failedIMUs(0),
+      failedAltimeters(0),
+      lastAltimeterSample()
+    {};
+
+    /* ---------- METHODS --------- */
+    bool addIMU(PDC_LSM6DSO32 &imu);                    /* hand over an IMU. 0 in case of success, 1 if there's no room */
+    bool addAltimeter(PDC_BMP388 &altimeter);           /* hand over an altimeter. 0 in case of success, 1 if there's no room */
+    uint8_t getIMUCount();                              /* how many IMUs have been added */
+    uint8_t getAltimeterCount();                        /* how many altimeters have been added */
+    PDC_LSM6DSO32 &getIMU(uint8_t unit);                /* an IMU, for setting it up */
+    PDC_BMP388 &getAltimeter(uint8_t unit);             /* an altimeter, for setting it up */
+    void failIMU(uint8_t unit);                         /* stop using an IMU */
+    void failAltimeter(uint8_t unit);                   /* stop using an altimeter */
+    uint8_t getFailedIMUs();                            /* bit n is set if IMU n isn't being used */
+    uint8_t getFailedAltimeters();                      /* bit n is set if altimeter n isn't being used */
+    uint8_t getPrimaryIMU();                            /* the first IMU still in use (0 if there are none) */
+    uint8_t getPrimaryAltimeter();                      /* the first altimeter still in use (0 if there are none) */
+    void setGyroBias(uint8_t unit, const float bias[3]); /* set the gyroscope bias of an IMU [dps] */
+    void setPressureOffset(uint8_t unit, float offset); /* set how much higher an altimeter reads than the primary one [Pa] */
+
+    bool readIMUs(PDC_imuReading &reading);             /* read and fuse every IMU. 0 in case of success, 1 if none gave a good reading */
+    altimeterSample readAltimeters();                   /* read and fuse every altimeter */
+};
+
+#endif
@@ -33,7 +33,7 @@ void setClockOC1A(uint32_t clkFrq) {
         this value, the counter will clear and pin OC1A will toggle
      to enable this mode, the waveform generator bits WGM13:10 should be 0100 as per datasheet
   */
-  TCCR1B &= !(1 << 4);              /* set WGM13 to 0 */
+  TCCR1B &= ~(1 << 4);              /* set WGM13 to 0 */
   TCCR1B |= (1 << 3);               /* set WGM12 to 1 */
   /* WGM11:10 are already zero as we reset TCCR1A */
 
@@ -73,3 +73,41 @@ void detectClockEdge(uint8_t clockSignal, uint8_t edgeType){
     } 
   }
 }
+
+
+#ifndef PDC_HOST
+extern uint8_t _end;     /* the end of the globals, from the linker */
+extern uint8_t __stack;  /* the top of SRAM, where the stack starts */
+
+/*********************************************************
+   @brief  Fill the SRAM between the globals and the stack
+            with STACK_PAINT, before anything else runs
+ *********************************************************/
+/* it's run by the startup code, in .init3 (once the stack pointer and the zero register are set up, but before
+   the globals are), so it has no frame of its own and can't be called. nothing uses the heap, so the stack
+   is the only thing that ever writes over the paint */
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack() {
+  for (uint8_t *p = &_end; p <= &__stack; p++) {
+    *p = STACK_PAINT;
+  }
+}
+#endif
+
+/*********************************************************
+   @brief  Find how close the stack has ever come to the
+            globals, by how much of the paint is left
+   @retval the bytes it has never reached (UINT16_MAX on
+            a PC, which has its own stack)
+ *********************************************************/
+uint16_t freeStack() {
+#ifndef PDC_HOST
+  uint16_t untouched = 0;
+  for (const uint8_t *p = &_end; (p <= &__stack) && (*p == STACK_PAINT); p++) {
+    untouched++;
+  }
+  return (untouched);
+#else
+  return (UINT16_MAX);
+#endif
+}
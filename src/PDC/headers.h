@@ -5,9 +5,7 @@
 #include <stdio.h> 
 
 /* ---------- GENERAL PARAMETERS ---------- */
-extern const uint8_t LAUNCH_SITE_ALTITUDE;  /* [m] how high above sea level is the launch site? used for measuring noise in altimeter */
-extern const uint8_t ACC_LIFTOFF_THRESHOLD; /* [m/s^2] the threshold value that tells us we have liftoff. this triggers the move from 'wait' mode to 'flight' mode */
-extern const float kalmanTime;              /* time step (s) between Kalman iterations */
+extern const float kalmanTime;              /* nominal time step (s) between Kalman iterations */
 
 /* ---------- HARDWARE PIN VARIABLE DECLARATIONS ---------- */
 extern const uint8_t PDC_SS;        /* the SS pin on the arduino PDC (=10 for nano) */
@@ -22,8 +20,12 @@ extern const uint8_t LPA_AO;  /* the analog output pin that the LPAs will send t
 extern const uint8_t LPA_CLK; /* the pin that will provide clock signal to the LPAs. SHOULD BE KEPT AS PIN 9 ON NANO */
 const uint8_t OC1A_PIN = 9;   /* the ATMega OC1A pin for nano is pin 9. this pin can be used to generate a clock signal up to 8MHz */
 
+/* ---------- STACK PAINTING ---------- */
+const uint8_t STACK_PAINT = 0xC5;   /* what the free SRAM is filled with at boot, so the stack's high water mark can be found */
+
 /* ---------- FUNCTION DECLARATIONS ---------- */
 void setClockOC1A(uint32_t clkFrq); /* a function that accesses the ATmega registers and sets the OC1A pin to provide a clock signal */
 void detectClockEdge(uint8_t clockSignal, uint8_t edgeType);
+uint16_t freeStack();               /* the bytes of SRAM the stack has never reached since boot */
 
 #endif
@@ -0,0 +1,266 @@
+/*******************************************************************
+   A host-side replay of the apogee detection engine
+    (src/PDC/PDC_apogee.h) over decoded flight logs
+   Each log (the .csv from tools/PDC_logDecoder.cpp) is fed through
+    the same engine code the PDC runs, at the rates the PDC feeds
+    it: the velocity estimate every flight task period, and the
+    pressure whenever the altimeter has a new sample. the settings
+    can be changed on the command line, so a detector can be tuned
+    against real (or simulated) flights without flying again
+   The true apogee isn't in the log, so it's taken as the peak of
+    the altimeter altitude after the flight, smoothed over a
+    window either side (which, unlike the PDC, can look ahead).
+    each detector's time, and the decision, are reported relative
+    to it, with a summary of the decision latency over all the logs
+   Records are placed in time by their time stamp (logTime). a log
+    from before the time stamp was added (log version 3) has records
+    assumed to be one log task period apart instead
+ ************************** Example usage **************************
+
+   --- BUILD ---
+   cd tools/host && make replay
+     or
+   g++ -std=c++11 -Itools/host/include -Isrc/PDC -o PDC_apogeeReplay tools/PDC_apogeeReplay.cpp src/PDC/PDC_apogee.cpp
+
+   --- REPLAY SOME FLIGHTS WITH THE PDC'S SETTINGS ---
+   ./PDC_apogeeReplay flight1.csv flight2.csv
+
+   --- REPLAY WITH THE VELOCITY DETECTOR ALONE, AND A LOWER THRESHOLD ---
+   ./PDC_apogeeReplay votes=1,0,0 needed=1 velocity=0.5 flight1.csv
+
+   --- SETTINGS (times in us, see PDC_apogeeConfig) ---
+   lockout=  backup=  velocity=  count=  rise=  votes=v,p,t  needed=
+   log=   the log task period, for logs without time stamps (10000)
+   flight= the flight task period, how often the velocity is fed in (40000)
+   smooth= how far either side of each sample to smooth the altitude over (500000)
+
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "PDC_apogee.h"
+
+/* ---------- THE COLUMNS WE NEED FROM THE LOG ---------- */
+struct replayRecord {
+  uint32_t time;    /* [us] since the PDC started */
+  unsigned flightPhase;
+  float pressure;   /* [Pa] */
+  float altitude;   /* [m] */
+  float velocity;   /* [m/s] estimate */
+};
+
+/*********************************************************
+   @brief  Read the columns we need from a decoded log
+   @param  the .csv file name
+   @param  returns the records, in order
+   @param  the log task period, to time the records of a log
+            without time stamps [us]
+   @retval 0 in case of success, 1 otherwise
+ *********************************************************/
+static bool readLog(const char *fileName, std::vector<replayRecord> &records, uint32_t logPeriod) {
+  FILE *file = fopen(fileName, "r");
+  if (!file) {
+    fprintf(stderr, "couldn't open %s\n", fileName);
+    return (1);
+  }
+
+  static char line[4096];
+  int timeColumn = -1, phaseColumn = -1, pressureColumn = -1, altitudeColumn = -1, velocityColumn = -1;
+
+  /* find the columns by name, so the replay doesn't care about the record layout */
+  if (fgets(line, sizeof(line), file)) {
+    int column = 0;
+    for (char *name = strtok(line, ",\r\n"); name; name = strtok(NULL, ",\r\n"), column++) {
+      if (!strcmp(name, "logTime")) timeColumn = column;
+      if (!strcmp(name, "flightPhase")) phaseColumn = column;
+      if (!strcmp(name, "altimeterPressure")) pressureColumn = column;
+      if (!strcmp(name, "altimeterAltitude")) altitudeColumn = column;
+      if (!strcmp(name, "estimateVelocityZ")) velocityColumn = column;
+    }
+  }
+
+  if ((phaseColumn < 0) || (pressureColumn < 0) || (altitudeColumn < 0) || (velocityColumn < 0)) {
+    fprintf(stderr, "%s: missing columns, is it from PDC_logDecoder?\n", fileName);
+    fclose(file);
+    return (1);
+  }
+
+  while (fgets(line, sizeof(line), file)) {
+    replayRecord record = {};
+    int column = 0;
+    record.time = uint32_t(records.size()) * logPeriod;
+    for (char *value = strtok(line, ",\r\n"); value; value = strtok(NULL, ",\r\n"), column++) {
+      if (column == timeColumn) record.time = strtoul(value, NULL, 10);
+      if (column == phaseColumn) record.flightPhase = strtoul(value, NULL, 10);
+      if (column == pressureColumn) record.pressure = atof(value);
+      if (column == altitudeColumn) record.altitude = atof(value);
+      if (column == velocityColumn) record.velocity = atof(value);
+    }
+    records.push_back(record);
+  }
+
+  fclose(file);
+  return (0);
+}
+
+/*********************************************************
+   @brief  Find the true apogee, after the fact
+   @param  the records
+   @param  the first record after liftoff
+   @param  how far either side to smooth over [us]
+   @retval the record at the peak of the smoothed altitude
+ *********************************************************/
+static size_t findApogee(const std::vector<replayRecord> &records, size_t start, uint32_t halfWidth) {
+  size_t peak = start;
+  double highest = -INFINITY;
+  size_t first = start; /* the window, which only ever moves forwards */
+  size_t last = start;
+
+  for (size_t i = start; i < records.size(); i++) {
+    while ((records[i].time - records[first].time) > halfWidth) {
+      first++;
+    }
+    while ((last + 1 < records.size()) && ((records[last + 1].time - records[i].time) <= halfWidth)) {
+      last++;
+    }
+
+    double sum = 0;
+    for (size_t j = first; j <= last; j++) {
+      sum += records[j].altitude;
+    }
+    double smoothed = sum / (last - first + 1);
+
+    if (smoothed > highest) {
+      highest = smoothed;
+      peak = i;
+    }
+  }
+
+  return (peak);
+}
+
+int main(int argc, char **argv) {
+  PDC_apogeeConfig config = APOGEE_DEFAULT_CONFIG;
+  uint32_t logPeriod = 10000;       /* [us] */
+  uint32_t flightPeriod = 40000;    /* [us] */
+  uint32_t smoothing = 500000;      /* [us] */
+  std::vector<const char *> files;
+
+  for (int i = 1; i < argc; i++) {
+    const char *equals = strchr(argv[i], '=');
+    if (!equals) {
+      files.push_back(argv[i]);
+      continue;
+    }
+
+    std::string key(argv[i], equals - argv[i]);
+    const char *value = equals + 1;
+    if (key == "lockout") config.lockoutTime = strtoul(value, NULL, 10);
+    else if (key == "backup") config.backupTime = strtoul(value, NULL, 10);
+    else if (key == "velocity") config.velocityThreshold = atof(value);
+    else if (key == "count") config.velocityCount = strtoul(value, NULL, 10);
+    else if (key == "rise") config.pressureRise = atof(value);
+    else if (key == "needed") config.votesNeeded = strtoul(value, NULL, 10);
+    else if (key == "log") logPeriod = strtoul(value, NULL, 10);
+    else if (key == "flight") flightPeriod = strtoul(value, NULL, 10);
+    else if (key == "smooth") smoothing = strtoul(value, NULL, 10);
+    else if (key == "votes") {
+      unsigned v[APOGEE_DETECTORS];
+      if (sscanf(value, "%u,%u,%u", &v[0], &v[1], &v[2]) != APOGEE_DETECTORS) {
+        fprintf(stderr, "votes needs %u weights\n", APOGEE_DETECTORS);
+        return (1);
+      }
+      for (uint8_t d = 0; d < APOGEE_DETECTORS; d++) {
+        config.votes[d] = v[d];
+      }
+    }
+    else {
+      fprintf(stderr, "unknown setting %s\n", key.c_str());
+      return (1);
+    }
+  }
+
+  if (files.empty()) {
+    fprintf(stderr, "usage: %s [setting=value ...] <decoded log .csv> ...\n", argv[0]);
+    return (1);
+  }
+
+  static const char *names[APOGEE_DETECTORS] = {"velocity", "pressure", "timer"};
+  std::vector<double> latencies;
+
+  for (const char *fileName : files) {
+    std::vector<replayRecord> records;
+    if (readLog(fileName, records, logPeriod) != 0) {
+      continue;
+    }
+
+    /* liftoff is where the PDC said it was */
+    size_t liftoff = 0;
+    while ((liftoff < records.size()) && (records[liftoff].flightPhase == 0)) {
+      liftoff++;
+    }
+    if (liftoff == records.size()) {
+      printf("%s: no liftoff\n", fileName);
+      continue;
+    }
+
+    size_t apogee = findApogee(records, liftoff, smoothing);
+    double apogeeTime = (records[apogee].time - records[liftoff].time) * 1e-6; /* [s] after liftoff */
+
+    /* the times only matter relative to each other, so start the engine's clock at 0 at liftoff */
+    PDC_apogee engine(config);
+    uint32_t lastVelocity = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+      uint32_t time = (i >= liftoff) ? records[i].time - records[liftoff].time : 0;
+
+      if (i == liftoff) {
+        engine.launch(time);
+      }
+
+      /* a change of pressure is a new altimeter sample */
+      if ((i == 0) || (records[i].pressure != records[i - 1].pressure)) {
+        engine.updatePressure(records[i].pressure, time);
+      }
+
+      if ((i >= liftoff) && ((i == liftoff) || ((time - lastVelocity) >= flightPeriod))) {
+        engine.updateVelocity(records[i].velocity, time);
+        lastVelocity = time;
+      }
+
+      engine.updateTime(time);
+    }
+
+    printf("%s: apogee %.3fs after liftoff", fileName, apogeeTime);
+    for (uint8_t d = 0; d < APOGEE_DETECTORS; d++) {
+      if (engine.getDetectors() & (1 << d)) {
+        printf(", %s %+.3fs", names[d], engine.getDetectorTime(d) * 1e-6 - apogeeTime);
+      }
+    }
+
+    if (engine.isApogee()) {
+      double latency = engine.getDecisionTime() * 1e-6 - apogeeTime;
+      latencies.push_back(latency);
+      printf(", declared %+.3fs\n", latency);
+    }
+    else {
+      printf(", never declared\n");
+    }
+  }
+
+  if (!latencies.empty()) {
+    double lowest = INFINITY, highest = -INFINITY, sum = 0;
+    for (double latency : latencies) {
+      lowest = fmin(lowest, latency);
+      highest = fmax(highest, latency);
+      sum += latency;
+    }
+    printf("%zu of %zu flights declared apogee: latency min %+.3fs, mean %+.3fs, max %+.3fs\n",
+           latencies.size(), files.size(), lowest, sum / latencies.size(), highest);
+  }
+
+  return (0);
+}
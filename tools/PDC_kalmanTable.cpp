@@ -0,0 +1,188 @@
+/*******************************************************************
+   A host-side generator for the Kalman filter's steady-state
+    covariance table (src/PDC/PDC_kalmanTable.h)
+   The PDC's filter (see src/PDC/PDC_kalman.ino) is corrected by the
+    accelerometer every IMU task period, and by the altimeter every
+    altimeter task period. for fixed noise levels, its covariance P
+    settles into the same repeating cycle whatever it starts from -
+    the periodic solution of the Riccati equation. this program finds
+    that solution, by running the filter's covariance equations (in
+    double precision) until P stops changing, for a grid of
+    accelerometer and altimeter noise levels. P is taken just after
+    an altimeter correction
+   At boot the PDC measures the noise of its sensors, and interpolates
+    its starting P from the table, so the filter is converged from the
+    first sample without any iterating on the PDC
+   The constants below must match the ones in src/PDC - the firmware
+    checks this at compile time. if any of them change, regenerate
+ ************************** Example usage **************************
+
+   --- BUILD AND REGENERATE THE TABLE ---
+   g++ -std=c++11 -O2 -o PDC_kalmanTable tools/PDC_kalmanTable.cpp
+   ./PDC_kalmanTable > src/PDC/PDC_kalmanTable.h
+
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ---------- FILTER (must match src/PDC) ---------- */
+const double JERK_NOISE = 25.0;             /* KALMAN_JERK_NOISE in PDC_kalman.ino */
+const unsigned IMU_PERIOD = 4000;           /* [us] IMU_TASK_PERIOD in PDC.ino */
+const unsigned ALTIMETER_PERIOD = 40000;    /* [us] ALTIMETER_TASK_PERIOD in PDC.ino */
+const double GRAVITY = 9.80665;             /* [m/s^2] */
+
+/* ---------- GRID ---------- */
+/* noise standard deviations are spaced logarithmically, as the sensor settings change them by factors. in octaves, so
+   that the PDC can find its place in the table from the exponent of a float (see kalmanSteadyState()) */
+const double ACCEL_NOISE_MIN = 0.001;       /* [g] */
+const double ACCEL_NOISE_RATIO = 2.0;
+const unsigned ACCEL_NOISE_STEPS = 7;       /* 0.001g to 0.064g */
+const double ALTITUDE_NOISE_MIN = 0.05;     /* [m] */
+const double ALTITUDE_NOISE_RATIO = 2.0;
+const unsigned ALTITUDE_NOISE_STEPS = 7;    /* 0.05m to 3.2m */
+
+/* ---------- CONVERGENCE ---------- */
+const unsigned MAX_CYCLES = 100000;         /* altimeter periods */
+const double TOLERANCE = 1e-10;             /* largest change in P over a cycle, relative to sqrt(P(i,i)*P(j,j)) */
+
+/* the same equations as kalmanPropagate() */
+static void propagate(double P[3][3], double dt) {
+  double h = 0.5 * dt * dt;
+  double F[3][3] = {{1, 0, 0}, {dt, 1, 0}, {h, dt, 1}};
+  double q = JERK_NOISE;
+  double Q[3][3] = {{q * dt, q * pow(dt, 2) / 2, q * pow(dt, 3) / 6},
+                    {q * pow(dt, 2) / 2, q * pow(dt, 3) / 3, q * pow(dt, 4) / 8},
+                    {q * pow(dt, 3) / 6, q * pow(dt, 4) / 8, q * pow(dt, 5) / 20}};
+
+  double FP[3][3] = {};
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        FP[i][j] += F[i][k] * P[k][j];
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      double sum = Q[i][j];
+      for (int k = 0; k < 3; k++) {
+        sum += FP[i][k] * F[j][k];
+      }
+      P[i][j] = sum;
+    }
+  }
+}
+
+/* the same equations as kalmanCorrect() */
+static void correct(double P[3][3], int k, double variance) {
+  double S = P[k][k] + variance;
+  double PHt[3] = {P[0][k], P[1][k], P[2][k]};
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      P[i][j] -= PHt[i] * PHt[j] / S;
+}
+
+/*********************************************************
+   @brief  Find the steady-state covariance
+   @param  accelerometer noise standard deviation [g]
+   @param  altimeter noise standard deviation [m]
+   @param  returns the covariance just after an altimeter
+            correction
+   @retval the number of altimeter periods it took
+ *********************************************************/
+static unsigned steadyState(double accelNoise, double altitudeNoise, double P[3][3]) {
+  double accelVariance = pow(accelNoise * GRAVITY, 2);
+  double altitudeVariance = pow(altitudeNoise, 2);
+  unsigned imuPerAltimeter = ALTIMETER_PERIOD / IMU_PERIOD;
+
+  memset(P, 0, 9 * sizeof(double));
+  for (int i = 0; i < 3; i++) {
+    P[i][i] = 1.0;
+  }
+
+  for (unsigned cycle = 1; cycle <= MAX_CYCLES; cycle++) {
+    double previous[3][3];
+    memcpy(previous, P, sizeof(previous));
+
+    /* one altimeter period: an accelerometer correction every IMU period, then the altimeter correction at the end */
+    for (unsigned i = 0; i < imuPerAltimeter; i++) {
+      propagate(P, IMU_PERIOD * 1e-6);
+      correct(P, 0, accelVariance);
+    }
+    correct(P, 2, altitudeVariance);
+
+    double change = 0;
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        change = fmax(change, fabs(P[i][j] - previous[i][j]) / sqrt(P[i][i] * P[j][j]));
+    if (change < TOLERANCE) {
+      return (cycle);
+    }
+  }
+
+  return (MAX_CYCLES);
+}
+
+int main() {
+  printf("/*******************************************************************\n");
+  printf("   GENERATED BY tools/PDC_kalmanTable.cpp - DO NOT EDIT BY HAND\n");
+  printf("   The steady-state Kalman filter covariance, just after an\n");
+  printf("    altimeter correction, for a grid of sensor noise levels.\n");
+  printf("    see PDC_kalman.ino for how it is used\n");
+  printf("   Rows are accelerometer noise %g*%g^i [g], columns altimeter\n", ACCEL_NOISE_MIN, ACCEL_NOISE_RATIO);
+  printf("    noise %g*%g^j [m]. each entry is the upper triangle of P:\n", ALTITUDE_NOISE_MIN, ALTITUDE_NOISE_RATIO);
+  printf("    P00, P01, P02, P11, P12, P22 in m/s^2, m/s and m units\n");
+  printf("   It holds P rather than the gains K: the filter propagates with\n");
+  printf("    the time that has really passed, so it works K out from P at\n");
+  printf("    every step, and P is all it needs to start converged\n");
+  printf(" *******************************************************************/\n\n");
+
+  printf("#ifndef _PDC_KALMAN_TABLE\n#define _PDC_KALMAN_TABLE\n\n");
+  printf("#include <Arduino.h>  /* bring some arduino syntax into the cpp files (and PROGMEM) */\n\n");
+
+  printf("/* ---------- WHAT THE TABLE WAS GENERATED FOR ---------- */\n");
+  printf("constexpr float KALMAN_TABLE_JERK_NOISE = %.6f;\n", JERK_NOISE);
+  printf("constexpr uint32_t KALMAN_TABLE_IMU_PERIOD = %u;        /* [us] */\n", IMU_PERIOD);
+  printf("constexpr uint32_t KALMAN_TABLE_ALTIMETER_PERIOD = %u;  /* [us] */\n\n", ALTIMETER_PERIOD);
+
+  printf("/* ---------- GRID ---------- */\n");
+  printf("const float KALMAN_TABLE_ACCEL_NOISE_MIN = %.6f;      /* [g] */\n", ACCEL_NOISE_MIN);
+  printf("constexpr float KALMAN_TABLE_ACCEL_NOISE_RATIO = %.6f;   /* between rows */\n", ACCEL_NOISE_RATIO);
+  printf("const uint8_t KALMAN_TABLE_ACCEL_NOISE_STEPS = %u;\n", ACCEL_NOISE_STEPS);
+  printf("const float KALMAN_TABLE_ALTITUDE_NOISE_MIN = %.6f;      /* [m] */\n", ALTITUDE_NOISE_MIN);
+  printf("constexpr float KALMAN_TABLE_ALTITUDE_NOISE_RATIO = %.6f;   /* between columns */\n", ALTITUDE_NOISE_RATIO);
+  printf("const uint8_t KALMAN_TABLE_ALTITUDE_NOISE_STEPS = %u;\n", ALTITUDE_NOISE_STEPS);
+  printf("const uint8_t KALMAN_TABLE_ENTRY_SIZE = 6;\n\n");
+
+  printf("const float KALMAN_TABLE[KALMAN_TABLE_ACCEL_NOISE_STEPS][KALMAN_TABLE_ALTITUDE_NOISE_STEPS][KALMAN_TABLE_ENTRY_SIZE] PROGMEM = {\n");
+
+  unsigned worstCycles = 0;
+  for (unsigned i = 0; i < ACCEL_NOISE_STEPS; i++) {
+    double accelNoise = ACCEL_NOISE_MIN * pow(ACCEL_NOISE_RATIO, i);
+    printf("  { /* accelerometer noise %gg */\n", accelNoise);
+
+    for (unsigned j = 0; j < ALTITUDE_NOISE_STEPS; j++) {
+      double altitudeNoise = ALTITUDE_NOISE_MIN * pow(ALTITUDE_NOISE_RATIO, j);
+      double P[3][3];
+      unsigned cycles = steadyState(accelNoise, altitudeNoise, P);
+      if (cycles > worstCycles) {
+        worstCycles = cycles;
+      }
+      if (cycles >= MAX_CYCLES) {
+        fprintf(stderr, "didn't converge for %gg, %gm\n", accelNoise, altitudeNoise);
+        return (1);
+      }
+
+      printf("    {%.7e, %.7e, %.7e, %.7e, %.7e, %.7e}%s /* %gm */\n", P[0][0], P[0][1], P[0][2], P[1][1], P[1][2], P[2][2],
+             (j + 1 < ALTITUDE_NOISE_STEPS) ? "," : " ", altitudeNoise);
+    }
+
+    printf("  }%s\n", (i + 1 < ACCEL_NOISE_STEPS) ? "," : "");
+  }
+
+  printf("};\n\n#endif\n");
+
+  fprintf(stderr, "converged in at most %u altimeter periods (%.1fs of flight)\n", worstCycles, worstCycles * ALTIMETER_PERIOD * 1e-6);
+
+  return (0);
+}
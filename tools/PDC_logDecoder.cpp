@@ -0,0 +1,122 @@
+/*******************************************************************
+   A host-side decoder for the binary log files written by the PDC
+    (see 'BINARY LOG FILE FORMAT' in src/PDC/PDC_logFile.h)
+   The log is read one 512 byte block at a time. header blocks are
+    checked to make sure the records were written with the same
+    layout that this decoder was built with, and every record in
+    every data block is printed as a line of .csv
+   Measurements are logged as whole numbers of small units (see
+    'LOG RECORD UNITS' in src/PDC/PDC_logFile.h). they're converted
+    back to g, dps, degC, Pa, m and s with the scales in each
+    session's header, and the time stamp (logTime) is printed in us
+   Since the file is opened for append on the PDC, one file may hold
+    several sessions - each one starts with its own header block
+   A preallocated flight log that was never closed (e.g. the power
+    was lost) is still at its full allocated size, and the end of it
+    may hold erased or stale sectors. data blocks are only accepted
+    if their sequence number follows on from the block before, so
+    anything after the real end of the log is counted as unreadable
+ ************************** Example usage **************************
+
+   --- BUILD (ON A LITTLE ENDIAN MACHINE, I.E. ANY PC) ---
+   g++ -std=c++11 -o PDC_logDecoder tools/PDC_logDecoder.cpp
+
+   --- DECODE A LOG FILE TAKEN FROM THE microSD CARD ---
+   ./PDC_logDecoder TEMP.BIN > flight.csv
+
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../src/PDC/PDC_logFile.h"
+
+/*********************************************************
+   @brief  Print the .csv column names
+ *********************************************************/
+static void printColumnNames() {
+  printf("session,block,logTime,flightPhase,apogeeDetectors,accelerometerX,accelerometerY,accelerometerZ,"
+         "gyroscopeX,gyroscopeY,gyroscopeZ,altimeterTemperature,altimeterPressure,altimeterAltitude,"
+         "light1,light2,light3,light4,estimateAccelerationZ,estimateVelocityZ,estimatePositionZ,note\n");
+}
+
+/*********************************************************
+   @brief  Print a single record as a line of .csv
+   @param  the session the record belongs to
+   @param  the block sequence number it was found in
+   @param  the record
+   @param  the header of the session, for the units
+ *********************************************************/
+static void printRecord(unsigned session, unsigned sequence, const PDC_logFileFields &r, const PDC_logFileHeader &h) {
+  printf("%u,%u,%u,%u,%u,%f,%f,%f,%f,%f,%f,%f,%f,%f,%u,%u,%u,%u,%f,%f,%f,%u\n",
+         session, sequence, (unsigned)r.logTime, r.flightPhase, r.apogeeDetectors,
+         r.accelerometerX / h.accelScale, r.accelerometerY / h.accelScale, r.accelerometerZ / h.accelScale,
+         r.gyroscopeX / h.gyroScale, r.gyroscopeY / h.gyroScale, r.gyroscopeZ / h.gyroScale,
+         r.altimeterTemperature / h.temperatureScale,
+         logReadInt24(r.altimeterPressure, false) / h.pressureScale,
+         logReadInt24(r.altimeterAltitude, true) / h.altitudeScale,
+         r.light1, r.light2, r.light3, r.light4,
+         r.estimateAccelerationZ / h.estimateAccelScale, r.estimateVelocityZ / h.estimateVelocityScale,
+         logReadInt24(r.estimatePositionZ, true) / h.estimatePositionScale,
+         r.note);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <log file>\n", argv[0]);
+    return (1);
+  }
+
+  FILE *logFile = fopen(argv[1], "rb");
+  if (!logFile) {
+    fprintf(stderr, "couldn't open %s\n", argv[1]);
+    return (1);
+  }
+
+  uint8_t block[LOG_BLOCK_SIZE];
+  PDC_logFileHeader fileHeader = {};  /* the header of the session we're in */
+  unsigned session = 0;       /* how many header blocks we've seen */
+  bool headerValid = false;   /* only decode data that follows a header we understand */
+  uint16_t nextSequence = 0;  /* the sequence number the next data block should have */
+  unsigned records = 0;
+  unsigned badBlocks = 0;
+
+  printColumnNames();
+
+  while (fread(block, 1, LOG_BLOCK_SIZE, logFile) == LOG_BLOCK_SIZE) {
+    PDC_logBlockHeader blockHeader;
+    memcpy(&blockHeader, block, sizeof(blockHeader));
+
+    if (blockHeader.type == LOG_BLOCK_FILE_HEADER) {
+      memcpy(&fileHeader, &block[sizeof(PDC_logBlockHeader)], sizeof(fileHeader));
+      session++;
+
+      headerValid = (fileHeader.magic == LOG_FILE_MAGIC) && (fileHeader.version == LOG_FILE_VERSION) &&
+                    (fileHeader.recordSize == sizeof(PDC_logFileFields));
+      if (!headerValid) {
+        fprintf(stderr, "session %u: unsupported header (magic 0x%08X, version %u, record size %u), skipping it\n",
+                session, (unsigned)fileHeader.magic, fileHeader.version, fileHeader.recordSize);
+      }
+      nextSequence = blockHeader.sequence + 1;
+    }
+    else if ((blockHeader.type == LOG_BLOCK_DATA) && headerValid && (blockHeader.sequence == nextSequence) &&
+             (blockHeader.numRecords <= LOG_RECORDS_PER_BLOCK)) {
+      nextSequence++;
+      for (uint8_t i = 0; i < blockHeader.numRecords; i++) {
+        PDC_logFileFields record;
+        memcpy(&record, &block[sizeof(PDC_logBlockHeader) + (i * sizeof(PDC_logFileFields))], sizeof(record));
+        printRecord(session, blockHeader.sequence, record, fileHeader);
+        records++;
+      }
+    }
+    else {
+      badBlocks++;
+    }
+  }
+
+  fclose(logFile);
+
+  fprintf(stderr, "%u sessions, %u records, %u unreadable blocks\n", session, records, badBlocks);
+
+  return (0);
+}
@@ -0,0 +1,102 @@
+/*******************************************************************
+   Time the attitude estimator (src/PDC/PDC_attitude.h) on a PC
+   usage: PDC_attitudeBench [updates]
+   Reports the cost of one update, with and without the
+    accelerometer correction, and checks the estimator against
+    rotations it should get exactly right. the times are for the
+    PC, not the nano - they're for comparing changes to the
+    estimator with each other, as every update does the same work
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "PDC_attitude.h"
+
+/*********************************************************
+   @brief  Time a run of updates
+   @param  the number of updates
+   @param  the accelerometer reading to use [g]
+   @retval the average time per update [ns]
+ *********************************************************/
+static double timeUpdates(uint32_t updates, float accelZ) {
+  PDC_attitude attitude;
+  attitude.init(0, 0, 1);
+
+  /* vary the inputs a little, so nothing can be worked out once and reused */
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < updates; i++) {
+    float wobble = (i & 15) * 0.01;
+    attitude.update(1 + wobble, -2 + wobble, 0.5, 0.01 * wobble, 0.02, accelZ, i * 2000);
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  /* use the result, so the loop can't be optimised away */
+  float q[4];
+  attitude.getQuaternion(q);
+  if (q[0] > 2) {
+    printf("impossible\n");
+  }
+
+  return (std::chrono::duration<double, std::nano>(stop - start).count() / updates);
+}
+
+/*********************************************************
+   @brief  Spin about one axis with the accelerometer out
+            of range (so the gyroscope alone is used)
+   @param  the rate about x, y and z [dps]
+   @param  how long to spin for [s]
+   @param  returns roll, pitch and yaw at the end [deg]
+ *********************************************************/
+static void spin(float gx, float gy, float gz, float seconds, float angles[3]) {
+  PDC_attitude attitude;
+  attitude.init(0, 0, 1);
+
+  for (uint32_t i = 0; i <= uint32_t(seconds * 500); i++) {
+    attitude.update(gx, gy, gz, 0, 0, 0, i * 2000);
+  }
+
+  angles[0] = attitude.getRoll();
+  angles[1] = attitude.getPitch();
+  angles[2] = attitude.getYaw();
+}
+
+int main(int argc, char **argv) {
+  uint32_t updates = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+  /* ---------- COST ---------- */
+  printf("update with accelerometer correction:    %.1f ns\n", timeUpdates(updates, 1.0));
+  printf("update without (accelerometer not at 1g): %.1f ns\n", timeUpdates(updates, 3.0));
+
+  /* ---------- FAST INVERSE SQUARE ROOT ---------- */
+  /* over the range it's used on: near-unit quaternions, and accelerometer readings that pass the 0.9g-1.1g check */
+  double worst = 0;
+  for (float x = 0.8; x < 1.25; x += 1e-5) {
+    worst = fmax(worst, fabs(invSqrt(x) * sqrt(double(x)) - 1));
+  }
+  printf("invSqrt worst relative error (0.8 to 1.25): %.2e\n", worst);
+
+  /* ---------- CHECKS ---------- */
+  float angles[3];
+  spin(90, 0, 0, 1, angles);
+  printf("90dps about x for 1s: roll %.2f pitch %.2f yaw %.2f [deg]\n", angles[0], angles[1], angles[2]);
+  spin(0, 45, 0, 1, angles);
+  printf("45dps about y for 1s: roll %.2f pitch %.2f yaw %.2f [deg]\n", angles[0], angles[1], angles[2]);
+  spin(0, 0, -30, 2, angles);
+  printf("-30dps about z for 2s: roll %.2f pitch %.2f yaw %.2f [deg]\n", angles[0], angles[1], angles[2]);
+
+  /* starting tilted and held still, the accelerometer alone should bring roll and pitch in. the last fraction of a
+     degree goes with the integral, which (at ATTITUDE_KI) takes minutes to unlearn the 'bias' it picked up on the way */
+  PDC_attitude attitude;
+  attitude.init(0, 0, 1);
+  for (uint32_t i = 0; i < 30000; i++) {
+    attitude.update(0, 0, 0, 0.5, 0, 0.866025, i * 2000);
+  }
+  float down[3];
+  attitude.getGravity(down);
+  printf("started level, held tilted 30deg about y for 60s: roll %.2f pitch %.2f, gravity (%.3f, %.3f, %.3f)\n", attitude.getRoll(),
+         attitude.getPitch(), down[0], down[1], down[2]);
+
+  return (0);
+}
@@ -0,0 +1,224 @@
+/*******************************************************************
+   Time the BMP388 compensation (src/PDC/PDC_BMP388.cpp) on a PC
+   usage: PDC_compensationBench [samples]
+   Reports the cost of turning one raw reading into a pressure, by
+    + the pow() path the driver started with: the datasheet
+       formulas as written, with temperature compensated for every
+       pressure sample
+    + the float path it has now: the same formulas in Horner form,
+       with the temperature terms folded in when temperature is
+       compensated - every sample, or one in 25 as setup() has
+       it
+    + the integer path from the Bosch reference driver
+       (ALT_INTEGER_COMPENSATION)
+   and checks that the three agree over the pressures and
+    temperatures the PDC should see. the times are for the PC, not
+    the nano - they're for comparing the paths with each other.
+    on the nano pow() and 64 bit arithmetic cost much more
+   Also checks that readSample() compensates temperature on the
+    first sample after setTemperatureDecimation(), and then on one in
+    every decimation samples, right up to a decimation of 255
+   Returns 1 if the paths disagree, or the decimation is wrong
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "PDC_BMP388.h"
+
+PDC_logFileFields logFileLine;  /* the compensation writes the temperature into the log record */
+
+const uint8_t BENCH_DECIMATION = 25;  /* temperature once in this many samples, as setup() sets it */
+const float BENCH_FLOAT_TOLERANCE = 0.05;  /* [Pa] the Horner path against the pow() path (float rounding only) */
+const float BENCH_INTEGER_TOLERANCE = 0.1; /* [Pa] the integer path (in 0.01Pa steps) against the float ones */
+
+volatile float benchSink;  /* where the timed loops put their results, so they can't be optimised away */
+
+/**************************************************************************
+    reaches into the driver for the compensation methods (it's a friend)
+ **************************************************************************/
+class PDC_compensationBench {
+  public:
+    /* give the driver the calibration of the part that the host model (PDC_hostSensors.cpp) simulates */
+    static void calibrate(PDC_BMP388 &altimeter) {
+      BMP388CalibrationData &c = altimeter.calibration;
+      c.PAR_T1 = 27777; c.PAR_T2 = 19129; c.PAR_T3 = -7;
+      c.PAR_P1 = 24000; c.PAR_P2 = 12000; c.PAR_P3 = 35; c.PAR_P4 = 0; c.PAR_P5 = 6300; c.PAR_P6 = 30000;
+      c.PAR_P7 = 4; c.PAR_P8 = -9; c.PAR_P9 = 15000; c.PAR_P10 = 30; c.PAR_P11 = -60;
+      altimeter.foldCompensationParams();
+    }
+
+    /* the driver before it was reworked: temperature, then the pressure formula with pow() for every power */
+    static float powPath(PDC_BMP388 &altimeter, uint32_t uncompensatedTemperature, uint32_t uncompensatedPressure) {
+      const float *t = altimeter.temperatureCompensationArray;
+      const float *p = altimeter.pressureCompensationArray;
+
+      float interim1 = float(uncompensatedTemperature) - t[0];
+      float interim2 = interim1 * t[1];
+      float compensatedTemperature = interim2 + (interim1 * interim1) * t[2];
+
+      interim1 = p[7] * pow(compensatedTemperature, 3) + p[6] * pow(compensatedTemperature, 2) + p[5] * compensatedTemperature + p[4];
+      interim2 = float(uncompensatedPressure) *
+                 (p[3] * pow(compensatedTemperature, 3) + p[2] * pow(compensatedTemperature, 2) + p[1] * compensatedTemperature + p[0]);
+      float interim3 = pow(float(uncompensatedPressure), 3) * p[10]
+                       + pow(float(uncompensatedPressure), 2) * (p[8] + p[9] * compensatedTemperature);
+
+      return (interim1 + interim2 + interim3);
+    }
+
+    static float hornerPath(PDC_BMP388 &altimeter, uint32_t uncompensatedTemperature, uint32_t uncompensatedPressure, bool withTemperature) {
+      if (withTemperature) {
+        altimeter.compensateTemperature(uncompensatedTemperature);
+      }
+      return (altimeter.compensatePressure(uncompensatedPressure));
+    }
+
+    static float integerPath(PDC_BMP388 &altimeter, uint32_t uncompensatedTemperature, uint32_t uncompensatedPressure, bool withTemperature) {
+      if (withTemperature) {
+        altimeter.compensateTemperatureInt(uncompensatedTemperature);
+      }
+      return (altimeter.compensatePressureInt(uncompensatedPressure) / 100.0);
+    }
+
+    static float temperature(PDC_BMP388 &altimeter, uint32_t uncompensatedTemperature) {
+      return (altimeter.compensateTemperature(uncompensatedTemperature));
+    }
+
+    /* which of a run of readSample()s compensate temperature: 1 if every one that should did, and none that shouldn't.
+       there's no device, so they read zeros. the last temperature is set to NaN before each, so one that compensates
+       temperature is the one that replaces it */
+    static bool checkDecimation(PDC_BMP388 &altimeter, uint8_t decimation, uint32_t numSamples, uint32_t &refreshes) {
+      altimeter.setTemperatureDecimation(decimation);
+      bool right = 1;
+      refreshes = 0;
+      for (uint32_t i = 0; i < numSamples; i++) {
+        altimeter.lastTemperature = NAN;
+        altimeter.readSample();
+        bool refreshed = !isnan(altimeter.lastTemperature);
+        right = right && (refreshed == ((i % decimation) == 0));  /* the first sample, then one every decimation */
+        refreshes += refreshed;
+      }
+      return (right);
+    }
+};
+
+/*********************************************************
+   @brief  Find the raw reading that compensates to a value
+            (compensation increases with the raw value)
+   @param  the compensation, as a function of the raw value
+   @param  the value wanted
+   @retval the raw reading
+ *********************************************************/
+template <typename F> static uint32_t invert(F compensate, float target) {
+  uint32_t low = 0, high = 0xFFFFFF;
+  while (high - low > 1) {
+    uint32_t middle = low + (high - low) / 2;
+    if (compensate(middle) < target) {
+      low = middle;
+    }
+    else {
+      high = middle;
+    }
+  }
+  return (low);
+}
+
+/* a raw temperature and pressure */
+struct rawSample {
+  uint32_t temperature;
+  uint32_t pressure;
+};
+
+/*********************************************************
+   @brief  Time one of the paths over a set of samples
+   @param  the path: 0 pow(), 1 Horner, 2 integer
+   @param  the samples, and how many
+   @param  how many times to go round them
+   @param  compensate temperature on one sample in this many
+   @retval the average time per pressure [ns]
+ *********************************************************/
+static double timePath(uint8_t path, const rawSample *samples, uint32_t numSamples, uint32_t rounds, uint8_t decimation) {
+  PDC_BMP388 altimeter(0);
+  PDC_compensationBench::calibrate(altimeter);
+
+  /* sum the results, so the loop can't be optimised away */
+  float sum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < numSamples; i++) {
+      const rawSample &s = samples[i];
+      bool withTemperature = ((i % decimation) == 0);
+      if (path == 0) {
+        sum += PDC_compensationBench::powPath(altimeter, s.temperature, s.pressure);
+      }
+      else if (path == 1) {
+        sum += PDC_compensationBench::hornerPath(altimeter, s.temperature, s.pressure, withTemperature);
+      }
+      else {
+        sum += PDC_compensationBench::integerPath(altimeter, s.temperature, s.pressure, withTemperature);
+      }
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+  benchSink = sum;
+
+  return (std::chrono::duration<double, std::nano>(stop - start).count() / (double(rounds) * numSamples));
+}
+
+int main(int argc, char **argv) {
+  uint32_t total = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+
+  PDC_BMP388 altimeter(0);
+  PDC_compensationBench::calibrate(altimeter);
+
+  /* ---------- SAMPLES ---------- */
+  /* pressures from the pad to well above apogee, at temperatures from cold to a hot day, the way they come in a flight:
+     temperature drifting slowly while pressure moves */
+  const uint32_t NUM_SAMPLES = 1024;
+  static rawSample samples[NUM_SAMPLES];
+  for (uint32_t i = 0; i < NUM_SAMPLES; i++) {
+    float temperature = -10 + 55.0 * i / NUM_SAMPLES;                 /* [degC] */
+    float pressure = 60000 + 45000.0 * ((i * 37) % NUM_SAMPLES) / NUM_SAMPLES; /* [Pa] */
+    samples[i].temperature = invert([&](uint32_t raw) { return (PDC_compensationBench::temperature(altimeter, raw)); }, temperature);
+    PDC_compensationBench::temperature(altimeter, samples[i].temperature);
+    samples[i].pressure = invert([&](uint32_t raw) { return (PDC_compensationBench::hornerPath(altimeter, 0, raw, 0)); }, pressure);
+  }
+
+  /* ---------- AGREEMENT ---------- */
+  float worstHorner = 0, worstInteger = 0;
+  for (uint32_t i = 0; i < NUM_SAMPLES; i++) {
+    const rawSample &s = samples[i];
+    float reference = PDC_compensationBench::powPath(altimeter, s.temperature, s.pressure);
+    worstHorner = fmax(worstHorner, fabs(PDC_compensationBench::hornerPath(altimeter, s.temperature, s.pressure, 1) - reference));
+    worstInteger = fmax(worstInteger, fabs(PDC_compensationBench::integerPath(altimeter, s.temperature, s.pressure, 1) - reference));
+  }
+  printf("60kPa to 105kPa, -10 to 45degC: Horner within %.3f Pa of pow(), integer within %.3f Pa\n", worstHorner, worstInteger);
+
+  /* ---------- COST ---------- */
+  uint32_t rounds = (total + NUM_SAMPLES - 1) / NUM_SAMPLES;
+  printf("pow(), temperature every sample:      %6.1f ns\n", timePath(0, samples, NUM_SAMPLES, rounds, 1));
+  printf("Horner, temperature every sample:     %6.1f ns\n", timePath(1, samples, NUM_SAMPLES, rounds, 1));
+  printf("Horner, temperature 1 in %u samples:  %6.1f ns\n", BENCH_DECIMATION, timePath(1, samples, NUM_SAMPLES, rounds, BENCH_DECIMATION));
+  printf("integer, temperature every sample:    %6.1f ns\n", timePath(2, samples, NUM_SAMPLES, rounds, 1));
+  printf("integer, temperature 1 in %u samples: %6.1f ns\n", BENCH_DECIMATION, timePath(2, samples, NUM_SAMPLES, rounds, BENCH_DECIMATION));
+
+  /* ---------- TEMPERATURE DECIMATION ---------- */
+  bool decimationWrong = 0;
+  const uint8_t decimations[3] = {1, BENCH_DECIMATION, 255};
+  const uint32_t DECIMATION_SAMPLES = 1020;
+  for (uint8_t i = 0; i < 3; i++) {
+    uint32_t refreshes;
+    bool right = PDC_compensationBench::checkDecimation(altimeter, decimations[i], DECIMATION_SAMPLES, refreshes);
+    printf("temperature 1 in %3u: compensated on %4u of %u samples%s\n", decimations[i], refreshes, DECIMATION_SAMPLES,
+           right ? "" : "  FAIL");
+    decimationWrong |= !right;
+  }
+
+  if ((worstHorner > BENCH_FLOAT_TOLERANCE) || (worstInteger > BENCH_INTEGER_TOLERANCE)) {
+    printf("FAIL: the compensation paths disagree\n");
+    return (1);
+  }
+  return (decimationWrong);
+}
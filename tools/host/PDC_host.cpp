@@ -0,0 +1,154 @@
+/*******************************************************************
+   Run the PDC sketch on a PC (see PDC_host.h)
+   usage: PDC_host [simulated seconds] [launch time] [noise seed]
+   The sketch's setup() and loop() run unchanged against the
+    sensor models until the simulated time is up. each change of
+    flight phase is reported as it happens, along with how late
+    liftoff, apogee and landing were detected, and the scheduler's
+    timing statistics for every task, and the traffic with every
+    SPI device, are
+    printed at the end, with the profile of the hot paths if the
+    profiler is compiled in (make PROFILE=1). with the profiler,
+    a dump is asked for over serial at liftoff, to check that the
+    sketch doesn't send it in flight
+ *******************************************************************/
+
+#include "PDC_host.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "PDC_scheduler.h"
+#include "PDC_apogee.h"
+#include "PDC_liftoff.h"
+#include "PDC_landing.h"
+#include "PDC_SPI.h"
+#include "PDC_profiler.h"
+
+/* ---------- THE SKETCH ---------- */
+void setup();
+void loop();
+extern uint8_t subRoutine;
+extern PDC_scheduler scheduler;
+extern PDC_apogee apogeeDetector;
+extern PDC_liftoff liftoffDetector;
+extern PDC_landing landingDetector;
+extern const uint8_t IMU_SS;
+extern const uint8_t altimeter_SS;
+extern PDC_spiDevice spiDevices[];
+extern uint8_t numSPIDevices;
+#if PDC_PROFILE
+extern PDC_profiler profiler;
+#endif
+
+int main(int argc, char **argv) {
+  double runTime = (argc > 1) ? atof(argv[1]) : 120.0;  /* [s] */
+  if (argc > 2) {
+    hostProfile.launchTime = atof(argv[2]);
+  }
+  if (argc > 3) {
+    hostSeed(strtoul(argv[3], NULL, 0));
+  }
+
+  hostAttachSensors(IMU_SS, altimeter_SS);
+
+  clock_t wallStart = clock();
+
+  setup();
+
+  uint8_t phase = subRoutine;
+  bool reported = 0;  /* the apogee latency has been printed */
+  double liftoff = 0; /* [s] when the sketch detected liftoff */
+  printf("[host] t=%.3fs setup done, phase %u\n", hostTime * 1e-6, phase);
+#if PDC_PROFILE
+  std::vector<uint8_t> flightSerial;  /* what the sketch sends over serial from liftoff on */
+#endif
+
+  while (hostTime < uint64_t(runTime * 1e6)) {
+    loop();
+
+    if (subRoutine != phase) {
+      phase = subRoutine;
+
+      double altitude, velocity, acceleration;
+      hostFlightState(hostTime * 1e-6, altitude, velocity, acceleration);
+      printf("[host] t=%.3fs phase %u (true altitude %.1fm, velocity %.1fm/s)\n", hostTime * 1e-6, phase, altitude, velocity);
+
+      /* the engine measures time from when the sketch detected liftoff, which is the step we've just seen */
+      if (phase == 1) {
+        liftoff = hostTime * 1e-6;
+        printf("[host] liftoff latency %.3fs (detector: %.3fs from the first sample above the threshold)\n",
+               liftoffDetector.getDetectionTime() * 1e-6 - hostProfile.launchTime, liftoffDetector.getLatency() * 1e-6);
+#if PDC_PROFILE
+        /* ask for a profile dump as it lifts off. it should be dropped, as sending it would hold up the flight */
+        hostSerialInput(&PROFILE_DUMP_COMMAND, 1);
+        hostSerialCapture(&flightSerial);
+#endif
+      }
+
+      if (apogeeDetector.isApogee() && !reported) {
+        static const char *names[APOGEE_DETECTORS] = {"velocity", "pressure", "timer"};
+        reported = 1;
+
+        printf("[host] apogee latency %.3fs (detectors:", liftoff + apogeeDetector.getDecisionTime() * 1e-6 - hostApogeeTime());
+        for (uint8_t i = 0; i < APOGEE_DETECTORS; i++) {
+          if (apogeeDetector.getDetectors() & (1 << i)) {
+            printf(" %s %+.3fs", names[i], liftoff + apogeeDetector.getDetectorTime(i) * 1e-6 - hostApogeeTime());
+          }
+        }
+        printf(")\n");
+      }
+
+      if (phase == 4) {
+        printf("[host] landing latency %.3fs (%s)\n", landingDetector.getDetectionTime() * 1e-6 - hostLandingTime(),
+               landingDetector.wasBackstop() ? "backstop" : "sensors");
+      }
+    }
+  }
+
+  double wallTime = double(clock() - wallStart) / CLOCKS_PER_SEC;
+
+  /* ---------- TASK STATISTICS ---------- */
+  printf("[host] task  runs      max jitter [us]  max run [us]  overruns  skipped\n");
+  for (uint8_t i = 0; const PDC_task *task = scheduler.getTask(i); i++) {
+    printf("[host] %-4u  %-8lu  %-15lu  %-12lu  %-8u  %u\n", i, (unsigned long)task->runCount,
+           (unsigned long)task->maxJitter, (unsigned long)task->maxRunTime, task->overruns, task->skipped);
+  }
+
+  /* ---------- SPI STATISTICS ---------- */
+  printf("[host] SPI pin  transactions  bytes\n");
+  for (uint8_t i = 0; i < numSPIDevices; i++) {
+    printf("[host] %-8u %-13lu %lu\n", spiDevices[i].pin, (unsigned long)spiDevices[i].transactions, (unsigned long)spiDevices[i].bytes);
+  }
+
+#if PDC_PROFILE
+  /* ---------- PROFILE ----------
+     the same table the PDC sends (see PDC_profiler.h), in ns of this PC's time rather than the simulated time. bin n
+     counts runs from 2^(n-1) up to 2^n ns */
+  const char *sectionNames[PROFILE_SECTIONS] = {"imu", "alt", "height", "kalman", "attitude", "log", "sd"};
+  printf("[host] section   runs      min [ns]  mean [ns]  max [ns]  histogram\n");
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) {
+    const PDC_profileSection &section = profiler.getSection(i);
+    printf("[host] %-9s %-9lu %-9lu %-10.0f %-9lu", sectionNames[i], (unsigned long)section.count, (unsigned long)section.minimum,
+           section.count ? double(section.total) * PROFILE_NS_PER_TICK / section.count : 0.0, (unsigned long)section.maximum);
+    for (uint8_t b = 0; b < PROFILE_BINS; b++) {
+      printf(" %u", section.bins[b]);
+    }
+    printf("\n");
+  }
+
+  hostSerialCapture(NULL);
+  bool dumped = 0;
+  for (size_t i = 0; i + 4 <= flightSerial.size(); i++) {
+    dumped = dumped || (memcmp(&flightSerial[i], "PDCP", 4) == 0);
+  }
+  if (liftoff > 0) {
+    printf("[host] profile dump asked for at liftoff: %s\n", dumped ? "sent in flight (WRONG)" : "dropped");
+  }
+#endif
+
+  printf("[host] %.1fs simulated in %.2fs (%.0fx real time)\n", hostTime * 1e-6, wallTime, (hostTime * 1e-6) / wallTime);
+
+  return (0);
+}
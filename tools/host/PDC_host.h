@@ -0,0 +1,103 @@
+/*******************************************************************
+   In this folder we build the PDC sketch for a normal (Linux) PC,
+    so that setup() and loop() can run unchanged, faster than real
+    time, with no hardware attached
+   The Arduino libraries are replaced with stand-ins (include/), and
+    the sensors are replaced with models of their registers, which
+    answer the same SPI transactions as the real parts:
+    + LSM6DSO32: WHO_AM_I, CTRL1-3 (range, rate, reset and
+       auto-increment), self test, data registers and the FIFO
+    + BMP388: CHIP_ID (and the dummy byte on every read), NVM
+       calibration, STATUS data-ready bits, ODR and DATA registers
+   Both are driven by a scripted flight profile - pad, boost, coast,
+    a short fall while the parachute opens, and descent under it -
+    with noise on every reading
+   Time is simulated. it only moves on when the code waits for it
+    (delay()), talks to a device (HOST_SPI_BYTE_US per byte), writes
+    to the card, or reads the clock (HOST_CLOCK_READ_US, so that busy
+    waits finish). the processor's own time isn't modelled, so the
+    scheduler statistics show bus and card time, not maths time
+ ************************** Example usage **************************
+
+   --- BUILD (BasicLinearAlgebra IS NEEDED, AS IT IS FOR THE PDC) ---
+   cd tools/host
+   make BLA_DIR=~/Arduino/libraries/BasicLinearAlgebra
+
+   --- FLY FOR 120 SIMULATED SECONDS, WITH LAUNCH AT 40 SECONDS ---
+   make run ARGS="120 40"
+     or
+   cd build && ./PDC_host 120 40
+
+   --- THE SAME, WITH A DIFFERENT NOISE SEED ---
+   make run ARGS="120 40 7"
+
+   --- FLY 20 FLIGHTS WITH DIFFERENT NOISE, AND SUMMARISE THE APOGEE DETECTION LATENCY ---
+   make latency RUNS=20
+
+   --- DECODE THE LOG THAT WAS WRITTEN TO THE SIMULATED CARD ---
+   make decoder
+   ./build/PDC_logDecoder build/sdcard/FLIGHT00.BIN > flight.csv
+
+ *******************************************************************/
+
+#ifndef _PDC_HOST
+#define _PDC_HOST
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/* ---------- SIMULATED TIMING ---------- */
+const uint32_t HOST_CLOCK_READ_US = 1;       /* [us] cost of each millis()/micros() call */
+const uint32_t HOST_SPI_BYTE_US   = 1;       /* [us] cost of each byte on the SPI bus (8 bits at 10MHz, plus overhead) */
+const uint32_t HOST_SD_BLOCK_US   = 1000;    /* [us] cost of writing a 512 byte block to the card */
+const uint32_t HOST_SD_STALL_US   = 100000;  /* [us] how long the card stays busy after an occasional slow block write */
+const uint32_t HOST_SD_STALL_EVERY = 256;    /* [blocks] how often a slow block write happens */
+
+const char HOST_SD_DIR[] = "sdcard";         /* the host directory that stands in for the card */
+
+extern uint64_t hostTime;  /* [us] the simulated time since power on */
+
+/* ---------- DEVICE MODELS ---------- */
+/* something on the SPI bus. it is selected when its slave select pin goes low */
+class PDC_hostDevice {
+  public:
+    virtual void select() {}                   /* slave select has gone low - a new transaction is starting */
+    virtual void deselect() {}                 /* slave select has gone high */
+    virtual uint8_t transfer(uint8_t mosi) = 0; /* exchange one byte. returns what the device sends back */
+    virtual ~PDC_hostDevice() {}
+};
+
+void hostAttach(uint8_t slaveSelect, PDC_hostDevice *device); /* connect a device model to a slave select pin */
+void hostAttachSensors(uint8_t imuSelect, uint8_t altimeterSelect); /* connect the IMU and altimeter models */
+uint32_t hostSelections(uint8_t slaveSelect); /* how many transactions a device has had (times its slave select went low) */
+
+/* ---------- CARD ---------- */
+void hostCardStall(uint32_t stallTime); /* [us] make the card's occasional slow block writes this slow instead of HOST_SD_STALL_US */
+
+/* ---------- SERIAL ---------- */
+void hostSerialInput(const uint8_t *bytes, size_t size); /* queue bytes for the sketch to read from Serial */
+void hostSerialCapture(std::vector<uint8_t> *buffer);    /* collect what the sketch writes to Serial there instead of printing it (NULL to print again) */
+
+/* ---------- FLIGHT PROFILE ---------- */
+struct PDC_hostFlightProfile {
+  double launchTime;         /* [s] time of liftoff since power on */
+  double boostAcceleration;  /* [m/s^2] acceleration while the motor burns */
+  double burnTime;           /* [s] how long the motor burns */
+  double descentRate;        /* [m/s] vertical speed under the parachute (negative) */
+  double siteAltitude;       /* [m] altitude of the launch site above sea level */
+  double accelNoise;         /* [g] standard deviation of the accelerometer noise */
+  double gyroNoise;          /* [dps] standard deviation of the gyroscope noise */
+  double gyroBias[3];        /* [dps] gyroscope output at rest */
+  double altitudeNoise;      /* [m] standard deviation of the altimeter noise */
+};
+
+extern PDC_hostFlightProfile hostProfile;
+
+/* the true vertical state of the rocket at a time since power on */
+void hostFlightState(double time, double &altitude, double &velocity, double &acceleration);
+double hostApogeeTime();      /* [s] the true time of apogee since power on */
+double hostLandingTime();     /* [s] the true time of landing since power on */
+void hostSeed(uint32_t seed); /* choose the noise for this run */
+
+#endif
@@ -0,0 +1,483 @@
+/* the stand-ins for the Arduino core and libraries. see PDC_host.h */
+
+#include "PDC_host.h"
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <SD.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t hostTime = 0;
+
+HardwareSerial Serial;
+SPIClass SPI;
+TwoWire Wire;
+SDClass SD;
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t OCR1A;
+
+/* -------------------- TIME -------------------- */
+uint32_t millis() {
+  hostTime += HOST_CLOCK_READ_US;
+  return (uint32_t(hostTime / 1000));
+}
+
+uint32_t micros() {
+  hostTime += HOST_CLOCK_READ_US;
+  return (uint32_t(hostTime));
+}
+
+void delay(uint32_t ms) {
+  hostTime += uint64_t(ms) * 1000;
+}
+
+void delayMicroseconds(uint32_t us) {
+  hostTime += us;
+}
+
+/* -------------------- PINS -------------------- */
+const uint8_t HOST_NUM_PINS = 32;
+
+static uint8_t pinLevel[HOST_NUM_PINS];                 /* the last level written to each pin */
+static PDC_hostDevice *pinDevice[HOST_NUM_PINS];        /* the device (if any) whose slave select is on each pin */
+static PDC_hostDevice *selectedDevice = NULL;           /* the device currently talking on the bus */
+static uint32_t pinSelections[HOST_NUM_PINS];          /* how many times each slave select has gone low */
+
+void hostAttach(uint8_t slaveSelect, PDC_hostDevice *device) {
+  pinDevice[slaveSelect] = device;
+  pinLevel[slaveSelect] = HIGH;
+}
+
+uint32_t hostSelections(uint8_t pin) {
+  return ((pin < HOST_NUM_PINS) ? pinSelections[pin] : 0);
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  pinLevel[pin] = value;
+
+  /* slave select pins start and end transactions */
+  PDC_hostDevice *device = pinDevice[pin];
+  if (device) {
+    if (value == LOW) {
+      selectedDevice = device;
+      pinSelections[pin]++;
+      device->select();
+    }
+    else {
+      device->deselect();
+      if (selectedDevice == device) {
+        selectedDevice = NULL;
+      }
+    }
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return ((pin < HOST_NUM_PINS) ? pinLevel[pin] : LOW);
+}
+
+/* -------------------- PORT REGISTERS -------------------- */
+static hostPort ports[PD + 1] = {{NOT_A_PORT}, {NOT_A_PORT}, {PB}, {PC}, {PD}};
+
+/* the first pin on each port (bit 0). the nano has 8 pins on port D, and 6 on each of ports B and C */
+static uint8_t portFirstPin(uint8_t port) {
+  return ((port == PD) ? 0 : (port == PB) ? 8 : 14);
+}
+
+static uint8_t portPins(uint8_t port) {
+  return ((port == PD) ? 8 : 6);
+}
+
+uint8_t digitalPinToPort(uint8_t pin) {
+  return ((pin < 8) ? PD : (pin < 14) ? PB : (pin < 20) ? PC : NOT_A_PORT);
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin) {
+  uint8_t port = digitalPinToPort(pin);
+  return ((port == NOT_A_PORT) ? 0 : (1 << (pin - portFirstPin(port))));
+}
+
+hostPort *portOutputRegister(uint8_t port) {
+  return ((port <= PD) ? &ports[port] : &ports[NOT_A_PORT]);
+}
+
+hostPort::operator uint8_t() const {
+  if (port == NOT_A_PORT) {
+    return (0);
+  }
+
+  uint8_t value = 0;
+  for (uint8_t bit = 0; bit < portPins(port); bit++) {
+    value |= (pinLevel[portFirstPin(port) + bit] ? (1 << bit) : 0);
+  }
+  return (value);
+}
+
+hostPort &hostPort::operator=(uint8_t value) {
+  if (port == NOT_A_PORT) {
+    return (*this);
+  }
+
+  /* only the pins that change, as writing a slave select pin low starts a transaction */
+  for (uint8_t bit = 0; bit < portPins(port); bit++) {
+    uint8_t pin = portFirstPin(port) + bit;
+    uint8_t level = (value & (1 << bit)) ? HIGH : LOW;
+    if (level != pinLevel[pin]) {
+      digitalWrite(pin, level);
+    }
+  }
+  return (*this);
+}
+
+int analogRead(uint8_t) {
+  return (0);
+}
+
+/* -------------------- SPI -------------------- */
+uint8_t SPIClass::transfer(uint8_t data) {
+  hostTime += HOST_SPI_BYTE_US;
+
+  /* with nothing selected, nobody drives MISO */
+  return (selectedDevice ? selectedDevice->transfer(data) : 0xFF);
+}
+
+void SPIClass::transfer(void *buffer, size_t count) {
+  uint8_t *bytes = (uint8_t *)buffer;
+  for (size_t i = 0; i < count; i++) {
+    bytes[i] = transfer(bytes[i]);
+  }
+}
+
+/* -------------------- SERIAL -------------------- */
+static std::deque<uint8_t> serialInput;             /* bytes waiting for the sketch to read */
+static std::vector<uint8_t> *serialCapture = NULL;  /* where the output goes, if not stdout */
+
+void hostSerialInput(const uint8_t *bytes, size_t size) {
+  serialInput.insert(serialInput.end(), bytes, bytes + size);
+}
+
+void hostSerialCapture(std::vector<uint8_t> *buffer) {
+  serialCapture = buffer;
+}
+
+int HardwareSerial::available() {
+  return (serialInput.size());
+}
+
+int HardwareSerial::read() {
+  if (serialInput.empty()) {
+    return (-1);
+  }
+  uint8_t byte = serialInput.front();
+  serialInput.pop_front();
+  return (byte);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (serialCapture) {
+    serialCapture->insert(serialCapture->end(), buffer, buffer + size);
+    return (size);
+  }
+  return (fwrite(buffer, 1, size, stdout));
+}
+
+size_t HardwareSerial::print(const char *text) {
+  return (write((const uint8_t *)text, strlen(text)));
+}
+
+size_t HardwareSerial::print(const String &text) {
+  return (print(text.c_str()));
+}
+
+size_t HardwareSerial::print(char c) {
+  return (write((const uint8_t *)&c, 1));
+}
+
+size_t HardwareSerial::print(double value, int digits) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return (print(text));
+}
+
+size_t HardwareSerial::print(long value, int base) {
+  if (value < 0 && base == DEC) {
+    return (print('-') + print((unsigned long)(-value), base));
+  }
+  return (print((unsigned long)value, base));
+}
+
+size_t HardwareSerial::print(unsigned long value, int base) {
+  /* digits come out least significant first, so build the number backwards */
+  char text[8 * sizeof(long) + 1];
+  char *digit = &text[sizeof(text) - 1];
+  *digit = '\0';
+  do {
+    uint8_t remainder = value % base;
+    *--digit = (remainder < 10) ? ('0' + remainder) : ('A' + remainder - 10);
+    value /= base;
+  } while (value);
+
+  return (print(digit));
+}
+
+/* -------------------- SD CARD -------------------- */
+static uint32_t sdBlocksWritten = 0;  /* for deciding when the card has a slow write */
+static uint64_t sdBusyUntil = 0;      /* [us] the card is busy programming the last block until then */
+static uint32_t sdStallTime = HOST_SD_STALL_US;
+
+void hostCardStall(uint32_t stallTime) {
+  sdStallTime = stallTime;
+}
+
+/* the library waits for the card to finish with the last block before it sends anything else */
+static void sdWaitNotBusy() {
+  if (hostTime < sdBusyUntil) {
+    hostTime = sdBusyUntil;
+  }
+}
+
+/* charge the simulated time for writing some bytes to the card. each block is sent once the card has finished with
+   the last, and every so often the card then stays busy for a long time with a block */
+static void sdWriteTime(size_t bytes) {
+  uint32_t blocks = (bytes + 511) / 512;
+  for (uint32_t i = 0; i < blocks; i++) {
+    sdWaitNotBusy();
+    hostTime += HOST_SD_BLOCK_US;
+    sdBlocksWritten++;
+    if ((sdBlocksWritten % HOST_SD_STALL_EVERY) == 0) {
+      sdBusyUntil = hostTime + sdStallTime;
+    }
+  }
+}
+
+/* the host path of a file on the card */
+static String sdPath(const char *fileName) {
+  return (String(HOST_SD_DIR) + "/" + fileName);
+}
+
+bool SDClass::begin(uint8_t) {
+  mkdir(HOST_SD_DIR, 0777);
+
+  struct stat info;
+  return ((stat(HOST_SD_DIR, &info) == 0) && S_ISDIR(info.st_mode));
+}
+
+bool SDClass::exists(const char *fileName) {
+  return (access(sdPath(fileName).c_str(), F_OK) == 0);
+}
+
+File SDClass::open(const char *fileName, uint8_t mode) {
+  return (File(fopen(sdPath(fileName).c_str(), (mode == FILE_WRITE) ? "ab" : "rb")));
+}
+
+bool SDClass::remove(const char *fileName) {
+  return (::remove(sdPath(fileName).c_str()) == 0);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!handle) {
+    return (0);
+  }
+  sdWriteTime(size);
+  return (fwrite(buffer, 1, size, handle));
+}
+
+int File::read(void *buffer, uint16_t size) {
+  return (handle ? int(fread(buffer, 1, size, handle)) : -1);
+}
+
+void File::flush() {
+  if (handle) {
+    hostTime += HOST_SD_BLOCK_US * 2; /* the directory entry and FAT are rewritten */
+    fflush(handle);
+  }
+}
+
+void File::close() {
+  if (handle) {
+    fclose(handle);
+    handle = NULL;
+  }
+}
+
+uint32_t File::size() {
+  if (!handle) {
+    return (0);
+  }
+  long position = ftell(handle);
+  fseek(handle, 0, SEEK_END);
+  long end = ftell(handle);
+  fseek(handle, position, SEEK_SET);
+  return (uint32_t(end));
+}
+
+/* -------------------- RAW SECTORS --------------------
+   contiguous files are given made-up block numbers, one after the other, so that a block number can be
+   traced back to the host file and offset that holds it */
+static uint8_t sdCache[512];  /* the library's one block cache, shared by every volume */
+
+/* a file system call reads and writes directory and FAT sectors through the cache, so whatever was in it is gone */
+static void sdUseCache() {
+  memset(sdCache, 0xA5, sizeof(sdCache));
+}
+
+uint8_t Sd2Card::init(uint8_t, uint8_t chipSelectPin) {
+  return (SD.begin(chipSelectPin));
+}
+
+uint8_t *SdVolume::cacheClear() {
+  return (sdCache);
+}
+
+uint8_t SdFile::openRoot(SdVolume *vol) {
+  if (isOpen || (vol == NULL)) {
+    return (0);
+  }
+  sdUseCache();
+  strcpy(path, HOST_SD_DIR);
+  isOpen = true;
+  return (1);
+}
+
+uint8_t SdFile::open(SdFile *dirFile, const char *fileName, uint8_t) {
+  if (isOpen || !dirFile->isOpen) {
+    return (0);
+  }
+  sdUseCache();
+  if (!SD.exists(fileName)) {
+    return (0);
+  }
+
+  snprintf(path, sizeof(path), "%s", sdPath(fileName).c_str());
+  firstBlock = 0;
+  numBlocks = 0;
+  isOpen = true;
+  return (1);
+}
+struct PDC_hostAllocation {
+  String path;
+  uint32_t firstBlock;
+  uint32_t numBlocks;
+};
+
+static std::vector<PDC_hostAllocation> allocations;
+static uint32_t nextFreeBlock = 1024; /* leave room for a pretend FAT and root directory */
+
+uint8_t SdFile::createContiguous(SdFile *dirFile, const char *fileName, uint32_t size) {
+  if (isOpen || !dirFile->isOpen || SD.exists(fileName) || (size == 0)) {
+    return (0);
+  }
+  sdUseCache();
+
+  String hostPath = sdPath(fileName);
+  FILE *handle = fopen(hostPath.c_str(), "wb");
+  if (!handle) {
+    return (0);
+  }
+  fclose(handle);
+
+  strncpy(path, hostPath.c_str(), sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+  numBlocks = (size + 511) / 512;
+  firstBlock = nextFreeBlock;
+  nextFreeBlock += numBlocks;
+
+  /* the whole allocation belongs to the file straight away */
+  if (::truncate(path, off_t(numBlocks) * 512) != 0) {
+    return (0);
+  }
+
+  PDC_hostAllocation allocation = {hostPath, firstBlock, numBlocks};
+  allocations.push_back(allocation);
+
+  isOpen = true;
+  return (1);
+}
+
+uint8_t SdFile::contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock) {
+  if (!isOpen) {
+    return (0);
+  }
+  *bgnBlock = firstBlock;
+  *endBlock = firstBlock + numBlocks - 1;
+  return (1);
+}
+
+uint8_t SdFile::truncate(uint32_t size) {
+  sdUseCache();
+  return (isOpen && (::truncate(path, off_t(size)) == 0));
+}
+
+uint8_t SdFile::remove() {
+  if (!isOpen) {
+    return (0);
+  }
+  sdUseCache();
+  isOpen = false;
+  return (::remove(path) == 0);
+}
+
+uint8_t SdFile::close() {
+  if (!isOpen) {
+    return (0);
+  }
+  sdUseCache();
+  isOpen = false;
+  return (1);
+}
+
+uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+  writeBlock = blockNumber;
+  writeEnd = blockNumber + eraseCount;
+  return (1);
+}
+
+uint8_t Sd2Card::writeData(const uint8_t *src) {
+  if (writeBlock >= writeEnd) {
+    return (0);
+  }
+
+  /* find the file that owns this block, and write it there */
+  for (size_t i = 0; i < allocations.size(); i++) {
+    const PDC_hostAllocation &allocation = allocations[i];
+    if ((writeBlock >= allocation.firstBlock) && (writeBlock < allocation.firstBlock + allocation.numBlocks)) {
+      FILE *handle = fopen(allocation.path.c_str(), "r+b");
+      if (!handle) {
+        return (0);
+      }
+      fseek(handle, long(writeBlock - allocation.firstBlock) * 512, SEEK_SET);
+      size_t written = fwrite(src, 1, 512, handle);
+      fclose(handle);
+
+      sdWriteTime(512);
+      writeBlock++;
+      return (written == 512);
+    }
+  }
+
+  return (0);
+}
+
+uint8_t Sd2Card::isBusy() {
+  hostTime += HOST_SPI_BYTE_US; /* one byte read back with the card selected - it holds the line low while busy */
+  return (hostTime < sdBusyUntil);
+}
+
+uint8_t Sd2Card::writeStop() {
+  sdWaitNotBusy();
+  writeEnd = writeBlock;
+  return (1);
+}
@@ -0,0 +1,10 @@
+/*******************************************************************
+   The PDC's SPI layer (src/PDC/PDC_SPI.ino) on its own, for the
+    host tests and benches that drive a driver without the rest of
+    the sketch. the sketch build gets it with the other .ino files
+ *******************************************************************/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "PDC_SPI.h"
+#include "PDC_SPI.ino"
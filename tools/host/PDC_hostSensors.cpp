@@ -0,0 +1,481 @@
+/* register models of the IMU and altimeter, and the flight profile that drives them. see PDC_host.h */
+
+#include "PDC_host.h"
+#include "PDC_apogee.h"  /* the flight the apogee detector is set for */
+#include <math.h>
+#include <string.h>
+#include <deque>
+#include <random>
+
+const double GRAVITY = 9.80665; /* [m/s^2] */
+
+PDC_hostFlightProfile hostProfile = {
+  40.0,           /* launch 40s after power on, so setup and calibration have finished */
+  APOGEE_FLIGHT_BOOST * GRAVITY, /* boost... */
+  APOGEE_FLIGHT_BURN_TIME,        /* ...for the burn time of the motor the apogee detector is set for */
+  -20.0,          /* descend at 20m/s under the parachute */
+  142.0,          /* launch site altitude */
+  0.01,           /* accelerometer noise */
+  0.5,            /* gyroscope noise */
+  {0.8, -0.5, 0.3}, /* gyroscope bias */
+  0.3             /* altimeter noise */
+};
+
+static std::mt19937 noiseSource(1); /* fixed seed, so every run is the same unless hostSeed() is called */
+
+/*********************************************************
+   @brief  Choose the noise for this run
+   @param  the seed for the noise generator
+ *********************************************************/
+void hostSeed(uint32_t seed) {
+  noiseSource.seed(seed);
+}
+
+static double noise(double standardDeviation) {
+  std::normal_distribution<double> distribution(0, standardDeviation);
+  return (distribution(noiseSource));
+}
+
+/*********************************************************
+   @brief  The true time of apogee
+   @retval time since power on [s]
+ *********************************************************/
+double hostApogeeTime() {
+  const PDC_hostFlightProfile &p = hostProfile;
+  return (p.launchTime + p.burnTime + (p.boostAcceleration * p.burnTime / GRAVITY));
+}
+
+/*********************************************************
+   @brief  The true time of landing
+   @retval time since power on [s]
+ *********************************************************/
+double hostLandingTime() {
+  const PDC_hostFlightProfile &p = hostProfile;
+  double burnoutVelocity = p.boostAcceleration * p.burnTime;
+  double apogeeAltitude = (0.5 * p.boostAcceleration * p.burnTime * p.burnTime) + (burnoutVelocity * burnoutVelocity) / (2 * GRAVITY);
+  double fallTime = -p.descentRate / GRAVITY;
+  double parachuteAltitude = apogeeAltitude - (0.5 * GRAVITY * fallTime * fallTime);
+  return (hostApogeeTime() + fallTime + (parachuteAltitude / -p.descentRate));
+}
+
+/*********************************************************
+   @brief  The true vertical state of the rocket
+   @param  time since power on [s]
+   @param  returns altitude above the launch site [m]
+   @param  returns vertical velocity [m/s]
+   @param  returns vertical acceleration, not including
+            gravity [m/s^2]
+ *********************************************************/
+void hostFlightState(double time, double &altitude, double &velocity, double &acceleration) {
+  const PDC_hostFlightProfile &p = hostProfile;
+  double t = time - p.launchTime;
+
+  /* the state at burnout, and at apogee (coasting under gravity alone) */
+  double burnoutVelocity = p.boostAcceleration * p.burnTime;
+  double burnoutAltitude = 0.5 * p.boostAcceleration * p.burnTime * p.burnTime;
+  double apogeeTime = p.burnTime + (burnoutVelocity / GRAVITY);
+  double apogeeAltitude = burnoutAltitude + (burnoutVelocity * burnoutVelocity) / (2 * GRAVITY);
+  double fallTime = -p.descentRate / GRAVITY; /* the parachute is fully open once we've fallen up to the descent rate */
+
+  if (t < 0) {
+    /* on the pad */
+    altitude = 0;
+    velocity = 0;
+    acceleration = 0;
+  }
+  else if (t < p.burnTime) {
+    /* boost */
+    altitude = 0.5 * p.boostAcceleration * t * t;
+    velocity = p.boostAcceleration * t;
+    acceleration = p.boostAcceleration;
+  }
+  else if (t < apogeeTime) {
+    /* coast */
+    double c = t - p.burnTime;
+    altitude = burnoutAltitude + (burnoutVelocity * c) - (0.5 * GRAVITY * c * c);
+    velocity = burnoutVelocity - (GRAVITY * c);
+    acceleration = -GRAVITY;
+  }
+  else if (t < apogeeTime + fallTime) {
+    /* falling, until the parachute is out */
+    double f = t - apogeeTime;
+    altitude = apogeeAltitude - (0.5 * GRAVITY * f * f);
+    velocity = -GRAVITY * f;
+    acceleration = -GRAVITY;
+  }
+  else {
+    /* under the parachute, then on the ground */
+    altitude = apogeeAltitude - (0.5 * GRAVITY * fallTime * fallTime) + p.descentRate * (t - apogeeTime - fallTime);
+    velocity = p.descentRate;
+    acceleration = 0;
+    if (altitude <= 0) {
+      altitude = 0;
+      velocity = 0;
+    }
+  }
+}
+
+/**************************************************************************************************************
+    LSM6DSO32 MODEL
+      registers are read and written with the top bit of the first byte as the read flag. the address
+      auto-increments if CTRL3_C.IF_INC is set, and wraps from the end of the FIFO output back to its start
+ **************************************************************************************************************/
+class PDC_hostLSM6DSO32 : public PDC_hostDevice {
+  private:
+    /* ---------- REGISTERS ---------- */
+    static const uint8_t FIFO_CTRL1 = 0x07;
+    static const uint8_t FIFO_CTRL2 = 0x08;
+    static const uint8_t FIFO_CTRL3 = 0x09;
+    static const uint8_t FIFO_CTRL4 = 0x0A;
+    static const uint8_t WHO_AM_I = 0x0F;
+    static const uint8_t CTRL1_XL = 0x10;
+    static const uint8_t CTRL2_G = 0x11;
+    static const uint8_t CTRL3_C = 0x12;
+    static const uint8_t CTRL5_C = 0x14;
+    static const uint8_t OUTX_L_G = 0x22;
+    static const uint8_t OUTX_L_A = 0x28;
+    static const uint8_t FIFO_STATUS1 = 0x3A;
+    static const uint8_t FIFO_STATUS2 = 0x3B;
+    static const uint8_t FIFO_DATA_OUT_TAG = 0x78;
+    static const uint8_t FIFO_DATA_OUT_Z_H = 0x7E;
+
+    static const uint16_t FIFO_DEPTH = 512; /* [words] */
+
+    struct fifoWord {
+      uint8_t bytes[7]; /* tag, then x, y, z */
+    };
+
+    uint8_t reg[128];
+    uint8_t address;
+    bool reading;
+    bool gotAddress;
+    std::deque<fifoWord> fifo;
+    uint64_t lastFifoSample;
+
+    /* power on values */
+    void reset() {
+      memset(reg, 0, sizeof(reg));
+      reg[WHO_AM_I] = 0x6C;
+      reg[CTRL3_C] = 0x04; /* IF_INC */
+    }
+
+    /* output data rate code to Hz */
+    static double rate(uint8_t code) {
+      static const double rates[] = {0, 12.5, 26, 52, 104, 208, 416, 833, 1660, 3330, 6660};
+      return ((code <= 10) ? rates[code] : 0);
+    }
+
+    /* make a reading of both sensors as raw counts, from the flight profile and the configured ranges */
+    void sample(int16_t gyro[3], int16_t accel[3]) {
+      /* the datasheet's sensitivities */
+      static const double accelSensitivities[] = {0.122e-3, 0.976e-3, 0.244e-3, 0.488e-3}; /* [g] by CTRL1_XL.FS_XL */
+      static const double gyroSensitivities[] = {8.75e-3, 17.5e-3, 35e-3, 70e-3};        /* [dps] by CTRL2_G.FS_G */
+
+      double altitude, velocity, acceleration;
+      hostFlightState(hostTime * 1e-6, altitude, velocity, acceleration);
+
+      double accelSensitivity = accelSensitivities[(reg[CTRL1_XL] >> 2) & 3];
+      double gyroSensitivity = (reg[CTRL2_G] & 0x02) ? 4.375e-3 : gyroSensitivities[(reg[CTRL2_G] >> 2) & 3];
+
+      /* the accelerometer measures everything but gravity, so reads +1g at rest */
+      double a[3] = {noise(hostProfile.accelNoise), noise(hostProfile.accelNoise),
+                     1 + (acceleration / GRAVITY) + noise(hostProfile.accelNoise)};
+      double g[3];
+      for (uint8_t i = 0; i < 3; i++) {
+        g[i] = hostProfile.gyroBias[i] + noise(hostProfile.gyroNoise);
+      }
+
+      /* self test shifts the output (CTRL5_C.ST_XL and ST_G positive sign) */
+      if (reg[CTRL5_C] & 0x01) {
+        for (uint8_t i = 0; i < 3; i++) a[i] += 0.5;
+      }
+      if (reg[CTRL5_C] & 0x04) {
+        for (uint8_t i = 0; i < 3; i++) g[i] += 300;
+      }
+
+      for (uint8_t i = 0; i < 3; i++) {
+        accel[i] = int16_t(fmax(-32768, fmin(32767, a[i] / accelSensitivity)));
+        gyro[i] = int16_t(fmax(-32768, fmin(32767, g[i] / gyroSensitivity)));
+      }
+    }
+
+    /* bring the FIFO up to date, batching a word for each sample since the last time we looked */
+    void updateFifo() {
+      uint8_t accelBatch = reg[FIFO_CTRL3] & 0x0F;
+      uint8_t gyroBatch = reg[FIFO_CTRL3] >> 4;
+
+      if ((reg[FIFO_CTRL4] & 0x07) == 0) {
+        /* bypass mode empties the FIFO */
+        fifo.clear();
+        lastFifoSample = hostTime;
+      }
+      else {
+        double fastest = rate((accelBatch > gyroBatch) ? accelBatch : gyroBatch);
+        if (fastest > 0) {
+          uint64_t period = uint64_t(1e6 / fastest);
+          while ((hostTime - lastFifoSample) >= period) {
+            lastFifoSample += period;
+
+            int16_t gyro[3], accel[3];
+            sample(gyro, accel);
+
+            fifoWord word;
+            if (gyroBatch) {
+              word.bytes[0] = 0x01 << 3;
+              memcpy(&word.bytes[1], gyro, 6);
+              fifo.push_back(word);
+            }
+            if (accelBatch) {
+              word.bytes[0] = 0x02 << 3;
+              memcpy(&word.bytes[1], accel, 6);
+              fifo.push_back(word);
+            }
+
+            /* continuous mode throws away the oldest words once full */
+            while (fifo.size() > FIFO_DEPTH) {
+              fifo.pop_front();
+            }
+          }
+        }
+      }
+
+      uint16_t level = fifo.size();
+      uint16_t watermark = reg[FIFO_CTRL1] | ((reg[FIFO_CTRL2] & 0x01) << 8);
+      reg[FIFO_STATUS1] = level & 0xFF;
+      reg[FIFO_STATUS2] = ((level >> 8) & 0x03) | ((watermark && (level >= watermark)) ? 0x80 : 0) | ((level >= FIFO_DEPTH) ? 0x20 : 0);
+    }
+
+  public:
+    PDC_hostLSM6DSO32() {
+      reset();
+      reading = false;
+      gotAddress = false;
+      address = 0;
+      lastFifoSample = 0;
+    }
+
+    void select() {
+      gotAddress = false;
+
+      /* latch a fresh sample into the data registers for this transaction */
+      int16_t gyro[3], accel[3];
+      sample(gyro, accel);
+      memcpy(&reg[OUTX_L_G], gyro, 6);
+      memcpy(&reg[OUTX_L_A], accel, 6);
+
+      updateFifo();
+    }
+
+    uint8_t transfer(uint8_t mosi) {
+      if (!gotAddress) {
+        reading = mosi & 0x80;
+        address = mosi & 0x7F;
+        gotAddress = true;
+        return (0);
+      }
+
+      uint8_t miso = 0;
+      if (reading) {
+        if ((address >= FIFO_DATA_OUT_TAG) && (address <= FIFO_DATA_OUT_Z_H)) {
+          /* reading the last byte of a word pops it */
+          if (!fifo.empty()) {
+            miso = fifo.front().bytes[address - FIFO_DATA_OUT_TAG];
+            if (address == FIFO_DATA_OUT_Z_H) {
+              fifo.pop_front();
+            }
+          }
+        }
+        else {
+          miso = reg[address];
+        }
+      }
+      else {
+        reg[address] = mosi;
+        if ((address == CTRL3_C) && (mosi & 0x81)) {
+          reset(); /* BOOT or SW_RESET */
+        }
+        if (address == FIFO_CTRL4) {
+          updateFifo();
+        }
+      }
+
+      if (reg[CTRL3_C] & 0x04) {
+        address++;
+        if (address > FIFO_DATA_OUT_Z_H) {
+          address = FIFO_DATA_OUT_TAG; /* the FIFO output wraps so words can be burst read */
+        }
+      }
+
+      return (miso);
+    }
+};
+
+/**************************************************************************************************************
+    BMP388 MODEL
+      every read starts with a dummy byte after the address. the raw readings are found by inverting the
+      datasheet compensation (by bisection) for the true pressure and temperature, so that the code's own
+      compensation should get back to the flight profile
+ **************************************************************************************************************/
+class PDC_hostBMP388 : public PDC_hostDevice {
+  private:
+    /* ---------- REGISTERS ---------- */
+    static const uint8_t CHIP_ID = 0x00;
+    static const uint8_t STATUS = 0x03;
+    static const uint8_t DATA_0 = 0x04;
+    static const uint8_t ODR = 0x1D;
+    static const uint8_t NVM_PAR_T1 = 0x31;
+
+    static const uint8_t DRDY_PRESS_TEMP = 0x60;
+    static const uint8_t CMD_RDY = 0x10;
+
+    /* ---------- CALIBRATION (AS STORED IN NVM) ---------- */
+    uint16_t T1, T2;
+    int8_t T3;
+    int16_t P1, P2;
+    int8_t P3, P4;
+    uint16_t P5, P6;
+    int8_t P7, P8;
+    int16_t P9;
+    int8_t P10, P11;
+
+    uint8_t reg[128];
+    uint8_t address;
+    bool reading;
+    uint8_t state; /* 0: waiting for address, 1: dummy byte, 2: data */
+    uint64_t lastConversion;
+
+    /* datasheet floating point compensation */
+    double compensateTemperature(double raw) {
+      double partial1 = raw - (T1 * 256.0);
+      double partial2 = partial1 * (T2 / 1073741824.0);
+      return (partial2 + (partial1 * partial1) * (T3 / 281474976710656.0));
+    }
+
+    double compensatePressure(double raw, double t) {
+      double p1 = (P1 - 16384.0) / 1048576.0, p2 = (P2 - 16384.0) / 536870912.0, p3 = P3 / 4294967296.0;
+      double p4 = P4 / 137438953472.0, p5 = P5 * 8.0, p6 = P6 / 64.0, p7 = P7 / 256.0, p8 = P8 / 32768.0;
+      double p9 = P9 / 281474976710656.0, p10 = P10 / 281474976710656.0, p11 = P11 / 36893488147419103232.0;
+
+      double offset = p5 + (p6 * t) + (p7 * t * t) + (p8 * t * t * t);
+      double sensitivity = p1 + (p2 * t) + (p3 * t * t) + (p4 * t * t * t);
+      return (offset + (raw * sensitivity) + (raw * raw * (p9 + (p10 * t))) + (raw * raw * raw * p11));
+    }
+
+    /* find the 24 bit raw reading that compensates to the target (compensation increases with the raw value) */
+    template <typename F> uint32_t invert(F compensate, double target) {
+      double low = 0, high = 16777215;
+      for (uint8_t i = 0; i < 40; i++) {
+        double middle = 0.5 * (low + high);
+        if (compensate(middle) < target) {
+          low = middle;
+        }
+        else {
+          high = middle;
+        }
+      }
+      return (uint32_t(low));
+    }
+
+    /* fill the data registers from the flight profile, and set the data ready flags if a conversion has finished */
+    void convert() {
+      double altitude, velocity, acceleration;
+      hostFlightState(hostTime * 1e-6, altitude, velocity, acceleration);
+      altitude += hostProfile.siteAltitude + noise(hostProfile.altitudeNoise);
+
+      /* standard atmosphere */
+      double pressure = 101325.0 * pow(1 - altitude / 44330.0, 5.255);
+      double temperature = 22.0 - 0.0065 * (altitude - hostProfile.siteAltitude);
+
+      uint32_t rawTemperature = invert([this](double raw) { return (compensateTemperature(raw)); }, temperature);
+      double compensatedTemperature = compensateTemperature(rawTemperature);
+      uint32_t rawPressure = invert([this, compensatedTemperature](double raw) { return (compensatePressure(raw, compensatedTemperature)); }, pressure);
+
+      reg[DATA_0 + 0] = rawPressure;
+      reg[DATA_0 + 1] = rawPressure >> 8;
+      reg[DATA_0 + 2] = rawPressure >> 16;
+      reg[DATA_0 + 3] = rawTemperature;
+      reg[DATA_0 + 4] = rawTemperature >> 8;
+      reg[DATA_0 + 5] = rawTemperature >> 16;
+
+      static const double rates[] = {200, 100, 50, 25, 12.5, 6.25, 3.1, 0.78, 0.39, 0.2, 0.1, 0.05, 0.02, 0.01};
+      uint8_t rateCode = reg[ODR] & 0x1F;
+      uint64_t period = uint64_t(1e6 / rates[(rateCode < 14) ? rateCode : 13]);
+      if ((hostTime - lastConversion) >= period) {
+        lastConversion = hostTime;
+        reg[STATUS] |= DRDY_PRESS_TEMP;
+      }
+      reg[STATUS] |= CMD_RDY;
+    }
+
+  public:
+    PDC_hostBMP388() {
+      T1 = 27777; T2 = 19129; T3 = -7;
+      P1 = 24000; P2 = 12000; P3 = 35; P4 = 0; P5 = 6300; P6 = 30000;
+      P7 = 4; P8 = -9; P9 = 15000; P10 = 30; P11 = -60;
+
+      memset(reg, 0, sizeof(reg));
+      reg[CHIP_ID] = 0x50;
+
+      /* NVM is little endian, in datasheet order */
+      uint8_t *nvm = &reg[NVM_PAR_T1];
+      memcpy(&nvm[0], &T1, 2);
+      memcpy(&nvm[2], &T2, 2);
+      nvm[4] = T3;
+      memcpy(&nvm[5], &P1, 2);
+      memcpy(&nvm[7], &P2, 2);
+      nvm[9] = P3;
+      nvm[10] = P4;
+      memcpy(&nvm[11], &P5, 2);
+      memcpy(&nvm[13], &P6, 2);
+      nvm[15] = P7;
+      nvm[16] = P8;
+      memcpy(&nvm[17], &P9, 2);
+      nvm[19] = P10;
+      nvm[20] = P11;
+
+      address = 0;
+      reading = false;
+      state = 0;
+      lastConversion = 0;
+    }
+
+    void select() {
+      state = 0;
+      convert();
+    }
+
+    uint8_t transfer(uint8_t mosi) {
+      if (state == 0) {
+        reading = mosi & 0x80;
+        address = mosi & 0x7F;
+        state = reading ? 1 : 2;
+        return (0);
+      }
+      if (state == 1) {
+        state = 2;
+        return (0xFF); /* the dummy byte */
+      }
+
+      uint8_t miso = 0;
+      if (reading) {
+        miso = reg[address];
+        if (address == STATUS) {
+          reg[STATUS] &= ~DRDY_PRESS_TEMP; /* reading the status clears the data ready flags */
+        }
+      }
+      else {
+        reg[address] = mosi;
+      }
+      address++;
+
+      return (miso);
+    }
+};
+
+static PDC_hostLSM6DSO32 hostIMU;
+static PDC_hostBMP388 hostAltimeter;
+
+void hostAttachSensors(uint8_t imuSelect, uint8_t altimeterSelect) {
+  hostAttach(imuSelect, &hostIMU);
+  hostAttach(altimeterSelect, &hostAltimeter);
+}
@@ -0,0 +1,117 @@
+/*******************************************************************
+   Count the SPI transactions it takes to read one IMU sample
+    (src/PDC/PDC_LSM6DSO32.h), against the host's IMU model
+   usage: PDC_imuBusTest
+   A transaction is counted each time the IMU's slave select goes
+    low, at the host's pins, so it doesn't rely on the PDC's own
+    counts (which are checked against it). reading the six axes one
+    by one takes six, the burst read one, and the queued burst
+    (as PDC_sensors uses) one. a pin that was never added to the
+    device table isn't touched at all, and a full table takes no more
+   Returns 1 if any count is wrong
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include "PDC_host.h"
+#include "PDC_LSM6DSO32.h"
+
+const uint8_t TEST_IMU_SS = 5;        /* any free pin will do */
+const uint8_t TEST_ALTIMETER_SS = 6;
+const uint16_t TEST_SAMPLES = 100;    /* samples read each way */
+
+PDC_logFileFields logFileLine;
+extern uint8_t numSPIDevices;         /* how many devices are in the PDC's table (see PDC_SPI.ino) */
+
+static bool failed = 0;
+
+/*********************************************************
+   @brief  Check a count, and print it
+   @param  what was counted
+   @param  the transactions seen
+   @param  the number there should have been
+ *********************************************************/
+static void check(const char *what, uint32_t transactions, uint32_t expected) {
+  printf("%-46s %.2f transactions per sample%s\n", what, double(transactions) / TEST_SAMPLES,
+         (transactions == expected) ? "" : "  FAIL");
+  if (transactions != expected) {
+    failed = 1;
+  }
+}
+
+int main() {
+  hostAttachSensors(TEST_IMU_SS, TEST_ALTIMETER_SS);
+  addSPIDevice(TEST_IMU_SS, CLOCK_RATE_10MHZ);
+
+  PDC_LSM6DSO32 imu(TEST_IMU_SS);
+  imu.restart();
+  imu.accel.init<ACC_ODR_3330, ACC_RNG_32>();
+  imu.gyro.init<GYR_ODR_3330, GYR_RNG_250>();
+
+  /* ---------- ONE AXIS AT A TIME ---------- */
+  uint32_t start = hostSelections(TEST_IMU_SS);
+  float accelZ = 0;
+  for (uint16_t i = 0; i < TEST_SAMPLES; i++) {
+    imu.accel.readX();
+    imu.accel.readY();
+    accelZ += imu.accel.readZ();
+    imu.gyro.readX();
+    imu.gyro.readY();
+    imu.gyro.readZ();
+  }
+  check("readX/Y/Z on accelerometer and gyroscope:", hostSelections(TEST_IMU_SS) - start, 6 * TEST_SAMPLES);
+
+  /* ---------- BURST ---------- */
+  PDC_spiDevice *device = getSPIDevice(TEST_IMU_SS);
+  uint32_t deviceStart = device->transactions;
+  start = hostSelections(TEST_IMU_SS);
+  float burstZ = 0;
+  for (uint16_t i = 0; i < TEST_SAMPLES; i++) {
+    IMURawSample raw = imu.readAll();
+    burstZ += imu.accel.convertRaw(raw.accelZ);
+  }
+  check("readAll():", hostSelections(TEST_IMU_SS) - start, TEST_SAMPLES);
+  check("readAll(), as the PDC's device table has it:", device->transactions - deviceStart, TEST_SAMPLES);
+
+  /* ---------- QUEUED BURST ---------- */
+  start = hostSelections(TEST_IMU_SS);
+  for (uint16_t i = 0; i < TEST_SAMPLES; i++) {
+    uint8_t rawValue[ALL_DATA_BYTES];
+    imu.queueReadAll(rawValue);
+    runSPIQueue();
+  }
+  check("queueReadAll() and runSPIQueue():", hostSelections(TEST_IMU_SS) - start, TEST_SAMPLES);
+
+  /* the burst has to land the axes in the right places too: the model sits still and level, so z reads 1g */
+  accelZ /= TEST_SAMPLES;
+  burstZ /= TEST_SAMPLES;
+  printf("accelerometer z, axis by axis %.3fg, burst %.3fg%s\n", accelZ, burstZ, (fabs(burstZ - accelZ) < 0.05) ? "" : "  FAIL");
+  if (fabs(burstZ - accelZ) >= 0.05) {
+    failed = 1;
+  }
+
+  /* ---------- THE DEVICE TABLE ---------- */
+  /* the altimeter is on the bus but was never added, so the PDC mustn't touch it */
+  start = hostSelections(TEST_ALTIMETER_SS);
+  uint8_t chipID = 0xFF;
+  readSPIwithDummy(TEST_ALTIMETER_SS, 0x00, 1, &chipID);
+  uint32_t transactions = hostSelections(TEST_ALTIMETER_SS) - start;
+  bool untouched = !getSPIDevice(TEST_ALTIMETER_SS) && (transactions == 0) && (chipID == 0);
+  printf("a pin never added: %s, %u transactions, reads 0x%02X%s\n", getSPIDevice(TEST_ALTIMETER_SS) ? "in the table" : "not in the table",
+         transactions, chipID, untouched ? "" : "  FAIL");
+  if (!untouched) {
+    failed = 1;
+  }
+
+  /* fill the table up. there's no room for another */
+  for (uint8_t pin = TEST_ALTIMETER_SS; numSPIDevices < SPI_MAX_DEVICES; pin++) {
+    addSPIDevice(pin, CLOCK_RATE_10MHZ);
+  }
+  bool added = (addSPIDevice(TEST_ALTIMETER_SS + SPI_MAX_DEVICES, CLOCK_RATE_10MHZ) == 0);
+  printf("adding to a full table (%u devices): %s%s\n", SPI_MAX_DEVICES, added ? "added" : "refused", added ? "  FAIL" : "");
+  if (added) {
+    failed = 1;
+  }
+
+  return (failed);
+}
@@ -0,0 +1,224 @@
+/*******************************************************************
+   Time the Kalman filter steps (src/PDC/PDC_kalman.ino) on a PC,
+    and check them against the textbook matrix equations
+   usage: PDC_kalmanBench [steps]
+   The PDC's kalmanPropagate() and kalmanCorrect() are the matrix
+    equations written out by hand for our F and H, using only their
+    non-zero terms. the reference here is the same filter written
+    the general way, with BasicLinearAlgebra expressions:
+      x = F*x              P = F*P*F^T + Q
+      K = P*H^T * (H*P*H^T + R)^-1
+      x = x + K*(z - H*x)  P = P - K*(H*P)
+    both are run from the same start through the same random steps
+    (an accelerometer correction every step, an altimeter one every
+    tenth, as in flight), and must agree exactly - the hand
+    written terms are added in the same order as the products add
+    them, and the zeros they leave out add nothing. the one
+    difference is that the matrix products round the two halves
+    of P differently, so the reference keeps the triangle that the
+    kernel keeps, and mirrors it, to stay exactly symmetric too
+   The times are for the PC, not the nano - they're for comparing
+    the two with each other
+   Returns 1 if they ever disagree
+ *******************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <BasicLinearAlgebra.h>
+#include "PDC_kalman.h"
+#include "PDC_kalmanTable.h"
+#include "PDC_profiler.h"
+
+using namespace BLA;
+
+/* ---------- WHAT THE SKETCH WOULD DEFINE (see PDC.ino) ---------- */
+const uint32_t IMU_TASK_PERIOD       = 4000;
+const uint32_t ALTIMETER_TASK_PERIOD = 40000;
+const uint8_t numStates = 3;
+Matrix<numStates, 1> stateMatrix;
+PDC_logFileFields logFileLine;
+
+#include "PDC_kalman.ino"
+
+const uint8_t BENCH_BARO_EVERY = 10;  /* an altimeter correction every this many steps (25Hz against 250Hz) */
+
+/* the filter's state and covariance, as the reference keeps them */
+struct referenceFilter {
+  Matrix<numStates, 1> x;
+  Matrix<numStates, numStates> P;
+};
+
+/*********************************************************
+   @brief  Mirror one triangle of P onto the other
+   @param  the matrix
+   @param  1 to keep the lower triangle, 0 the upper
+ *********************************************************/
+static void mirror(Matrix<numStates, numStates> &P, bool lower) {
+  for (uint8_t i = 0; i < numStates; i++) {
+    for (uint8_t j = i + 1; j < numStates; j++) {
+      if (lower) {
+        P(i, j) = P(j, i);
+      }
+      else {
+        P(j, i) = P(i, j);
+      }
+    }
+  }
+}
+
+/*********************************************************
+   @brief  Propagate the reference filter
+   @param  the filter
+   @param  the time step [s]
+ *********************************************************/
+static void referencePropagate(referenceFilter &filter, float dt) {
+  float halfDt2 = 0.5 * dt * dt;
+  Matrix<numStates, numStates> F = {1,       0,  0,
+                                    dt,      1,  0,
+                                    halfDt2, dt, 1};
+
+  float qDt = KALMAN_JERK_NOISE * dt;
+  float qDt2 = qDt * dt;
+  float qDt3 = qDt2 * dt;
+  float qDt4 = qDt3 * dt;
+  Matrix<numStates, numStates> Q = {qDt,          qDt2 / 2,     qDt3 / 6,
+                                    qDt2 / 2,     qDt3 / 3,     qDt4 / 8,
+                                    qDt3 / 6,     qDt4 / 8,     (qDt4 * dt) / 20};
+
+  filter.x = F * filter.x;
+  filter.P = F * filter.P * ~F + Q;
+  mirror(filter.P, 1);
+}
+
+/*********************************************************
+   @brief  Correct the reference filter with a measurement
+   @param  the filter
+   @param  the state that was measured
+   @param  the measurement, and its variance
+ *********************************************************/
+static void referenceCorrect(referenceFilter &filter, uint8_t measuredState, float measurement, float variance) {
+  Matrix<1, numStates> H;
+  H(0, measuredState) = 1;
+  Matrix<1, 1> R = {variance};
+  Matrix<1, 1> z = {measurement};
+
+  Matrix<1, 1> S = H * filter.P * ~H + R;
+  Matrix<1, 1> inverseS = {1 / S(0, 0)};  /* the inverse of a 1x1 matrix */
+  Matrix<numStates, 1> K = filter.P * ~H * inverseS;
+
+  filter.x = filter.x + K * (z - H * filter.x);
+  filter.P = filter.P - K * (H * filter.P);
+  mirror(filter.P, 0);
+}
+
+/* one step of the filter: a time step, then the measurements at the end of it */
+struct benchStep {
+  float dt;           /* [s] */
+  float accel;        /* [m/s^2] */
+  bool baro;          /* an altimeter correction as well */
+  float height;       /* [m] */
+};
+
+/*********************************************************
+   @brief  Make a run of steps, like a flight: time steps
+            around the IMU period, noisy measurements
+   @param  where to put the steps, and how many
+ *********************************************************/
+static void makeSteps(benchStep *steps, uint32_t numSteps) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> jitter(0.003, 0.006);
+  std::normal_distribution<float> noise(0, 1);
+
+  float height = 0, velocity = 0;
+  for (uint32_t i = 0; i < numSteps; i++) {
+    float dt = jitter(random);
+    float acceleration = 30 * sin(i * 0.002);  /* up and down, every ~6000 steps */
+    velocity += acceleration * dt;
+    height += velocity * dt;
+
+    steps[i].dt = dt;
+    steps[i].accel = acceleration + 0.2 * noise(random);
+    steps[i].baro = ((i % BENCH_BARO_EVERY) == 0);
+    steps[i].height = height + 0.5 * noise(random);
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t numSteps = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+  benchStep *steps = new benchStep[numSteps];
+  makeSteps(steps, numSteps);
+
+  const float accelNoise = 0.02, altitudeNoise = 0.5; /* [g], [m] - within the table */
+  const float accelVariance = pow(accelNoise * GRAVITY, 2), altitudeVariance = pow(altitudeNoise, 2);
+
+  /* ---------- AGREEMENT ---------- */
+  initKalman(accelNoise, altitudeNoise);
+  referenceFilter reference;
+  reference.x = stateMatrix;
+  reference.P = P_matrix;
+
+  uint32_t mismatches = 0, firstMismatch = 0;
+  for (uint32_t i = 0; i < numSteps; i++) {
+    kalmanPropagate(steps[i].dt);
+    kalmanCorrect(0, steps[i].accel, accelVariance);
+    referencePropagate(reference, steps[i].dt);
+    referenceCorrect(reference, 0, steps[i].accel, accelVariance);
+    if (steps[i].baro) {
+      kalmanCorrect(2, steps[i].height, altitudeVariance);
+      referenceCorrect(reference, 2, steps[i].height, altitudeVariance);
+    }
+
+    bool same = 1;
+    for (uint8_t r = 0; r < numStates; r++) {
+      same = same && (stateMatrix(r, 0) == reference.x(r, 0));
+      for (uint8_t c = 0; c < numStates; c++) {
+        same = same && (P_matrix(r, c) == reference.P(r, c));
+      }
+    }
+    if (!same) {
+      if (mismatches == 0) {
+        firstMismatch = i;
+      }
+      mismatches++;
+
+      /* carry on from the same place, to count every step that disagrees rather than one that went on to diverge */
+      reference.x = stateMatrix;
+      reference.P = P_matrix;
+    }
+  }
+  if (mismatches) {
+    printf("kernel and matrix equations disagree on %u of %u steps (the first is step %u)\n", mismatches, numSteps, firstMismatch);
+  }
+  else {
+    printf("kernel and matrix equations agree exactly on all %u steps\n", numSteps);
+  }
+
+  /* ---------- COST ---------- */
+  /* a propagate and an accelerometer correction, as the IMU task does every sample */
+  initKalman(accelNoise, altitudeNoise);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < numSteps; i++) {
+    kalmanPropagate(steps[i].dt);
+    kalmanCorrect(0, steps[i].accel, accelVariance);
+  }
+  auto stop = std::chrono::steady_clock::now();
+  double kernelTime = std::chrono::duration<double, std::nano>(stop - start).count() / numSteps;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < numSteps; i++) {
+    referencePropagate(reference, steps[i].dt);
+    referenceCorrect(reference, 0, steps[i].accel, accelVariance);
+  }
+  stop = std::chrono::steady_clock::now();
+  double referenceTime = std::chrono::duration<double, std::nano>(stop - start).count() / numSteps;
+
+  /* use the results, so the loops can't be optimised away */
+  printf("propagate and correct, kernel:           %.1f ns (%.3g)\n", kernelTime, P_matrix(0, 0));
+  printf("propagate and correct, matrix equations: %.1f ns (%.3g)\n", referenceTime, reference.P(0, 0));
+
+  delete[] steps;
+  return (mismatches ? 1 : 0);
+}
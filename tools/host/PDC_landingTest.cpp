@@ -0,0 +1,102 @@
+/*******************************************************************
+   Check the landing detector (src/PDC/PDC_landing.h) with its
+    default settings
+   usage: PDC_landingTest
+   Each case is a descent at the 25Hz flight task rate, with noise
+    on the velocity and pressure like the PDC sees (pressure goes up
+    ~12Pa for each metre down near the ground). it must not land
+    while coming down, however slowly, or while it stops for a
+    moment in the air. it must land within a second of the hold
+    time after touching down, and the backstop must land it at its
+    time if the sensors never settle
+   Returns 1 if any check fails
+ *******************************************************************/
+
+#include <stdio.h>
+#include <random>
+#include "PDC_landing.h"
+
+const uint32_t TEST_PERIOD = 40000;         /* [us] the flight task period */
+const float TEST_PA_PER_METRE = 12.0;       /* [Pa/m] near the ground */
+const float TEST_GROUND_PRESSURE = 99630;   /* [Pa] */
+
+static std::mt19937 noiseSource(1);
+
+/*********************************************************
+   @brief  Some noise
+   @param  its standard deviation
+   @retval the noise
+ *********************************************************/
+static float noise(float stdDev) {
+  std::normal_distribution<float> distribution(0, stdDev);
+  return (distribution(noiseSource));
+}
+
+/* a stretch of a descent: a steady speed for a while */
+struct testLeg {
+  float velocity;       /* [m/s] */
+  float duration;       /* [s] */
+  float velocityNoise;  /* [m/s] */
+};
+
+/*********************************************************
+   @brief  Fly a detector through some legs, from 300m
+   @param  what the case is
+   @param  the legs
+   @param  how many there are
+   @param  when it should land, after the start [s] (-1
+            if it shouldn't)
+   @param  1 if it should be the backstop that lands it
+   @retval 1 if it failed, 0 otherwise
+ *********************************************************/
+static bool check(const char *what, const testLeg *legs, uint8_t numLegs, float landAt, bool backstop) {
+  PDC_landing detector(LANDING_DEFAULT_CONFIG);
+  const uint32_t start = 1000000;
+  uint32_t time = start;
+  float height = 300;
+
+  detector.descend(start);
+  for (uint8_t leg = 0; leg < numLegs; leg++) {
+    uint32_t end = time + uint32_t(legs[leg].duration * 1e6);
+    for (; time < end; time += TEST_PERIOD) {
+      height = fmax(0, height + legs[leg].velocity * TEST_PERIOD * 1e-6);
+      float pressure = TEST_GROUND_PRESSURE - (height * TEST_PA_PER_METRE) + noise(3.6);
+      if (detector.update(legs[leg].velocity + noise(legs[leg].velocityNoise), pressure, time)) {
+        break;
+      }
+    }
+  }
+
+  float landed = (detector.getDetectionTime() - start) * 1e-6;
+  bool good;
+  if (landAt < 0) {
+    good = !detector.isLanded();
+    printf("%-44s %s%s\n", what, detector.isLanded() ? "landed" : "didn't land", good ? "" : "  FAIL");
+  }
+  else {
+    good = detector.isLanded() && (landed >= landAt) && (landed < landAt + 1) && (detector.wasBackstop() == backstop);
+    printf("%-44s landed at %.2fs (%s)%s\n", what, landed, detector.wasBackstop() ? "backstop" : "sensors", good ? "" : "  FAIL");
+  }
+
+  return (!good);
+}
+
+int main() {
+  bool failed = 0;
+  const float hold = LANDING_DEFAULT_CONFIG.holdTime * 1e-6;
+  const float backstop = LANDING_DEFAULT_CONFIG.backstopTime * 1e-6;
+
+  const testLeg parachute[] = {{-5, 60, 0.3}, {0, 20, 0.3}};  /* down in 60s, then on the ground */
+  failed |= check("5m/s under the parachute, then the ground:", parachute, 2, 60 + hold, 0);
+
+  const testLeg slow[] = {{-1.5, 190, 0.3}};  /* slow enough to pass for still on velocity alone */
+  failed |= check("a 1.5m/s descent:", slow, 1, -1, 0);
+
+  const testLeg pause[] = {{-5, 20, 0.3}, {0, hold - 1, 0.3}, {-5, 20, 0.3}};  /* stopped in the air for a moment */
+  failed |= check("stopping for a little under the hold time:", pause, 3, -1, 0);
+
+  const testLeg unsettled[] = {{-5, 60, 0.3}, {0, backstop, 5}};  /* the velocity never settles */
+  failed |= check("landed, but the velocity never settles:", unsettled, 2, backstop, 1);
+
+  return (failed);
+}
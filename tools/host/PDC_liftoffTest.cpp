@@ -0,0 +1,67 @@
+/*******************************************************************
+   Check the liftoff detector (src/PDC/PDC_liftoff.h) with its
+    default settings, and with settings that are out of range
+   usage: PDC_liftoffTest
+   Each config is given a second at rest (1g) and then a steady
+    5g at the 250Hz IMU rate. it must not go off at rest, and must
+    go off under thrust. a window of 0 or more than
+    LIFTOFF_MAX_WINDOW samples, or needing 0 or more samples than
+    the window holds, is kept to the nearest that works
+   Returns 1 if any check fails
+ *******************************************************************/
+
+#include <stdio.h>
+#include "PDC_liftoff.h"
+
+const uint32_t TEST_PERIOD = 4000;  /* [us] the IMU task period */
+
+/*********************************************************
+   @brief  Run a detector through rest and then thrust
+   @param  what the config is
+   @param  the config
+   @retval 1 if it failed, 0 otherwise
+ *********************************************************/
+static bool check(const char *what, const PDC_liftoffConfig &config) {
+  PDC_liftoff detector(config);
+  uint32_t time = 0;
+
+  /* ---------- ON THE PAD ---------- */
+  for (uint16_t i = 0; i < 250; i++, time += TEST_PERIOD) {
+    if (detector.update(0, 0, 1, time)) {
+      printf("%-36s went off at rest  FAIL\n", what);
+      return (1);
+    }
+  }
+
+  /* ---------- UNDER THRUST ---------- */
+  uint32_t ignition = time;
+  for (uint16_t i = 0; i < 250; i++, time += TEST_PERIOD) {
+    if (detector.update(0, 0, 5, time)) {
+      printf("%-36s went off %.1fms after ignition\n", what, (time - ignition) * 1e-3);
+      return (0);
+    }
+  }
+
+  printf("%-36s never went off  FAIL\n", what);
+  return (1);
+}
+
+int main() {
+  bool failed = 0;
+
+  failed |= check("default:", LIFTOFF_DEFAULT_CONFIG);
+
+  const PDC_liftoffConfig emptyWindow = {3.0, 0, 8, 10000};
+  failed |= check("window of 0 samples:", emptyWindow);
+
+  const PDC_liftoffConfig wideWindow = {3.0, 200, 8, 10000};
+  failed |= check("window of 200 samples:", wideWindow);
+
+  const PDC_liftoffConfig noneNeeded = {3.0, 12, 0, 10000};
+  failed |= check("needing 0 samples:", noneNeeded);
+
+  const PDC_liftoffConfig tooManyNeeded = {3.0, 12, 20, 10000};
+  failed |= check("needing 20 of a 12 sample window:", tooManyNeeded);
+
+  return (failed);
+}
@@ -0,0 +1,201 @@
+/*******************************************************************
+   Stress the path from the log queue to the card (src/PDC/PDC_254.h
+    and PDC_ringBuffer.h), against the host's card model
+   usage: PDC_logTest
+   A record is queued every TEST_LOG_PERIOD of simulated time, as
+    the log task does (a run that's more than a period late is
+    skipped, as the scheduler does), and the queue is drained the
+    way drainLog() in PDC.ino does it - but only in bursts: the loop
+    is kept busy for most of every TEST_BURST_PERIOD, as if the other
+    tasks had a lot on, and is only free for the rest. over several
+    minutes the card has a good few of its long stalls, made longer
+    than the 120ms it takes to fill a block, so they reach past the
+    block being built and into the queue. every record must reach
+    the card, in order, and no drain may take longer than sending a
+    block does - a stall has to be waited out in the queue, not in
+    a call. closing the file must cut it down to what was written
+   The same is then done without asking busy() first, to show what
+    a stall costs when the loop waits for it
+   The files are left in build/logTest/sdcard for a look afterwards
+   Returns 1 if any check fails
+ *******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "PDC_host.h"
+#include "PDC_254.h"
+#include "PDC_ringBuffer.h"
+#include "PDC_profiler.h"
+
+const uint8_t TEST_SD_SS = 6;                   /* as PDC.ino */
+const uint8_t TEST_SD_CD = 7;
+const uint8_t TEST_QUEUE_SIZE = 8;              /* [records] LOG_QUEUE_SIZE in PDC.ino */
+const uint32_t TEST_LOG_PERIOD = 10000;         /* [us] LOG_TASK_PERIOD in PDC.ino */
+const uint32_t TEST_BURST_PERIOD = 50000;       /* [us] the loop is free once in this long... */
+const uint32_t TEST_BURST_FREE = 5000;          /* [us] ...for this long */
+const uint32_t TEST_STEP = 100;                 /* [us] the time the rest of one pass of the loop takes */
+const uint32_t TEST_DURATION = 300000000;       /* [us] long enough for ~10 of the card's stalls */
+const uint32_t TEST_STALL = 150000;             /* [us] how long each stall is */
+const uint32_t TEST_FILE_SIZE = 4UL * 1024 * 1024; /* [bytes] */
+
+PDC_logFileFields logFileLine;
+#if PDC_PROFILE
+PDC_profiler profiler;
+#endif
+
+static bool failed = 0;
+
+/* how a run went */
+struct testRun {
+  uint32_t records;     /* records made by the log task */
+  uint32_t lost;        /* log task runs skipped, and records the queue had no room for */
+  uint8_t deepest;      /* the most records that were ever waiting in the queue */
+  uint64_t longest;     /* [us] the longest a drain took */
+  bool writeErr;        /* a record couldn't be written */
+};
+
+/*********************************************************
+   @brief  Check something, and print it if it's wrong
+   @param  whether it's right
+   @param  what was checked
+ *********************************************************/
+static void check(bool good, const char *what) {
+  if (!good) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+/*********************************************************
+   @brief  Log to a new flight file, with a bursty drain
+   @param  the card
+   @param  1 to ask busy() before each record, as
+            drainLog() does
+   @retval how it went
+ *********************************************************/
+static testRun run(PDC_254 &card, bool askBusy) {
+  PDC_ringBuffer<PDC_logFileFields, TEST_QUEUE_SIZE> queue;
+  PDC_logFileFields record = {};
+  testRun result = {};
+
+  check(card.openFlightFile(TEST_FILE_SIZE) == 0, "the flight file opens");
+
+  uint64_t start = hostTime;
+  uint64_t nextRecord = start;
+  while (hostTime - start < TEST_DURATION) {
+    /* ---------- THE LOG TASK ---------- */
+    if (hostTime >= nextRecord) {
+      while (hostTime >= nextRecord + TEST_LOG_PERIOD) {
+        nextRecord += TEST_LOG_PERIOD;
+        result.lost++;
+      }
+      nextRecord += TEST_LOG_PERIOD;
+
+      record.logTime = result.records++;  /* number them, to check the order on the card */
+      if (queue.push(record) != 0) {
+        result.lost++;
+      }
+      if (queue.count() > result.deepest) {
+        result.deepest = queue.count();
+      }
+    }
+
+    /* ---------- DRAIN, IF THE LOOP IS FREE ---------- */
+    if (((hostTime - start) % TEST_BURST_PERIOD) >= (TEST_BURST_PERIOD - TEST_BURST_FREE)) {
+      uint64_t before = hostTime;
+      if (!(askBusy && card.busy()) && (queue.pop(record) == 0)) {
+        result.writeErr |= card.writeRecord(record);
+      }
+      if (hostTime - before > result.longest) {
+        result.longest = hostTime - before;
+      }
+    }
+
+    hostTime += TEST_STEP;
+  }
+
+  /* what's left goes on at the end, as landing() does it */
+  while (queue.pop(record) == 0) {
+    result.writeErr |= card.writeRecord(record);
+  }
+  check(card.closeFile() == 0, "the flight file closes");
+
+  return (result);
+}
+
+/*********************************************************
+   @brief  Read a log back, and check it holds every
+            record in order, and no more
+   @param  the file
+   @param  the number of records that went in
+ *********************************************************/
+static void checkFile(const char *fileName, uint32_t numRecords) {
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s", HOST_SD_DIR, fileName);
+
+  /* a header block, then full data blocks, then whatever was left over */
+  uint32_t dataBlocks = (numRecords + LOG_RECORDS_PER_BLOCK - 1) / LOG_RECORDS_PER_BLOCK;
+  struct stat info;
+  check((stat(path, &info) == 0) && (uint32_t(info.st_size) == (1 + dataBlocks) * LOG_BLOCK_SIZE),
+        "the file is cut down to the blocks written when it's closed");
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    check(0, "the file can be read back");
+    return;
+  }
+
+  uint8_t block[LOG_BLOCK_SIZE];
+  uint32_t nextRecord = 0;
+  bool inOrder = 1;
+  for (uint16_t sequence = 0; fread(block, 1, LOG_BLOCK_SIZE, file) == LOG_BLOCK_SIZE; sequence++) {
+    PDC_logBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    inOrder = inOrder && (header.sequence == sequence);
+    inOrder = inOrder && (header.type == ((sequence == 0) ? LOG_BLOCK_FILE_HEADER : LOG_BLOCK_DATA));
+
+    for (uint8_t i = 0; (header.type == LOG_BLOCK_DATA) && (i < header.numRecords); i++) {
+      PDC_logFileFields record;
+      memcpy(&record, &block[sizeof(header) + i * sizeof(record)], sizeof(record));
+      inOrder = inOrder && (record.logTime == nextRecord);
+      nextRecord++;
+    }
+  }
+  fclose(file);
+
+  check(inOrder, "the blocks and records are on the card in order, with none missing");
+  check(nextRecord == numRecords, "every record is on the card");
+}
+
+int main() {
+  /* a card of our own, so the test's files don't take the names PDC_host would use */
+  mkdir("logTest", 0777);
+  if (chdir("logTest") != 0) {
+    printf("FAIL: can't make build/logTest\n");
+    return (1);
+  }
+  remove("sdcard/FLIGHT00.BIN");
+  remove("sdcard/FLIGHT01.BIN");
+
+  hostCardStall(TEST_STALL);
+  PDC_254 card(TEST_SD_SS, TEST_SD_CD);
+  check(card.isAlive(), "the card starts");
+
+  /* ---------- AS drainLog() DOES IT ---------- */
+  testRun result = run(card, 1);
+  printf("asking busy() first:  %u records, %u lost, queue at most %u deep, longest drain %.3fms\n",
+         result.records, result.lost, result.deepest, result.longest * 1e-3);
+  check(!result.writeErr, "every record is written");
+  check(result.lost == 0, "no records are lost");
+  check(result.longest <= HOST_SD_BLOCK_US + 10, "no drain takes longer than sending one block");
+  checkFile("FLIGHT00.BIN", result.records);
+
+  /* ---------- WAITING FOR THE CARD ---------- */
+  testRun waiting = run(card, 0);
+  printf("waiting for the card: %u records, %u lost, queue at most %u deep, longest drain %.3fms\n",
+         waiting.records, waiting.lost, waiting.deepest, waiting.longest * 1e-3);
+
+  return (failed);
+}
@@ -0,0 +1,97 @@
+/*******************************************************************
+   Check that a profile dump (src/PDC/PDC_profiler.h) reads back
+    as the table it was sent from
+   usage: PDC_profilerTest
+   Some known runs are recorded, the table is dumped through the
+    host's Serial, and the bytes are decoded the way a PC on the
+    other end of the cable would: find the magic, check the header,
+    then read each section. every field must match what the
+    profiler holds, and the runs that went in. the layout is pinned
+    down too (the size, and where the magic is), as changing it
+    means bumping PROFILE_VERSION
+   Returns 1 if any check fails
+ *******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "PDC_host.h"
+#include "PDC_profiler.h"
+
+static bool failed = 0;
+
+/*********************************************************
+   @brief  Check something, and print it if it's wrong
+   @param  whether it's right
+   @param  what was checked
+ *********************************************************/
+static void check(bool good, const char *what) {
+  if (!good) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+int main() {
+  PDC_profiler table;
+
+  /* ---------- KNOWN RUNS ---------- */
+  /* 0 ticks goes in bin 0, 1 in bin 1, 2-3 in bin 2, 4-7 in bin 3... and anything from 2^14 up in the last bin */
+  table.record(PROFILE_IMU_READ, 0);
+  table.record(PROFILE_IMU_READ, 3);
+  table.record(PROFILE_IMU_READ, 5);
+  table.record(PROFILE_SD_WRITE, 1000);
+  table.record(PROFILE_SD_WRITE, 100000);
+  for (uint32_t i = 0; i < 70000; i++) {
+    table.record(PROFILE_KALMAN, 20);  /* more than a bin can count */
+  }
+
+  /* ---------- DUMP ---------- */
+  const char noise[] = "alt: 1.23456\n";  /* text that was on the line before it */
+  std::vector<uint8_t> sent(noise, noise + strlen(noise));
+
+  hostSerialCapture(&sent);
+  table.dump(Serial);
+  hostSerialCapture(NULL);
+
+  /* ---------- DECODE ---------- */
+  size_t start = 0;
+  while ((start + 4 <= sent.size()) && (memcmp(&sent[start], "PDCP", 4) != 0)) {
+    start++;
+  }
+  check(start == strlen(noise), "the magic is sent first, as the bytes 'PDCP'");
+
+  const size_t expectedSize = 9 + PROFILE_SECTIONS * (16 + 2 * PROFILE_BINS);
+  check(sent.size() - start == expectedSize, "the dump is the size the format says");
+  if (sent.size() - start != expectedSize) {
+    return (1);
+  }
+
+  PDC_profileHeader header;
+  memcpy(&header, &sent[start], sizeof(header));
+  check(header.magic == PROFILE_MAGIC, "magic");
+  check(header.version == PROFILE_VERSION, "version");
+  check(header.sections == PROFILE_SECTIONS, "number of sections");
+  check(header.bins == PROFILE_BINS, "number of bins");
+  check(header.nsPerTick == PROFILE_NS_PER_TICK, "clock resolution");
+
+  const uint8_t *next = &sent[start + sizeof(header)];
+  for (uint8_t s = 0; s < header.sections; s++, next += sizeof(PDC_profileSection)) {
+    PDC_profileSection section;
+    memcpy(&section, next, sizeof(section));
+    check(memcmp(&section, &table.getSection(s), sizeof(section)) == 0, "every section reads back as the table has it");
+  }
+
+  /* ---------- AND THE TABLE HAS THE RUNS ---------- */
+  PDC_profileSection imu, sd, kalman;
+  memcpy(&imu, &sent[start + sizeof(header) + PROFILE_IMU_READ * sizeof(PDC_profileSection)], sizeof(imu));
+  memcpy(&sd, &sent[start + sizeof(header) + PROFILE_SD_WRITE * sizeof(PDC_profileSection)], sizeof(sd));
+  memcpy(&kalman, &sent[start + sizeof(header) + PROFILE_KALMAN * sizeof(PDC_profileSection)], sizeof(kalman));
+
+  check((imu.count == 3) && (imu.minimum == 0) && (imu.maximum == 5) && (imu.total == 8), "IMU read count, minimum, maximum and total");
+  check((imu.bins[0] == 1) && (imu.bins[2] == 1) && (imu.bins[3] == 1), "IMU read bins");
+  check((sd.bins[10] == 1) && (sd.bins[PROFILE_BINS - 1] == 1), "SD write bins, and the last bin taking the long run");
+  check((kalman.count == 70000) && (kalman.bins[5] == 0xFFFF), "a bin stops counting at 65535");
+
+  printf("%u byte dump read back%s\n", unsigned(expectedSize), failed ? " WRONG" : " as sent");
+  return (failed);
+}
@@ -0,0 +1,208 @@
+/*******************************************************************
+   Check the scheduler (src/PDC/PDC_scheduler.h) against a clock
+    that only moves when the test moves it
+   usage: PDC_schedulerTest
+   Each task's callback moves the clock on by the time the task is
+    meant to take, and between calls to run() the clock is stepped
+    by a few us, as loop() would spend. so every release, start and
+    finish is known exactly, and the statistics can be checked to
+    the microsecond:
+    - releases stay on the fixed grid, across the micros() rollover
+    - a low priority task's jitter is the run time of the higher
+      priority task that held it up
+    - a task that runs past its deadline counts an overrun
+    - a task that stalls for more than a period skips the releases
+      it missed, rather than running them back to back
+    - a full table hands out MAX_TASKS, and getTask() has nothing
+      for an ID it never handed out
+   Returns 1 if any check fails
+ *******************************************************************/
+
+#include <stdio.h>
+#include "PDC_scheduler.h"
+
+const uint32_t TEST_PERIOD = 1000;  /* [us] the period of every task here */
+const uint32_t TEST_STEP = 10;      /* [us] how far the clock moves between calls to run(). a factor of every time here, so tasks start exactly on release... */
+const uint32_t TEST_ODD_STEP = 70;  /* [us] ...and not a factor of the period, so they start late by varying amounts */
+
+static uint32_t testTime;     /* [us] the time that the scheduler sees */
+static bool failed = 0;
+
+/* what a test task does when it runs */
+struct testTask {
+  uint32_t runTime;     /* [us] how long each run takes */
+  uint32_t stallRun;    /* the run (counting from 0) that takes stallTime instead */
+  uint32_t stallTime;   /* [us] */
+  uint32_t runs;        /* how many times it has run */
+  uint32_t worstOffGrid; /* [us] the furthest a start has been from the grid (start at 0, one every TEST_PERIOD) */
+  uint32_t gridStart;   /* [us] where the grid starts */
+};
+
+static testTask testTasks[2];
+
+/*********************************************************
+   @brief  Run a test task: note when it started, and move
+            the clock on by how long it takes
+   @param  the task
+ *********************************************************/
+static void runTestTask(testTask &task) {
+  uint32_t offGrid = (testTime - task.gridStart) - task.runs * TEST_PERIOD;
+  if (offGrid > task.worstOffGrid) {
+    task.worstOffGrid = offGrid;
+  }
+
+  testTime += (task.runs == task.stallRun) ? task.stallTime : task.runTime;
+  task.runs++;
+}
+
+static void taskA() {
+  runTestTask(testTasks[0]);
+}
+
+static void taskB() {
+  runTestTask(testTasks[1]);
+}
+
+static uint32_t testClock() {
+  return (testTime);
+}
+
+/*********************************************************
+   @brief  Set up the test tasks and the clock
+   @param  when the clock starts [us]
+   @param  how long each task takes to run [us]
+ *********************************************************/
+static void reset(uint32_t start, uint32_t runTimeA, uint32_t runTimeB) {
+  testTime = start;
+  testTasks[0] = {runTimeA, UINT32_MAX, 0, 0, 0, start};
+  testTasks[1] = {runTimeB, UINT32_MAX, 0, 0, 0, start};
+}
+
+/*********************************************************
+   @brief  Run the scheduler until a given time, stepping
+            the clock whenever nothing was due
+   @param  the scheduler
+   @param  how long to run for [us]
+   @param  the step [us]
+ *********************************************************/
+static void runFor(PDC_scheduler &scheduler, uint32_t duration, uint32_t step = TEST_STEP) {
+  uint32_t start = testTime;
+  while ((testTime - start) < duration) {
+    if (!scheduler.run()) {
+      testTime += step;
+    }
+  }
+}
+
+/*********************************************************
+   @brief  Print a number, and whether it passed
+   @param  what was checked
+   @param  the number seen
+   @param  1 if it passed
+ *********************************************************/
+static void report(const char *what, uint32_t value, bool passed) {
+  printf("%-62s %-6lu%s\n", what, (unsigned long)value, passed ? "" : "  FAIL");
+  if (!passed) {
+    failed = 1;
+  }
+}
+
+/*********************************************************
+   @brief  Check a number is what it should be
+   @param  what was checked
+   @param  the number seen
+   @param  the number there should have been
+ *********************************************************/
+static void check(const char *what, uint32_t value, uint32_t expected) {
+  report(what, value, value == expected);
+}
+
+int main() {
+  /* ---------- FIXED GRID ---------- */
+  /* a task on its own is released every period from the start, and starts within a step of its release, however late
+     the steps make it. from zero, and from just before micros() rolls over */
+  const uint32_t starts[2] = {0, UINT32_MAX - 4 * TEST_PERIOD};
+  for (uint8_t i = 0; i < 2; i++) {
+    PDC_scheduler scheduler(testClock);
+    reset(starts[i], 100, 0);
+    uint8_t id = scheduler.addTask(taskA, TEST_PERIOD, TEST_PERIOD);
+    scheduler.start();
+    runFor(scheduler, 10 * TEST_PERIOD, TEST_ODD_STEP);
+
+    printf("starting at %lu us:\n", (unsigned long)starts[i]);
+    check("  runs in 10 periods:", scheduler.getTask(id)->runCount, 10);
+    /* had the releases drifted with the late starts (release = start + period), this would grow with every run */
+    report("  furthest start from the grid, under a step [us]:", testTasks[0].worstOffGrid, testTasks[0].worstOffGrid < TEST_ODD_STEP);
+    check("  max jitter [us]:", scheduler.getTask(id)->maxJitter, testTasks[0].worstOffGrid);
+    check("  overruns:", scheduler.getTask(id)->overruns, 0);
+    check("  skipped:", scheduler.getTask(id)->skipped, 0);
+  }
+
+  /* ---------- JITTER ---------- */
+  /* A (300us) and B (100us) are released together, so B always waits for A, and starts 300us late */
+  {
+    PDC_scheduler scheduler(testClock);
+    reset(0, 300, 100);
+    uint8_t a = scheduler.addTask(taskA, TEST_PERIOD, TEST_PERIOD);
+    uint8_t b = scheduler.addTask(taskB, TEST_PERIOD, 500);
+    scheduler.start();
+    runFor(scheduler, 5 * TEST_PERIOD);
+
+    printf("a 300us task ahead of a 100us one:\n");
+    check("  max jitter of the first [us]:", scheduler.getTask(a)->maxJitter, 0);
+    check("  max jitter of the second [us]:", scheduler.getTask(b)->maxJitter, 300);
+    check("  max run time of the second [us]:", scheduler.getTask(b)->maxRunTime, 100);
+    check("  runs of the second:", scheduler.getTask(b)->runCount, 5);
+    check("  overruns of the second (finishes 400us in, deadline 500us):", scheduler.getTask(b)->overruns, 0);
+  }
+
+  /* ---------- OVERRUNS ---------- */
+  {
+    PDC_scheduler scheduler(testClock);
+    reset(0, 250, 0);
+    uint8_t id = scheduler.addTask(taskA, TEST_PERIOD, 200);
+    scheduler.start();
+    runFor(scheduler, 5 * TEST_PERIOD);
+
+    printf("a 250us task with a 200us deadline:\n");
+    check("  runs:", scheduler.getTask(id)->runCount, 5);
+    check("  overruns:", scheduler.getTask(id)->overruns, 5);
+    check("  skipped:", scheduler.getTask(id)->skipped, 0);
+  }
+
+  /* ---------- SKIPS ---------- */
+  /* the third run (released at 2000us) takes 3500us, so finishes at 5500us. the releases at 3000us and 4000us are
+     dropped, and the one at 5000us runs straight away, 500us late. then back on the grid */
+  {
+    PDC_scheduler scheduler(testClock);
+    reset(0, 100, 0);
+    testTasks[0].stallRun = 2;
+    testTasks[0].stallTime = 3500;
+    uint8_t id = scheduler.addTask(taskA, TEST_PERIOD, TEST_PERIOD);
+    scheduler.start();
+    runFor(scheduler, 8 * TEST_PERIOD);
+
+    printf("a 100us task that stalls for 3500us once:\n");
+    check("  runs in 8 periods (0,1,2 then 5,6,7ms):", scheduler.getTask(id)->runCount, 6);
+    check("  skipped:", scheduler.getTask(id)->skipped, 2);
+    check("  overruns:", scheduler.getTask(id)->overruns, 1);
+    check("  max jitter [us]:", scheduler.getTask(id)->maxJitter, 500);
+    check("  max run time [us]:", scheduler.getTask(id)->maxRunTime, 3500);
+  }
+
+  /* ---------- TASK IDS ---------- */
+  {
+    PDC_scheduler scheduler(testClock);
+    reset(0, 0, 0);
+    check("an empty table has no task 0:", scheduler.getTask(0) == NULL, 1);
+
+    for (uint8_t i = 0; i < MAX_TASKS; i++) {
+      scheduler.addTask(taskA, TEST_PERIOD, TEST_PERIOD);
+    }
+    check("adding to a full table gives MAX_TASKS:", scheduler.addTask(taskA, TEST_PERIOD, TEST_PERIOD), MAX_TASKS);
+    check("a full table has its last task:", scheduler.getTask(MAX_TASKS - 1) != NULL, 1);
+    check("and no task MAX_TASKS:", scheduler.getTask(MAX_TASKS) == NULL, 1);
+  }
+
+  return (failed);
+}
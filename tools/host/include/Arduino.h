@@ -0,0 +1,129 @@
+/*******************************************************************
+   Host stand-in for the Arduino core (see tools/host/PDC_host.h)
+   Only the parts of the core that the PDC code uses are here. the
+    clock, pins and serial port are implemented in PDC_hostCore.cpp
+ *******************************************************************/
+
+#ifndef _HOST_ARDUINO
+#define _HOST_ARDUINO
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+
+#include <algorithm>
+
+using std::abs; /* the core's abs() is a macro that works on floats too */
+using std::min; /* min() and max() are macros in the core too. as functions, both arguments must be the same type */
+using std::max;
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+#define sq(x) ((x) * (x))
+
+/* ---------- CONSTANTS ---------- */
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define BIN 2
+#define DEC 10
+#define HEX 16
+
+/* ---------- FLASH ----------
+   the host has no separate program memory, so flash tables are ordinary constants */
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_float(address) (*(const float *)(address))
+#define F(text) (text)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/* ---------- TIME ---------- */
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+/* ---------- PINS ---------- */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+/* ---------- PORT REGISTERS ----------
+   the nano's pins are grouped into 8 bit ports (D0-D7 on port D, D8-D13 on port B, A0-A5 on port C), and
+   each port's output register can be written directly. here a port is an object that passes every write on
+   to the pins, so the device models still see slave select change. see PDC_hostCore.cpp */
+#define NOT_A_PORT 0
+#define PB 2
+#define PC 3
+#define PD 4
+
+class hostPort {
+  public:
+    uint8_t port;  /* which port this is (PB, PC or PD) */
+
+    operator uint8_t() const;               /* the level of every pin on the port */
+    hostPort &operator=(uint8_t value);     /* set every pin on the port */
+    hostPort &operator&=(uint8_t mask) { return (*this = uint8_t(*this) & mask); }
+    hostPort &operator|=(uint8_t mask) { return (*this = uint8_t(*this) | mask); }
+};
+
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+hostPort *portOutputRegister(uint8_t port);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+/* ---------- ATMEGA REGISTERS ----------
+   only written by the code, never read back, so they are just variables */
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t OCR1A;
+
+/* ---------- STRING ---------- */
+class String : public std::string {
+  public:
+    String() {}
+    String(const char *text) : std::string(text) {}
+    String(const std::string &text) : std::string(text) {}
+};
+
+/* ---------- SERIAL ----------
+   everything printed goes to stdout, and nothing ever arrives */
+class HardwareSerial {
+  public:
+    void begin(uint32_t) {}
+    operator bool() const { return true; }
+
+    size_t print(const char *text);
+    size_t print(const String &text);
+    size_t print(char c);
+    size_t print(double value, int digits = 2);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(int value, int base = DEC) { return (print(long(value), base)); }
+    size_t print(unsigned int value, int base = DEC) { return (print((unsigned long)value, base)); }
+    size_t print(unsigned char value, int base = DEC) { return (print((unsigned long)value, base)); }
+
+    template <typename T> size_t println(T value) { return (print(value) + print('\n')); }
+    template <typename T> size_t println(T value, int format) { return (print(value, format) + print('\n')); }
+    size_t println() { return (print('\n')); }
+
+    size_t write(uint8_t b) { return (print(char(b))); }
+    size_t write(const uint8_t *buffer, size_t size);
+
+    int available();
+    int read();
+};
+
+extern HardwareSerial Serial;
+
+#endif
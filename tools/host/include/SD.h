@@ -0,0 +1,107 @@
+/*******************************************************************
+   Host stand-in for the Arduino SD library
+   The card is a directory on the host (HOST_SD_DIR), and each file
+    on the card is an ordinary file in it. this covers both the
+    SD/File interface, and the lower level Sd2Card/SdVolume/SdFile
+    classes that PDC_254 uses for raw sector writes:
+    + createContiguous() makes the file at its full size, and
+       remembers which 'card blocks' it covers
+    + Sd2Card::writeData() writes a block into whichever file owns
+       it, so the file is always what the card would hold, even if
+       it's never closed
+    + SdVolume::cacheClear() hands out the one block cache, and any
+       file system call overwrites it, as the library's reads of
+       directory and FAT sectors would
+   Every block written costs HOST_SD_BLOCK_US of simulated time to
+    send, and now and again the card then stays busy with it for
+    HOST_SD_STALL_US, like a real card's internal housekeeping. as
+    with the library, the next write waits for the card, and
+    Sd2Card::isBusy() says whether it would. see PDC_hostCore.cpp
+ *******************************************************************/
+
+#ifndef _HOST_SD
+#define _HOST_SD
+
+#include "Arduino.h"
+#include <stdio.h>
+
+#define O_READ 0x01
+#define O_WRITE 0x02
+
+#define FILE_READ O_READ
+#define FILE_WRITE 0x17
+
+#define SPI_FULL_SPEED 0
+#define SPI_HALF_SPEED 1
+#define SPI_QUARTER_SPEED 2
+
+/* ---------- SD/File INTERFACE ---------- */
+class File {
+  private:
+    FILE *handle;
+
+  public:
+    File() { handle = NULL; }
+    File(FILE *fileHandle) { handle = fileHandle; }
+
+    operator bool() const { return (handle != NULL); }
+    size_t write(uint8_t data) { return (write(&data, 1)); }
+    size_t write(const uint8_t *buffer, size_t size);
+    int read(void *buffer, uint16_t size);
+    void flush();
+    void close();
+    uint32_t size();
+};
+
+class SDClass {
+  public:
+    bool begin(uint8_t chipSelect);
+    bool exists(const char *fileName);
+    bool exists(const String &fileName) { return (exists(fileName.c_str())); }
+    File open(const char *fileName, uint8_t mode = FILE_READ);
+    File open(const String &fileName, uint8_t mode = FILE_READ) { return (open(fileName.c_str(), mode)); }
+    bool remove(const char *fileName);
+};
+
+extern SDClass SD;
+
+/* ---------- LOW LEVEL INTERFACE ---------- */
+class Sd2Card {
+  private:
+    uint32_t writeBlock;  /* the next block of the current multi-block write */
+    uint32_t writeEnd;    /* one past the last block of the current multi-block write */
+
+  public:
+    Sd2Card() { writeBlock = 0; writeEnd = 0; }
+    uint8_t init(uint8_t sckRateID, uint8_t chipSelectPin);
+    uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
+    uint8_t writeData(const uint8_t *src);
+    uint8_t isBusy();
+    uint8_t writeStop();
+};
+
+class SdVolume {
+  public:
+    uint8_t init(Sd2Card *dev) { return (dev != NULL); }
+    static uint8_t *cacheClear();
+};
+
+class SdFile {
+  private:
+    char path[64];        /* the host file that holds this file */
+    uint32_t firstBlock;  /* the card block the file starts at */
+    uint32_t numBlocks;   /* how many blocks were allocated */
+    bool isOpen;
+
+  public:
+    SdFile() { isOpen = false; firstBlock = 0; numBlocks = 0; path[0] = '\0'; }
+    uint8_t openRoot(SdVolume *vol);
+    uint8_t open(SdFile *dirFile, const char *fileName, uint8_t oflag);
+    uint8_t createContiguous(SdFile *dirFile, const char *fileName, uint32_t size);
+    uint8_t contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock);
+    uint8_t truncate(uint32_t size);
+    uint8_t remove();
+    uint8_t close();
+};
+
+#endif
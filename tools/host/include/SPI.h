@@ -0,0 +1,38 @@
+/*******************************************************************
+   Host stand-in for the Arduino SPI library
+   Each byte transferred goes to whichever device model is selected
+    (its slave select pin is low), and costs HOST_SPI_BYTE_US of
+    simulated time. see PDC_hostCore.cpp
+ *******************************************************************/
+
+#ifndef _HOST_SPI
+#define _HOST_SPI
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+  public:
+    SPISettings() {}
+    SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+class SPIClass {
+  public:
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    uint8_t transfer(uint8_t data);
+    void transfer(void *buffer, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif
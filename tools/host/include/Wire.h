@@ -0,0 +1,24 @@
+/*******************************************************************
+   Host stand-in for the Arduino Wire (I2C) library
+   Nothing is modelled on the I2C bus yet, so every read returns 0
+ *******************************************************************/
+
+#ifndef _HOST_WIRE
+#define _HOST_WIRE
+
+#include "Arduino.h"
+
+class TwoWire {
+  public:
+    void begin() {}
+    void beginTransmission(uint8_t) {}
+    size_t write(uint8_t) { return (1); }
+    uint8_t endTransmission() { return (0); }
+    uint8_t requestFrom(uint8_t, uint8_t quantity) { return (quantity); }
+    int available() { return (0); }
+    int read() { return (0); }
+};
+
+extern TwoWire Wire;
+
+#endif